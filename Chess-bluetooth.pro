@@ -2,7 +2,7 @@
 # Chess-bluetooth - Qt Chess Game with Bluetooth Support
 ######################################################################
 
-QT += widgets bluetooth
+QT += widgets bluetooth concurrent
 TEMPLATE = app
 TARGET = Chess-bluetooth
 INCLUDEPATH += . src
@@ -19,12 +19,44 @@ SOURCES += src/main.cpp \
            src/mainwindow.cpp \
            src/chessboard.cpp \
            src/chessai.cpp \
+           src/bitboard.cpp \
+           src/position.cpp \
+           src/movegen.cpp \
+           src/pawntable.cpp \
+           src/evalcache.cpp \
+           src/transposition.cpp \
+           src/matesearch.cpp \
+           src/mappedfile.cpp \
+           src/nnue.cpp \
+           src/tablebase.cpp \
+           src/kpk.cpp \
+           src/openingbook.cpp \
+           src/san.cpp \
+           src/pgn.cpp \
+           src/gamedb.cpp \
+           src/openingexplorer.cpp \
            src/bluetoothmanager.cpp \
            src/bluetoothdialog.cpp
 
 HEADERS += src/mainwindow.h \
            src/chessboard.h \
            src/chessai.h \
+           src/bitboard.h \
+           src/position.h \
+           src/movegen.h \
+           src/pawntable.h \
+           src/evalcache.h \
+           src/transposition.h \
+           src/matesearch.h \
+           src/mappedfile.h \
+           src/nnue.h \
+           src/tablebase.h \
+           src/kpk.h \
+           src/openingbook.h \
+           src/san.h \
+           src/pgn.h \
+           src/gamedb.h \
+           src/openingexplorer.h \
            src/bluetoothmanager.h \
            src/bluetoothdialog.h
 
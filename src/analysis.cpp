@@ -0,0 +1,374 @@
+#include "analysis.h"
+#include "mappedfile.h"
+#include "pgn.h"
+#include "san.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+// Decisive scores are capped at this when comparing moves
+static const int LossCap = 1000;
+// Seconds between progress lines
+static const int ProgressInterval = 5;
+
+static int cappedScore(int score)
+{
+    return std::max(-LossCap, std::min(LossCap, score));
+}
+
+static MoveVerdict verdictFor(int loss)
+{
+    if (loss >= BLUNDER_LOSS) return VERDICT_BLUNDER;
+    if (loss >= MISTAKE_LOSS) return VERDICT_MISTAKE;
+    if (loss >= INACCURACY_LOSS) return VERDICT_INACCURACY;
+    return VERDICT_GOOD;
+}
+
+std::vector<MoveAnalysis> analyzeGame(ChessAI& engine, const Position& start,
+                                      const std::vector<PackedMove>& moves, const SearchLimits& limits)
+{
+    std::vector<MoveAnalysis> analysis;
+    analysis.reserve(moves.size());
+    engine.clearHash(); // Results of another game would make the output depend on the order
+
+    Position pos = start;
+    SearchResult before = engine.search(pos, limits);
+    for (PackedMove move : moves) {
+        Color mover = pos.sideToMove();
+        MoveAnalysis a;
+        a.played = move;
+        a.best = before.bestMove;
+        a.bestScore = before.score;
+        a.depth = before.depth;
+        a.nodes = engine.getSearchStats().nodes;
+
+        pos.makeMove(move);
+        SearchResult after = engine.search(pos, limits);
+        a.playedScore = after.score;
+
+        // The engine's own move loses nothing, whatever the deeper search says
+        int gained = cappedScore(a.playedScore) - cappedScore(a.bestScore);
+        a.loss = move == a.best ? 0 : std::max(0, mover == WHITE ? -gained : gained);
+        a.verdict = verdictFor(a.loss);
+        if (before.lines.size() > 1)
+            a.lines = before.lines;
+        analysis.push_back(a);
+        before = after;
+    }
+    return analysis;
+}
+
+// Score as PGN [%eval] text: pawns, or "#n" for a mate in n moves
+static std::string evalText(int score)
+{
+    char text[32];
+    if (std::abs(score) > ChessAI::MATE_BOUND) {
+        int moves = (ChessAI::MATE_SCORE - std::abs(score) + 1) / 2;
+        std::snprintf(text, sizeof(text), "#%s%d", score < 0 ? "-" : "", moves);
+    } else {
+        std::snprintf(text, sizeof(text), "%.2f", score / 100.0);
+    }
+    return text;
+}
+
+// Score as a JSON object: {"cp":35} or {"mate":-3}
+static std::string evalJson(int score)
+{
+    char text[32];
+    if (std::abs(score) > ChessAI::MATE_BOUND) {
+        int moves = (ChessAI::MATE_SCORE - std::abs(score) + 1) / 2;
+        std::snprintf(text, sizeof(text), "{\"mate\":%d}", score < 0 ? -moves : moves);
+    } else {
+        std::snprintf(text, sizeof(text), "{\"cp\":%d}", score);
+    }
+    return text;
+}
+
+static void writeJsonString(std::ostream& out, const std::string& text)
+{
+    out << '"';
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out << '\\' << c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char escape[8];
+            std::snprintf(escape, sizeof(escape), "\\u%04x", c);
+            out << escape;
+        } else {
+            out << c;
+        }
+    }
+    out << '"';
+}
+
+static std::string sanOf(const Position& pos, PackedMove move)
+{
+    if (move == NO_MOVE)
+        return "";
+    Position copy = pos;
+    char san[SAN_MAX_LENGTH];
+    return std::string(san, size_t(writeSan(copy, move, san)));
+}
+
+// SAN of a line from pos, space separated
+static std::string sanLine(const Position& pos, const std::vector<PackedMove>& line)
+{
+    std::string text;
+    Position copy = pos;
+    for (PackedMove move : line) {
+        char san[SAN_MAX_LENGTH];
+        text += (text.empty() ? "" : " ") + std::string(san, size_t(writeSan(copy, move, san)));
+        copy.makeMove(move);
+    }
+    return text;
+}
+
+static const char* verdictName(MoveVerdict verdict)
+{
+    static const char* const names[] = {"good", "inaccuracy", "mistake", "blunder"};
+    return names[verdict];
+}
+
+// Annotated PGN: a NAG on every error and the evaluation after each move
+static void writeAnnotatedPgn(std::ostream& out, const PgnGame& game, const Position& start,
+                              const std::vector<PackedMove>& moves, const std::vector<MoveAnalysis>& analysis,
+                              const std::string& annotator)
+{
+    static const int nags[] = {0, 6, 2, 4}; // ?!, ?, ??
+    std::vector<PgnNote> notes;
+    Position pos = start;
+    for (const MoveAnalysis& a : analysis) {
+        PgnNote note;
+        note.nag = nags[a.verdict];
+        note.comment = "[%eval " + evalText(a.playedScore) + "]";
+        if (a.verdict != VERDICT_GOOD && a.best != NO_MOVE)
+            note.comment += " " + sanOf(pos, a.best) + " was best (" + evalText(a.bestScore) + ")";
+        for (size_t i = 0; i < a.lines.size(); ++i) {
+            note.comment += i ? ", " : " Lines: ";
+            note.comment += sanLine(pos, a.lines[i].pv) + " (" + evalText(a.lines[i].score) + ")";
+        }
+        notes.push_back(note);
+        pos.makeMove(a.played);
+    }
+
+    auto tags = game.tags;
+    tags.erase(std::remove_if(tags.begin(), tags.end(),
+                              [](const std::pair<std::string, std::string>& t) { return t.first == "Annotator"; }),
+               tags.end());
+    tags.push_back({"Annotator", annotator});
+    writePgnGame(out, tags, start, moves, game.result, notes);
+}
+
+// One JSON object per line, with the tags, every move and a summary per side
+static void writeJsonGame(std::ostream& out, size_t number, const PgnGame& game, const Position& start,
+                          const std::vector<MoveAnalysis>& analysis)
+{
+    struct Summary {
+        int moves = 0;
+        int loss = 0;
+        int count[4] = {};
+    } sides[2];
+
+    out << "{\"game\":" << number << ",\"tags\":{";
+    for (size_t i = 0; i < game.tags.size(); ++i) {
+        if (i > 0)
+            out << ',';
+        writeJsonString(out, game.tags[i].first);
+        out << ':';
+        writeJsonString(out, game.tags[i].second);
+    }
+    out << "},\"result\":";
+    writeJsonString(out, game.result);
+    if (start.fen() != START_FEN) {
+        out << ",\"fen\":";
+        writeJsonString(out, start.fen());
+    }
+
+    out << ",\"moves\":[";
+    Position pos = start;
+    for (size_t i = 0; i < analysis.size(); ++i) {
+        const MoveAnalysis& a = analysis[i];
+        Summary& side = sides[pos.sideToMove() == WHITE ? 0 : 1];
+        side.moves++;
+        side.loss += a.loss;
+        side.count[a.verdict]++;
+
+        out << (i > 0 ? "," : "") << "{\"ply\":" << i + 1 << ",\"san\":";
+        writeJsonString(out, sanOf(pos, a.played));
+        out << ",\"eval\":" << evalJson(a.playedScore) << ",\"best\":";
+        writeJsonString(out, sanOf(pos, a.best));
+        out << ",\"bestEval\":" << evalJson(a.bestScore) << ",\"depth\":" << a.depth
+            << ",\"loss\":" << a.loss << ",\"verdict\":\"" << verdictName(a.verdict) << '"';
+        if (!a.lines.empty()) {
+            out << ",\"lines\":[";
+            for (size_t l = 0; l < a.lines.size(); ++l) {
+                out << (l > 0 ? "," : "") << "{\"eval\":" << evalJson(a.lines[l].score) << ",\"pv\":";
+                writeJsonString(out, sanLine(pos, a.lines[l].pv));
+                out << '}';
+            }
+            out << ']';
+        }
+        out << '}';
+        pos.makeMove(a.played);
+    }
+    out << ']';
+
+    static const char* const sideNames[] = {"white", "black"};
+    for (int s = 0; s < 2; ++s) {
+        const Summary& side = sides[s];
+        out << ",\"" << sideNames[s] << "\":{\"acpl\":" << (side.moves ? (side.loss + side.moves / 2) / side.moves : 0)
+            << ",\"inaccuracies\":" << side.count[VERDICT_INACCURACY] << ",\"mistakes\":" << side.count[VERDICT_MISTAKE]
+            << ",\"blunders\":" << side.count[VERDICT_BLUNDER] << '}';
+    }
+    out << "}\n";
+}
+
+BatchAnalyzer::BatchAnalyzer(int threads)
+    : threadCount(threads > 0 ? threads : std::max(1, int(std::thread::hardware_concurrency()))),
+      hashKilobytes(16384), json(false), multiPv(1)
+{
+    limits.nodes = 100000;
+}
+
+bool BatchAnalyzer::run(const std::string& pgnPath, const std::string& outPath)
+{
+    MappedFile file;
+    if (!file.open(pgnPath)) {
+        message(pgnPath + ": could not be opened");
+        return false;
+    }
+    std::ofstream out(outPath, std::ios::binary);
+    if (!out) {
+        message(outPath + ": could not be written");
+        return false;
+    }
+    auto startTime = std::chrono::steady_clock::now();
+
+    // Games are small next to the time spent searching them, so read them
+    // all first and hand them out one by one for even load
+    std::vector<PgnGame> games;
+    PgnReader reader(reinterpret_cast<const char*>(file.data()), file.size());
+    for (PgnGame game; reader.readGame(game);)
+        games.push_back(game);
+    message(pgnPath + ": " + std::to_string(games.size()) + " games, " + std::to_string(threadCount) + " threads");
+
+    std::string annotator = "chesstool analyze";
+    if (limits.depth) annotator += ", depth " + std::to_string(limits.depth);
+    if (limits.nodes) annotator += ", " + std::to_string(limits.nodes) + " nodes";
+    if (limits.milliseconds) annotator += ", " + std::to_string(limits.milliseconds) + " ms";
+    annotator += " per position";
+    if (multiPv > 1) annotator += ", " + std::to_string(multiPv) + " lines";
+
+    std::vector<std::string> results(games.size());
+    std::vector<char> finished(games.size(), 0);
+    std::mutex lock;
+    std::condition_variable wake;
+    std::atomic<size_t> nextGame(0);
+    std::atomic<uint64_t> positions(0), nodes(0), skipped(0), truncated(0);
+
+    auto worker = [&]() {
+        ChessAI engine;
+        engine.setHashSize(hashKilobytes);
+        engine.setMultiPv(multiPv);
+        if (network)
+            engine.setNetwork(network);
+        if (tablebases)
+            engine.setTablebases(tablebases);
+
+        Position start;
+        std::vector<PackedMove> moves;
+        size_t n;
+        while ((n = nextGame.fetch_add(1)) < games.size()) {
+            const PgnGame& game = games[n];
+            std::ostringstream text;
+            std::string fen = game.tag("FEN");
+            if (fen.empty())
+                start.setStartPosition();
+            if (!fen.empty() && !start.setFen(fen)) {
+                skipped++;
+            } else {
+                moves.clear();
+                Position pos = start;
+                for (std::string_view san : game.moves) {
+                    PackedMove move = parseSan(pos, san);
+                    if (move == NO_MOVE) {
+                        truncated++; // Keep the part before an illegal move
+                        break;
+                    }
+                    moves.push_back(move);
+                    pos.makeMove(move);
+                }
+
+                std::vector<MoveAnalysis> analysis = analyzeGame(engine, start, moves, limits);
+                positions += moves.size() + 1;
+                nodes += engine.getSearchStats().nodes;
+                for (const MoveAnalysis& a : analysis)
+                    nodes += a.nodes;
+                if (json)
+                    writeJsonGame(text, n + 1, game, start, analysis);
+                else
+                    writeAnnotatedPgn(text, game, start, moves, analysis, annotator);
+            }
+
+            std::lock_guard<std::mutex> guard(lock);
+            results[n] = text.str();
+            finished[n] = 1;
+            wake.notify_one();
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (int i = 0; i < threadCount; ++i)
+        workers.emplace_back(worker);
+
+    // Write results in game order as they come in, with a progress line now and then
+    auto report = [&](size_t done) {
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        char text[160];
+        std::snprintf(text, sizeof(text), "%zu/%zu games, %llu positions, %.1f positions/s, %.2f Mnps (%.0fs)",
+                      done, games.size(), (unsigned long long)positions.load(),
+                      positions / std::max(seconds, 0.001), nodes / std::max(seconds, 0.001) / 1e6, seconds);
+        message(text);
+    };
+    auto lastReport = std::chrono::steady_clock::now();
+    size_t written = 0;
+    while (written < games.size()) {
+        std::string text;
+        bool ready;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            ready = wake.wait_for(guard, std::chrono::seconds(1), [&] { return finished[written] != 0; });
+            if (ready)
+                text.swap(results[written]);
+        }
+        if (ready) {
+            out << text;
+            ++written;
+        }
+        if (std::chrono::steady_clock::now() - lastReport >= std::chrono::seconds(ProgressInterval)) {
+            report(written);
+            lastReport = std::chrono::steady_clock::now();
+        }
+    }
+    for (std::thread& t : workers)
+        t.join();
+
+    out.close();
+    if (!out) {
+        message(outPath + ": could not be written");
+        return false;
+    }
+    report(written);
+    char summary[120];
+    std::snprintf(summary, sizeof(summary), ": %llu skipped, %llu cut at an illegal move",
+                  (unsigned long long)skipped.load(), (unsigned long long)truncated.load());
+    message(outPath + summary);
+    return true;
+}
@@ -0,0 +1,82 @@
+#ifndef ANALYSIS_H
+#define ANALYSIS_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "chessai.h"
+
+enum MoveVerdict {
+    VERDICT_GOOD,
+    VERDICT_INACCURACY,
+    VERDICT_MISTAKE,
+    VERDICT_BLUNDER
+};
+
+// Centipawns a move may give away before it counts as each kind of error
+const int INACCURACY_LOSS = 50;
+const int MISTAKE_LOSS = 100;
+const int BLUNDER_LOSS = 300;
+
+// Engine verdict on one move of a game. Scores are from white's point of view.
+struct MoveAnalysis {
+    PackedMove played;
+    PackedMove best;   // Engine's choice in the position before the move
+    int bestScore;     // Score of that position
+    int playedScore;   // Score of the position after the move
+    int depth;         // Depth the position before was searched to
+    uint64_t nodes;    // Nodes that search took
+    int loss;          // Centipawns the mover gave away, never negative
+    MoveVerdict verdict;
+    std::vector<PvLine> lines; // Ranked moves of the position before, with multi-PV
+};
+
+// Search every position of a game once. The score of the position after a
+// move is the score of the move played, so one search per ply rates both.
+// Mate scores count as 1000 centipawns when working out the loss. With the
+// engine set to several lines, each move also gets the ranked alternatives.
+std::vector<MoveAnalysis> analyzeGame(ChessAI& engine, const Position& start,
+                                      const std::vector<PackedMove>& moves, const SearchLimits& limits);
+
+// Annotates every game of a PGN file with engine evaluations.
+//
+// Each worker thread owns a ChessAI, so every worker has its own
+// transposition table and caches; networks and tablebases are shared. Games
+// are handed out one at a time and the results are written in the input
+// order, as annotated PGN (NAGs plus [%eval] comments) or as JSON with one
+// game object per line.
+class BatchAnalyzer {
+public:
+    explicit BatchAnalyzer(int threads = 0); // 0 = all cores
+
+    void setLogger(std::function<void(const std::string&)> logger) { log = logger; }
+    // Budget of each position (default 100000 nodes)
+    void setLimits(const SearchLimits& searchLimits) { limits = searchLimits; }
+    // Transposition table of each worker (default 16 MB)
+    void setHashSize(size_t kilobytes) { hashKilobytes = kilobytes; }
+    void setNetwork(std::shared_ptr<const NnueNetwork> nnue) { network = nnue; }
+    void setTablebases(std::shared_ptr<const Tablebases> tables) { tablebases = tables; }
+    void setJson(bool enabled) { json = enabled; }
+    // Best moves listed for each position (default 1, just the best move)
+    void setMultiPv(int lines) { multiPv = std::max(1, lines); }
+
+    // Analyse every game of pgnPath into outPath; false if a file can't be
+    // opened or written
+    bool run(const std::string& pgnPath, const std::string& outPath);
+
+private:
+    int threadCount;
+    SearchLimits limits;
+    size_t hashKilobytes;
+    std::shared_ptr<const NnueNetwork> network;
+    std::shared_ptr<const Tablebases> tablebases;
+    bool json;
+    int multiPv;
+    std::function<void(const std::string&)> log;
+
+    void message(const std::string& text) const { if (log) log(text); }
+};
+
+#endif // ANALYSIS_H
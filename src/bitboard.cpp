@@ -0,0 +1,157 @@
+#include "bitboard.h"
+#include <mutex>
+
+Bitboard PawnAttacks[2][64];
+Bitboard KnightAttacks[64];
+Bitboard KingAttacks[64];
+Bitboard BetweenBB[64][64];
+Bitboard LineBB[64][64];
+
+Magic RookMagics[64];
+Magic BishopMagics[64];
+
+static Bitboard rookTable[0x19000];  // Sum of 2^(relevant bits) over all squares
+static Bitboard bishopTable[0x1480];
+
+namespace {
+
+// xorshift64* generator, only used to search for magic numbers
+struct MagicRng {
+    uint64_t s;
+    explicit MagicRng(uint64_t seed) : s(seed) {}
+    uint64_t next() {
+        s ^= s >> 12;
+        s ^= s << 25;
+        s ^= s >> 27;
+        return s * 2685821657736338717ULL;
+    }
+    // Magic candidates work best with few bits set
+    uint64_t sparse() { return next() & next() & next(); }
+};
+
+bool onBoard(int file, int rank)
+{
+    return file >= 0 && file < 8 && rank >= 0 && rank < 8;
+}
+
+// Slow ray walk used only while building the tables
+Bitboard slidingAttack(const int dirs[4][2], Square s, Bitboard occupied)
+{
+    Bitboard attacks = 0;
+    for (int d = 0; d < 4; ++d) {
+        int f = fileOf(s) + dirs[d][0];
+        int r = rankOf(s) + dirs[d][1];
+        while (onBoard(f, r)) {
+            Bitboard b = squareBB(makeSquare(f, r));
+            attacks |= b;
+            if (occupied & b) break;
+            f += dirs[d][0];
+            r += dirs[d][1];
+        }
+    }
+    return attacks;
+}
+
+const int RookDirs[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+const int BishopDirs[4][2] = {{1, 1}, {1, -1}, {-1, 1}, {-1, -1}};
+
+void initMagics(const int dirs[4][2], Bitboard* table, Magic magics[64])
+{
+    // Fixed seeds per rank keep start-up time short and deterministic
+    static const uint64_t seeds[8] = {728, 10316, 55013, 32803, 12281, 15100, 16645, 255};
+
+    Bitboard occupancy[4096], reference[4096];
+    int epoch[4096] = {}, attempt = 0;
+    Bitboard* next = table;
+
+    for (int sq = 0; sq < 64; ++sq) {
+        Square s = Square(sq);
+        Magic& m = magics[sq];
+
+        // Board edges are irrelevant unless the piece is on them
+        Bitboard edges = ((RANK_1_BB | RANK_8_BB) & ~rankBB(rankOf(s)))
+                       | ((FILE_A_BB | FILE_H_BB) & ~fileBB(fileOf(s)));
+        m.mask = slidingAttack(dirs, s, 0) & ~edges;
+        m.shift = 64 - popCount(m.mask);
+        m.attacks = next;
+
+        // Carry-rippler enumeration of every subset of the mask
+        int size = 0;
+        Bitboard b = 0;
+        do {
+            occupancy[size] = b;
+            reference[size] = slidingAttack(dirs, s, b);
+            ++size;
+            b = (b - m.mask) & m.mask;
+        } while (b);
+        next += size;
+
+        MagicRng rng(seeds[rankOf(s)]);
+        for (int i = 0; i < size;) {
+            for (m.magic = 0; popCount((m.magic * m.mask) >> 56) < 6;)
+                m.magic = rng.sparse();
+
+            ++attempt;
+            for (i = 0; i < size; ++i) {
+                unsigned idx = m.index(occupancy[i]);
+                if (epoch[idx] < attempt) {
+                    epoch[idx] = attempt;
+                    m.attacks[idx] = reference[i];
+                } else if (m.attacks[idx] != reference[i]) {
+                    break;
+                }
+            }
+        }
+    }
+}
+
+void initTables()
+{
+    static const int knightSteps[8][2] = {{1, 2}, {2, 1}, {2, -1}, {1, -2},
+                                          {-1, -2}, {-2, -1}, {-2, 1}, {-1, 2}};
+    static const int kingSteps[8][2] = {{1, 0}, {1, 1}, {0, 1}, {-1, 1},
+                                        {-1, 0}, {-1, -1}, {0, -1}, {1, -1}};
+
+    for (int sq = 0; sq < 64; ++sq) {
+        Square s = Square(sq);
+        int f = fileOf(s), r = rankOf(s);
+
+        KnightAttacks[sq] = KingAttacks[sq] = 0;
+        for (int i = 0; i < 8; ++i) {
+            if (onBoard(f + knightSteps[i][0], r + knightSteps[i][1]))
+                KnightAttacks[sq] |= squareBB(makeSquare(f + knightSteps[i][0], r + knightSteps[i][1]));
+            if (onBoard(f + kingSteps[i][0], r + kingSteps[i][1]))
+                KingAttacks[sq] |= squareBB(makeSquare(f + kingSteps[i][0], r + kingSteps[i][1]));
+        }
+
+        PawnAttacks[WHITE][sq] = pawnAttacksBB(WHITE, squareBB(s));
+        PawnAttacks[BLACK][sq] = pawnAttacksBB(BLACK, squareBB(s));
+    }
+
+    initMagics(RookDirs, rookTable, RookMagics);
+    initMagics(BishopDirs, bishopTable, BishopMagics);
+
+    for (int a = 0; a < 64; ++a) {
+        for (int b = 0; b < 64; ++b) {
+            Square sa = Square(a), sb = Square(b);
+            BetweenBB[a][b] = LineBB[a][b] = 0;
+            if (a == b) continue;
+
+            if (bishopAttacks(sa, 0) & squareBB(sb)) {
+                LineBB[a][b] = (bishopAttacks(sa, 0) & bishopAttacks(sb, 0)) | squareBB(sa) | squareBB(sb);
+                BetweenBB[a][b] = bishopAttacks(sa, squareBB(sb)) & bishopAttacks(sb, squareBB(sa));
+            } else if (rookAttacks(sa, 0) & squareBB(sb)) {
+                LineBB[a][b] = (rookAttacks(sa, 0) & rookAttacks(sb, 0)) | squareBB(sa) | squareBB(sb);
+                BetweenBB[a][b] = rookAttacks(sa, squareBB(sb)) & rookAttacks(sb, squareBB(sa));
+            }
+        }
+    }
+}
+
+} // namespace
+
+void initBitboards()
+{
+    static std::once_flag once;
+    std::call_once(once, initTables);
+}
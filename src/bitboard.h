@@ -0,0 +1,197 @@
+#ifndef BITBOARD_H
+#define BITBOARD_H
+
+#include <cstdint>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+typedef uint64_t Bitboard;
+
+// Squares are numbered a1 = 0 ... h8 = 63 (little-endian rank-file mapping)
+enum Square : int {
+    A1, B1, C1, D1, E1, F1, G1, H1,
+    A2, B2, C2, D2, E2, F2, G2, H2,
+    A3, B3, C3, D3, E3, F3, G3, H3,
+    A4, B4, C4, D4, E4, F4, G4, H4,
+    A5, B5, C5, D5, E5, F5, G5, H5,
+    A6, B6, C6, D6, E6, F6, G6, H6,
+    A7, B7, C7, D7, E7, F7, G7, H7,
+    A8, B8, C8, D8, E8, F8, G8, H8,
+    NO_SQUARE = 64
+};
+
+enum Color : int { WHITE = 0, BLACK = 1 };
+
+enum PieceType : int { PAWN = 0, KNIGHT, BISHOP, ROOK, QUEEN, KING, NO_PIECE_TYPE };
+
+// Piece = color * 6 + type, so white pieces come first
+enum Piece : int {
+    W_PAWN = 0, W_KNIGHT, W_BISHOP, W_ROOK, W_QUEEN, W_KING,
+    B_PAWN, B_KNIGHT, B_BISHOP, B_ROOK, B_QUEEN, B_KING,
+    NO_PIECE = 12
+};
+
+const Bitboard FILE_A_BB = 0x0101010101010101ULL;
+const Bitboard FILE_H_BB = FILE_A_BB << 7;
+const Bitboard RANK_1_BB = 0xFFULL;
+const Bitboard RANK_2_BB = RANK_1_BB << 8;
+const Bitboard RANK_3_BB = RANK_1_BB << 16;
+const Bitboard RANK_4_BB = RANK_1_BB << 24;
+const Bitboard RANK_5_BB = RANK_1_BB << 32;
+const Bitboard RANK_6_BB = RANK_1_BB << 40;
+const Bitboard RANK_7_BB = RANK_1_BB << 48;
+const Bitboard RANK_8_BB = RANK_1_BB << 56;
+
+inline Color operator~(Color c) { return Color(c ^ 1); }
+inline Piece makePiece(Color c, PieceType pt) { return Piece(c * 6 + pt); }
+inline PieceType typeOf(Piece p) { return PieceType(p % 6); }
+inline Color colorOf(Piece p) { return Color(p / 6); }
+
+inline Square makeSquare(int file, int rank) { return Square(rank * 8 + file); }
+inline int fileOf(Square s) { return s & 7; }
+inline int rankOf(Square s) { return s >> 3; }
+inline Square flipRank(Square s) { return Square(s ^ 56); }
+// Rank from the point of view of the given side (0 = own back rank)
+inline int relativeRank(Color c, Square s) { return c == WHITE ? rankOf(s) : 7 - rankOf(s); }
+
+// The GUI board is indexed [row][col] with row 0 being the 8th rank
+inline Square squareFromRowCol(int row, int col) { return makeSquare(col, 7 - row); }
+inline int rowOf(Square s) { return 7 - rankOf(s); }
+inline int colOf(Square s) { return fileOf(s); }
+
+inline Bitboard squareBB(Square s) { return 1ULL << s; }
+inline Bitboard fileBB(int file) { return FILE_A_BB << file; }
+inline Bitboard rankBB(int rank) { return RANK_1_BB << (8 * rank); }
+inline bool moreThanOne(Bitboard b) { return b & (b - 1); }
+
+inline int popCount(Bitboard b)
+{
+#ifdef _MSC_VER
+    return int(__popcnt64(b));
+#else
+    return __builtin_popcountll(b);
+#endif
+}
+
+inline Square lsb(Bitboard b)
+{
+#ifdef _MSC_VER
+    unsigned long idx;
+    _BitScanForward64(&idx, b);
+    return Square(idx);
+#else
+    return Square(__builtin_ctzll(b));
+#endif
+}
+
+inline Square msb(Bitboard b)
+{
+#ifdef _MSC_VER
+    unsigned long idx;
+    _BitScanReverse64(&idx, b);
+    return Square(idx);
+#else
+    return Square(63 ^ __builtin_clzll(b));
+#endif
+}
+
+inline Square popLsb(Bitboard& b)
+{
+    Square s = lsb(b);
+    b &= b - 1;
+    return s;
+}
+
+// Shift a whole bitboard one step north/south/etc. without wrapping files
+inline Bitboard shiftNorth(Bitboard b) { return b << 8; }
+inline Bitboard shiftSouth(Bitboard b) { return b >> 8; }
+inline Bitboard shiftEast(Bitboard b) { return (b & ~FILE_H_BB) << 1; }
+inline Bitboard shiftWest(Bitboard b) { return (b & ~FILE_A_BB) >> 1; }
+
+inline Bitboard adjacentFilesBB(int file) { return shiftEast(fileBB(file)) | shiftWest(fileBB(file)); }
+
+// All ranks strictly in front of s from c's point of view
+inline Bitboard forwardRanksBB(Color c, Square s)
+{
+    return c == WHITE ? (rankOf(s) == 7 ? 0 : ~0ULL << (8 * (rankOf(s) + 1)))
+                      : (1ULL << (8 * rankOf(s))) - 1;
+}
+inline Bitboard forwardFileBB(Color c, Square s) { return forwardRanksBB(c, s) & fileBB(fileOf(s)); }
+// Squares an enemy pawn must occupy to stop a pawn on s from being passed
+inline Bitboard passedPawnSpan(Color c, Square s)
+{
+    return forwardRanksBB(c, s) & (fileBB(fileOf(s)) | adjacentFilesBB(fileOf(s)));
+}
+
+inline Bitboard pawnPush(Color c, Bitboard b) { return c == WHITE ? shiftNorth(b) : shiftSouth(b); }
+
+// Squares attacked by all pawns of the given color in b
+inline Bitboard pawnAttacksBB(Color c, Bitboard b)
+{
+    return c == WHITE ? shiftNorth(shiftEast(b) | shiftWest(b))
+                      : shiftSouth(shiftEast(b) | shiftWest(b));
+}
+
+// Attack tables, filled by initBitboards()
+extern Bitboard PawnAttacks[2][64];
+extern Bitboard KnightAttacks[64];
+extern Bitboard KingAttacks[64];
+extern Bitboard BetweenBB[64][64];
+extern Bitboard LineBB[64][64];
+
+struct Magic {
+    Bitboard mask;
+    Bitboard magic;
+    Bitboard* attacks;
+    unsigned shift;
+
+    unsigned index(Bitboard occupied) const {
+        return unsigned(((occupied & mask) * magic) >> shift);
+    }
+};
+
+extern Magic RookMagics[64];
+extern Magic BishopMagics[64];
+
+// Build all attack tables. Safe to call repeatedly and from several threads.
+void initBitboards();
+
+inline Bitboard rookAttacks(Square s, Bitboard occupied)
+{
+    const Magic& m = RookMagics[s];
+    return m.attacks[m.index(occupied)];
+}
+
+inline Bitboard bishopAttacks(Square s, Bitboard occupied)
+{
+    const Magic& m = BishopMagics[s];
+    return m.attacks[m.index(occupied)];
+}
+
+inline Bitboard queenAttacks(Square s, Bitboard occupied)
+{
+    return rookAttacks(s, occupied) | bishopAttacks(s, occupied);
+}
+
+// Attacks of a non-pawn piece type from s
+inline Bitboard pieceAttacks(PieceType pt, Square s, Bitboard occupied)
+{
+    switch (pt) {
+        case KNIGHT: return KnightAttacks[s];
+        case BISHOP: return bishopAttacks(s, occupied);
+        case ROOK:   return rookAttacks(s, occupied);
+        case QUEEN:  return queenAttacks(s, occupied);
+        case KING:   return KingAttacks[s];
+        default:     return 0;
+    }
+}
+
+// True if the three squares are on a common rank, file or diagonal
+inline bool aligned(Square a, Square b, Square c)
+{
+    return LineBB[a][b] & squareBB(c);
+}
+
+#endif // BITBOARD_H
@@ -161,6 +161,14 @@ void BluetoothManager::sendNewGame()
     sendMessage(message);
 }
 
+void BluetoothManager::sendGameState(const QString& fen)
+{
+    if (!isConnected()) return;
+    
+    GameMessage message(GameMessage::GAME_STATE, fen);
+    sendMessage(message);
+}
+
 void BluetoothManager::sendDisconnect()
 {
     if (!isConnected()) return;
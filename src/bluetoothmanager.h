@@ -60,6 +60,7 @@ public:
     // Message sending
     void sendMove(int fromRow, int fromCol, int toRow, int toCol);
     void sendNewGame();
+    void sendGameState(const QString& fen);
     void sendDisconnect();
     void sendChatMessage(const QString& message);
     
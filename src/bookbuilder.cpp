@@ -0,0 +1,182 @@
+#include "bookbuilder.h"
+#include "mappedfile.h"
+#include "movegen.h"
+#include "openingbook.h"
+#include "pgn.h"
+#include "san.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+// Samples a worker collects before merging them into the shared maps
+static const size_t MergeBatch = 1 << 16;
+// Size of the pieces a PGN file is cut into
+static const size_t PieceBytes = 4 << 20;
+
+BookBuilder::BookBuilder(int threads)
+    : threadCount(threads > 0 ? threads : std::max(1, int(std::thread::hardware_concurrency()))),
+      maxPlies(30), minGames(2), games(0)
+{
+}
+
+void BookBuilder::merge(std::vector<Sample>& samples)
+{
+    // Group by shard so each lock is taken once per batch
+    auto shardOf = [](uint64_t key) { return int(key >> (64 - SHARD_BITS)); };
+    std::sort(samples.begin(), samples.end(),
+              [&](const Sample& a, const Sample& b) { return shardOf(a.key) < shardOf(b.key); });
+
+    for (size_t i = 0; i < samples.size();) {
+        Shard& shard = shards[shardOf(samples[i].key)];
+        std::lock_guard<std::mutex> lock(shard.lock);
+        int current = shardOf(samples[i].key);
+        for (; i < samples.size() && shardOf(samples[i].key) == current; ++i) {
+            MoveStats& stats = shard.moves[{samples[i].key, samples[i].move}];
+            stats.games++;
+            stats.points += samples[i].points;
+        }
+    }
+    samples.clear();
+}
+
+bool BookBuilder::addPgn(const std::string& path)
+{
+    MappedFile file;
+    if (!file.open(path)) {
+        message(path + ": could not be opened");
+        return false;
+    }
+    auto start = std::chrono::steady_clock::now();
+    const char* data = reinterpret_cast<const char*>(file.data());
+    size_t size = file.size();
+
+    // Cut at game starts so every piece holds whole games
+    std::vector<size_t> cuts = {0};
+    while (cuts.back() < size)
+        cuts.push_back(PgnReader::nextGameStart(data, size, std::min(size, cuts.back() + PieceBytes)));
+
+    std::atomic<size_t> nextPiece(0);
+    std::atomic<uint64_t> added(0), skipped(0);
+    auto worker = [&]() {
+        std::vector<Sample> samples;
+        samples.reserve(MergeBatch + 512);
+        PgnGame game;
+        Position pos;
+        size_t piece;
+        while ((piece = nextPiece.fetch_add(1)) + 1 < cuts.size()) {
+            PgnReader reader(data + cuts[piece], cuts[piece + 1] - cuts[piece]);
+            while (reader.readGame(game)) {
+                // Unfinished games don't count, nor do unreadable set-up positions
+                int whitePoints = game.result == "1-0" ? 2 : game.result == "0-1" ? 0 : 1;
+                std::string fen = game.tag("FEN");
+                if (fen.empty())
+                    pos.setStartPosition();
+                if (game.result == "*" || (!fen.empty() && !pos.setFen(fen))) {
+                    skipped++;
+                    continue;
+                }
+
+                int plies = std::min(int(game.moves.size()), maxPlies);
+                for (int ply = 0; ply < plies; ++ply) {
+                    PackedMove move = parseSan(pos, game.moves[ply]);
+                    if (move == NO_MOVE)
+                        break; // Illegal or unreadable move; keep the part before it
+                    uint8_t points = uint8_t(pos.sideToMove() == WHITE ? whitePoints : 2 - whitePoints);
+                    samples.push_back({OpeningBook::key(pos), OpeningBook::encodeMove(move), points});
+                    pos.makeMove(move);
+                }
+                added++;
+                if (samples.size() >= MergeBatch)
+                    merge(samples);
+            }
+        }
+        merge(samples);
+    };
+
+    std::vector<std::thread> workers;
+    for (int i = 1; i < threadCount; ++i)
+        workers.emplace_back(worker);
+    worker();
+    for (std::thread& t : workers)
+        t.join();
+    games += added;
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    char text[160];
+    std::snprintf(text, sizeof(text), ": %llu games, %llu skipped (%.1fs)",
+                  (unsigned long long)added, (unsigned long long)skipped, seconds);
+    message(path + text);
+    return true;
+}
+
+bool BookBuilder::write(const std::string& path)
+{
+    struct Entry {
+        uint64_t key;
+        uint16_t move;
+        uint32_t weight;
+    };
+    std::vector<Entry> entries;
+    for (Shard& shard : shards) {
+        for (const auto& item : shard.moves) {
+            // Moves that only ever lost are left out as well
+            if (int(item.second.games) >= minGames && item.second.points > 0)
+                entries.push_back({item.first.key, item.first.move, item.second.points});
+        }
+    }
+    if (entries.empty()) {
+        message(path + ": no moves qualify for the book");
+        return false;
+    }
+
+    // Sorted by key for the binary search, best moves first within a position
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        if (a.key != b.key) return a.key < b.key;
+        return a.weight != b.weight ? a.weight > b.weight : a.move < b.move;
+    });
+
+    std::FILE* out = std::fopen(path.c_str(), "wb");
+    if (!out) {
+        message(path + ": could not be written");
+        return false;
+    }
+
+    uint64_t positions = 0;
+    std::vector<unsigned char> buffer;
+    for (size_t first = 0; first < entries.size();) {
+        size_t last = first;
+        while (last < entries.size() && entries[last].key == entries[first].key)
+            ++last;
+        ++positions;
+
+        // Weights are 16 bits; scale a position's moves down together
+        uint32_t top = entries[first].weight;
+        for (size_t i = first; i < last; ++i) {
+            uint32_t weight = top > 0xFFFF ? std::max<uint32_t>(1, uint32_t(uint64_t(entries[i].weight) * 0xFFFF / top))
+                                           : entries[i].weight;
+            unsigned char bytes[OpeningBook::ENTRY_SIZE] = {};
+            for (int b = 0; b < 8; ++b)
+                bytes[b] = uint8_t(entries[i].key >> (56 - 8 * b));
+            bytes[8] = uint8_t(entries[i].move >> 8);
+            bytes[9] = uint8_t(entries[i].move);
+            bytes[10] = uint8_t(weight >> 8);
+            bytes[11] = uint8_t(weight);
+            buffer.insert(buffer.end(), bytes, bytes + sizeof(bytes));
+        }
+        first = last;
+    }
+
+    bool ok = std::fwrite(buffer.data(), 1, buffer.size(), out) == buffer.size();
+    ok = std::fclose(out) == 0 && ok;
+    if (!ok) {
+        message(path + ": could not be written");
+        return false;
+    }
+
+    char text[120];
+    std::snprintf(text, sizeof(text), ": %llu positions, %llu moves",
+                  (unsigned long long)positions, (unsigned long long)entries.size());
+    message(path + text);
+    return true;
+}
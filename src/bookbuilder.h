@@ -0,0 +1,75 @@
+#ifndef BOOKBUILDER_H
+#define BOOKBUILDER_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Builds an opening book (see openingbook.h) from PGN game collections.
+//
+// Every PGN file is mapped and cut at game boundaries into pieces that
+// worker threads replay independently through the legal move generator.
+// Each (position, move) pair seen in the first plies of a game collects the
+// number of games and the points the moving side scored. Workers batch
+// their pairs and merge them into sharded hash maps, so threads rarely wait
+// on the same lock. The book weight of a move is 2 * wins + draws.
+class BookBuilder {
+public:
+    explicit BookBuilder(int threads = 0); // 0 = all cores
+
+    void setLogger(std::function<void(const std::string&)> logger) { log = logger; }
+    // Only the first plies of each game go into the book (default 30)
+    void setMaxPlies(int plies) { maxPlies = plies; }
+    // Moves played in fewer games are left out (default 2)
+    void setMinGames(int games) { minGames = games; }
+
+    // Add every finished game of a PGN file
+    bool addPgn(const std::string& path);
+
+    uint64_t gameCount() const { return games; }
+
+    // Write the book, sorted for binary search; false if nothing qualifies
+    // or the file can't be written
+    bool write(const std::string& path);
+
+private:
+    struct MoveKey {
+        uint64_t key;
+        uint16_t move;
+        bool operator==(const MoveKey& other) const { return key == other.key && move == other.move; }
+    };
+    struct MoveKeyHash {
+        size_t operator()(const MoveKey& k) const { return size_t(k.key ^ (uint64_t(k.move) * 0x9E3779B97F4A7C15ULL)); }
+    };
+    struct MoveStats {
+        uint32_t games;
+        uint32_t points; // 2 per win, 1 per draw
+    };
+    struct Sample {
+        uint64_t key;
+        uint16_t move;
+        uint8_t points;
+    };
+    struct Shard {
+        std::mutex lock;
+        std::unordered_map<MoveKey, MoveStats, MoveKeyHash> moves;
+    };
+
+    static const int SHARD_BITS = 6;
+
+    int threadCount;
+    int maxPlies;
+    int minGames;
+    std::atomic<uint64_t> games;
+    std::function<void(const std::string&)> log;
+    Shard shards[1 << SHARD_BITS];
+
+    void message(const std::string& text) const { if (log) log(text); }
+    void merge(std::vector<Sample>& samples);
+};
+
+#endif // BOOKBUILDER_H
@@ -1,328 +1,732 @@
 #include "chessai.h"
-#include <cctype>
-#include <climits>
 #include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
 
-ChessAI::ChessAI(Difficulty difficulty) : currentDifficulty(difficulty) {
-    // Initialize random generator with current time
-    auto seed = std::chrono::high_resolution_clock::now().time_since_epoch().count();
-    randomGenerator.seed(seed);
+// PieceValue, PieceSquare, MobilityWeight and the rook and bishop bonuses
+#include "evalparams.inc"
+
+// Above any score a search returns
+static const int INFINITE_SCORE = ChessAI::MATE_SCORE + 1;
+// Half width of the first aspiration window, and the depth it's used from
+static const int ASPIRATION_WINDOW = 50;
+static const int ASPIRATION_DEPTH = 4;
+// Singular extensions: from this depth, a table move at least as deep as
+// depth - SINGULAR_TT_DEPTH is extended when every other move fails below
+// its score less SINGULAR_MARGIN per ply, in a search to half depth
+static const int SINGULAR_DEPTH = 6;
+static const int SINGULAR_TT_DEPTH = 3;
+static const int SINGULAR_MARGIN = 2;
+// Internal iterative reduction (or deepening on the principal variation)
+// of nodes this deep without a table move
+static const int IIR_DEPTH = 5;
+// Random sequence of deterministic mode
+static const uint32_t DETERMINISTIC_SEED = 20240601;
+// Sampling temperature in centipawns added per skill step below full skill
+static const double SKILL_TEMPERATURE_STEP = 12.0;
+
+// Node budget and skill of each difficulty, in enum order
+static const struct {
+    uint64_t nodes;
+    int skill;
+} Levels[] = {
+    {1000, 2},
+    {10000, 8},
+    {100000, 14},
+    {1000000, ChessAI::MAX_SKILL},
+};
+
+ChessAI::ChessAI(Difficulty difficulty) : currentDifficulty(difficulty), evalCacheEnabled(true), useNetwork(true), bookDepth(DEFAULT_BOOK_DEPTH), multiPv(1), deterministic(false), canStop(false), stopped(false) {
+    setDeterministic(false);
+    std::fill(pvLength, pvLength + MAX_PLY, 0);
+    std::fill(excludedMoves, excludedMoves + MAX_PLY, NO_MOVE);
+    rootDepth = 0;
+    setDifficulty(difficulty);
+}
+
+void ChessAI::setDeterministic(bool enabled) {
+    deterministic = enabled;
+    if (enabled) {
+        randomGenerator.seed(DETERMINISTIC_SEED);
+    } else {
+        // Initialize random generator with current time
+        auto seed = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+        randomGenerator.seed(seed);
+    }
 }
 
 void ChessAI::setDifficulty(Difficulty difficulty) {
     currentDifficulty = difficulty;
+    nodeBudget = Levels[difficulty].nodes;
+    skill = Levels[difficulty].skill;
 }
 
-Move ChessAI::getBestMove(const std::vector<std::vector<std::string>>& board, char aiColor) {
-    Move bestMove;
-    int bestScore = (aiColor == 'b') ? INT_MAX : INT_MIN;
-    
-    // Get all possible moves for AI
-    std::vector<Move> possibleMoves = getAllPossibleMoves(board, aiColor);
+void ChessAI::setEvalCacheSize(size_t kilobytes) {
+    evalCacheEnabled = kilobytes > 0;
+    evalCache.resize(evalCacheEnabled ? kilobytes : 1);
+}
+
+bool ChessAI::loadNetwork(const std::string& path) {
+    auto loaded = std::make_shared<NnueNetwork>();
+    if (!loaded->load(path)) {
+        return false;
+    }
+    setNetwork(loaded);
+    return true;
+}
+
+void ChessAI::setNetwork(std::shared_ptr<const NnueNetwork> net) {
+    network = net;
+    nnue.setNetwork(net);
+    evalCache.clear(); // Cached scores came from the other evaluator
+}
+
+void ChessAI::setUseNetwork(bool enabled) {
+    if (enabled != useNetwork) {
+        evalCache.clear();
+    }
+    useNetwork = enabled;
+}
+
+int ChessAI::loadTablebases(const std::string& directory) {
+    auto loaded = std::make_shared<Tablebases>();
+    int count = loaded->load(directory);
+    if (count > 0) {
+        setTablebases(loaded);
+    }
+    return count;
+}
+
+void ChessAI::setTablebases(std::shared_ptr<const Tablebases> tables) {
+    tablebases = tables;
+}
+
+bool ChessAI::loadOpeningBook(const std::string& path) {
+    auto loaded = std::make_shared<OpeningBook>();
+    if (!loaded->open(path)) {
+        return false;
+    }
+    setOpeningBook(loaded);
+    return true;
+}
+
+void ChessAI::setOpeningBook(std::shared_ptr<const OpeningBook> openingBook) {
+    book = openingBook;
+}
+
+bool ChessAI::probeTablebases(const Position& pos, int ply, int& score) {
+    TbResult result;
+    if (!tablebases || !tablebases->canProbe(pos) || !tablebases->probe(pos, result)) {
+        return false;
+    }
+    stats.tablebaseHits++;
     
-    if (possibleMoves.empty()) {
-        return bestMove; // No moves available
+    if (result.wdl == TB_DRAW) {
+        score = DRAW_SCORE;
+    } else {
+        score = result.dtm >= 0 ? MATE_SCORE - (ply + result.dtm) : TB_WIN_SCORE - ply;
+        if (result.wdl == TB_LOSS) score = -score;
+    }
+    return true;
+}
+
+bool ChessAI::probeKpk(const Position& pos, int& score) {
+    if (popCount(pos.pieces()) != 3 || popCount(pos.pieces(PAWN)) != 1) {
+        return false;
     }
+    stats.tablebaseHits++;
     
-    // Order moves for better pruning
-    orderMoves(possibleMoves, board);
+    Square pawn = lsb(pos.pieces(PAWN));
+    Color strong = colorOf(pos.pieceOn(pawn));
+    if (!kpkProbe(pos)) {
+        score = DRAW_SCORE;
+        return true;
+    }
     
-    int alpha = INT_MIN;
-    int beta = INT_MAX;
+    // Reward pushing the pawn so the search makes progress towards promotion
+    score = KPK_WIN_SCORE + 20 * relativeRank(strong, pawn);
+    if (strong == BLACK) score = -score;
+    return true;
+}
+
+Move ChessAI::getBestMove(const Position& position) {
+    auto startTime = std::chrono::steady_clock::now();
+    stats = SearchStats();
+    evalCache.resetStats();
+    pawnHash.resetStats();
+    tt.resetStats();
+    limits = SearchLimits();
+    canStop = stopped = false;
+    principalVariation.clear();
+    rankedLines.clear();
     
-    for (Move& move : possibleMoves) {
-        std::vector<std::vector<std::string>> tempBoard = board;
-        makeMove(tempBoard, move);
-        
-        int score = minimax(tempBoard, currentDifficulty - 1, alpha, beta, 
-                           aiColor == 'w', aiColor, move);
-        
-        move.score = score;
-        
-        if (aiColor == 'b') { // AI is black (minimizing)
-            if (score < bestScore) {
-                bestScore = score;
-                bestMove = move;
-            }
-            beta = std::min(beta, score);
-        } else { // AI is white (maximizing)
-            if (score > bestScore) {
-                bestScore = score;
-                bestMove = move;
-            }
-            alpha = std::max(alpha, score);
+    // Known theory is played straight from the book
+    if (book && position.plyCount() < bookDepth) {
+        PackedMove bookMove = book->pick(position, randomGenerator);
+        if (bookMove != NO_MOVE) {
+            stats.bookMove = true;
+            stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+            return toMove(position, bookMove);
         }
-        
-        if (beta <= alpha) break; // Alpha-beta pruning
     }
     
-    // Add some randomness for same-score moves to make AI less predictable
-    std::vector<Move> bestMoves;
-    for (const Move& move : possibleMoves) {
-        if (move.score == bestScore) {
-            bestMoves.push_back(move);
-        }
+    // With distance-to-mate tables the best move is known without searching
+    PackedMove tbMove;
+    TbResult tbResult;
+    if (tablebases && tablebases->canProbe(position) &&
+        tablebases->probeRoot(position, tbMove, tbResult) && tbMove != NO_MOVE && tbResult.dtm >= 0) {
+        int score;
+        probeTablebases(position, 0, score);
+        Move bestMove = toMove(position, tbMove);
+        bestMove.score = position.sideToMove() == WHITE ? score : -score;
+        principalVariation.assign(1, tbMove);
+        stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        return bestMove;
     }
     
-    if (!bestMoves.empty()) {
-        std::uniform_int_distribution<int> dist(0, bestMoves.size() - 1);
-        bestMove = bestMoves[dist(randomGenerator)];
+    // The budget caps nodes, so strength doesn't depend on the machine,
+    // and time, so slow machines still answer; a deterministic search can't
+    // depend on the clock
+    SearchLimits budget;
+    budget.nodes = nodeBudget;
+    budget.milliseconds = deterministic ? 0 : MOVE_TIME_LIMIT;
+    int requestedLines = multiPv;
+    if (skill < MAX_SKILL) {
+        multiPv = std::max(multiPv, int(SKILL_CANDIDATES));
+    }
+    SearchResult result = search(position, budget);
+    multiPv = requestedLines;
+    if (result.bestMove == NO_MOVE) {
+        return Move(); // No moves available
     }
     
+    const PvLine& line = result.lines[pickLine(result.lines, position.sideToMove() == WHITE)];
+    principalVariation = line.pv;
+    Move bestMove = toMove(position, line.pv[0]);
+    bestMove.score = line.score;
     return bestMove;
 }
 
-int ChessAI::minimax(std::vector<std::vector<std::string>> board, int depth, int alpha, int beta, 
-                     bool maximizing, char aiColor, Move& bestMove) {
-    if (depth == 0) {
-        return evaluateBoard(board, aiColor);
+size_t ChessAI::pickLine(const std::vector<PvLine>& lines, bool white) {
+    // Weight exp(-loss / temperature); at full skill the temperature is 0
+    // and only lines as good as the best are left. That is just the best
+    // line unless several analysis lines were requested with setMultiPv()
+    double temperature = (MAX_SKILL - skill) * SKILL_TEMPERATURE_STEP;
+    int best = white ? lines[0].score : -lines[0].score;
+    std::vector<double> weights;
+    for (const PvLine& line : lines) {
+        int loss = best - (white ? line.score : -line.score);
+        if (temperature > 0) {
+            weights.push_back(std::exp(-loss / temperature));
+        } else {
+            weights.push_back(loss <= 0 ? 1.0 : 0.0);
+        }
     }
+    std::discrete_distribution<size_t> dist(weights.begin(), weights.end());
+    return dist(randomGenerator);
+}
+
+SearchResult ChessAI::search(const Position& position, const SearchLimits& searchLimits) {
+    auto startTime = std::chrono::steady_clock::now();
+    stats = SearchStats();
+    evalCache.resetStats();
+    pawnHash.resetStats();
+    tt.resetStats();
+    limits = searchLimits;
+    searchStart = startTime;
+    canStop = stopped = false;
+    
+    principalVariation.clear();
+    rankedLines.clear();
     
-    char currentColor = maximizing ? 'w' : 'b';
-    std::vector<Move> moves = getAllPossibleMoves(board, currentColor);
+    SearchResult result;
+    Position pos = position;
+    bool white = pos.sideToMove() == WHITE;
     
+    MoveList moves;
+    getAllPossibleMoves(pos, moves);
     if (moves.empty()) {
-        // No moves available - check for checkmate or stalemate
-        return evaluateBoard(board, aiColor);
+        if (pos.inCheck()) result.score = white ? -MATE_SCORE : MATE_SCORE;
+        finishStats(startTime);
+        return result;
     }
+    orderMoves(moves, pos);
     
-    orderMoves(moves, board);
+    int maxDepth = limits.depth > 0 ? std::min(limits.depth, int(MAX_SEARCH_DEPTH)) : MAX_SEARCH_DEPTH;
+    if (!limits.depth && !limits.nodes && !limits.milliseconds) {
+        limits.nodes = nodeBudget;
+    }
     
-    if (maximizing) {
-        int maxScore = INT_MIN;
-        for (const Move& move : moves) {
-            makeMove(board, move);
-            Move dummy;
-            int score = minimax(board, depth - 1, alpha, beta, false, aiColor, dummy);
-            undoMove(board, move);
-            
-            maxScore = std::max(maxScore, score);
-            alpha = std::max(alpha, score);
-            
-            if (beta <= alpha) break; // Alpha-beta pruning
-        }
-        return maxScore;
-    } else {
-        int minScore = INT_MAX;
-        for (const Move& move : moves) {
-            makeMove(board, move);
-            Move dummy;
-            int score = minimax(board, depth - 1, alpha, beta, true, aiColor, dummy);
-            undoMove(board, move);
+    // Lines are searched in rank order, each aspiring to its own last score
+    int lineCount = std::min(multiPv, int(moves.size()));
+    std::vector<int> previousScores(lineCount, 0);
+    for (int depth = 1; depth <= maxDepth; ++depth) {
+        std::vector<PvLine> lines;
+        for (int rank = 0; rank < lineCount; ++rank) {
+            // Aspiration: expect a score near the last one and widen the side
+            // that fails until the score falls inside the window
+            int window = ASPIRATION_WINDOW;
+            int alpha = -INFINITE_SCORE;
+            int beta = INFINITE_SCORE;
+            if (depth >= ASPIRATION_DEPTH && std::abs(previousScores[rank]) < MATE_BOUND) {
+                alpha = std::max(previousScores[rank] - window, -INFINITE_SCORE);
+                beta = std::min(previousScores[rank] + window, int(INFINITE_SCORE));
+            }
             
-            minScore = std::min(minScore, score);
-            beta = std::min(beta, score);
+            int score;
+            for (;;) {
+                // Moves ranked already in this iteration are at the front
+                score = searchRoot(pos, moves.begin() + rank, moves.end(), depth, alpha, beta);
+                if (stopped) break;
+                
+                window *= 2;
+                if (score <= alpha) {
+                    alpha = std::max(score - window, -INFINITE_SCORE);
+                } else if (score >= beta) {
+                    beta = std::min(score + window, int(INFINITE_SCORE));
+                } else {
+                    break;
+                }
+            }
+            if (stopped) break;
             
-            if (beta <= alpha) break; // Alpha-beta pruning
+            // The move found leads its rank, and the next iteration
+            PackedMove* bestAt = std::find(moves.begin() + rank, moves.end(), pvTable[0][0]);
+            std::rotate(moves.begin() + rank, bestAt, bestAt + 1);
+            previousScores[rank] = score;
+            lines.push_back({white ? score : -score, rootPv()});
+            if (onLine) onLine(depth, rank, lines.back());
         }
-        return minScore;
+        if (stopped) break;
+        
+        principalVariation = lines[0].pv;
+        result.bestMove = principalVariation[0];
+        result.score = lines[0].score;
+        result.depth = depth;
+        result.nodes = stats.nodes;
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        result.pv = principalVariation;
+        result.lines = lines;
+        rankedLines = lines;
+        canStop = true;
+        if (onIteration) onIteration(result);
+        
+        // The next iteration takes several times longer; don't start what can't finish
+        if (limits.milliseconds &&
+            std::chrono::steady_clock::now() - searchStart > std::chrono::milliseconds(limits.milliseconds) / 2) break;
+        if (limits.nodes && stats.nodes >= limits.nodes) break;
     }
+    
+    stats.depth = result.depth;
+    finishStats(startTime);
+    return result;
 }
 
-int ChessAI::evaluateBoard(const std::vector<std::vector<std::string>>& board, char aiColor) {
-    int score = 0;
+int ChessAI::searchRoot(Position& pos, PackedMove* begin, PackedMove* end, int depth, int alpha, int beta) {
+    int bestScore = -INFINITE_SCORE;
+    pvLength[0] = 0;
+    rootDepth = depth;
+    bool first = true;
     
-    for (int row = 0; row < 8; ++row) {
-        for (int col = 0; col < 8; ++col) {
-            const std::string& piece = board[row][col];
-            if (!piece.empty()) {
-                char pieceColor = getPieceColor(piece);
-                int pieceValue = getPieceValue(piece);
-                int positionValue = getPositionValue(piece, row, col);
-                
-                int totalValue = pieceValue + positionValue;
-                
-                if (pieceColor == aiColor) {
-                    score += totalValue;
-                } else {
-                    score -= totalValue;
-                }
+    for (PackedMove* it = begin; it != end; ++it) {
+        PackedMove move = *it;
+        pos.makeMove(move);
+        int newDepth = pos.inCheck() ? depth : depth - 1; // Check extension
+        int score;
+        if (first) {
+            score = -negamax(pos, newDepth, 1, -beta, -alpha);
+        } else {
+            score = -negamax(pos, newDepth, 1, -alpha - 1, -alpha);
+            if (score > alpha && score < beta && !stopped) {
+                score = -negamax(pos, newDepth, 1, -beta, -alpha);
+            }
+        }
+        pos.unmakeMove(move);
+        if (stopped) return 0;
+        first = false;
+        
+        if (score > bestScore) {
+            bestScore = score;
+            if (score > alpha) {
+                alpha = score;
+                updatePv(0, move);
             }
         }
+        if (alpha >= beta) break;
+    }
+    return bestScore;
+}
+
+void ChessAI::updatePv(int ply, PackedMove move) {
+    pvTable[ply][ply] = move;
+    int length = ply + 1 < MAX_PLY ? pvLength[ply + 1] : ply + 1;
+    for (int i = ply + 1; i < length; ++i) {
+        pvTable[ply][i] = pvTable[ply + 1][i];
     }
+    pvLength[ply] = length;
+}
+
+std::vector<PackedMove> ChessAI::rootPv() const {
+    return std::vector<PackedMove>(pvTable[0], pvTable[0] + pvLength[0]);
+}
+
+bool ChessAI::outOfBudget() const {
+    if (limits.nodes && stats.nodes >= limits.nodes) return true;
+    return limits.milliseconds &&
+           std::chrono::steady_clock::now() - searchStart >= std::chrono::milliseconds(limits.milliseconds);
+}
+
+void ChessAI::finishStats(std::chrono::steady_clock::time_point startTime) {
+    stats.evalCacheProbes = evalCache.probes();
+    stats.evalCacheHits = evalCache.hits();
+    stats.pawnTableProbes = pawnHash.probes();
+    stats.pawnTableHits = pawnHash.hits();
+    stats.ttProbes = tt.probes();
+    stats.ttHits = tt.hits();
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+// Decisive scores are stored counted from the node, not the root, so they
+// stay right when the position is reached at another ply
+static bool isDecisive(int score) {
+    return std::abs(score) >= ChessAI::TB_WIN_SCORE - 1000;
+}
+
+static int scoreToTt(int score, int ply) {
+    return isDecisive(score) ? (score > 0 ? score + ply : score - ply) : score;
+}
+
+static int scoreFromTt(int score, int ply) {
+    return isDecisive(score) ? (score > 0 ? score - ply : score + ply) : score;
+}
+
+Move ChessAI::toMove(const Position& position, PackedMove move) {
+    Square from = moveFrom(move), to = moveTo(move);
+    Move result(rowOf(from), colOf(from), rowOf(to), colOf(to));
+    result.packed = move;
     
-    return score;
+    Square capSq = moveFlags(move) == EP_CAPTURE ? Square(to ^ 8) : to;
+    if (isCaptureMove(move)) {
+        result.capturedPiece = std::string(1, pieceToChar(position.pieceOn(capSq)));
+    }
+    if (isPromotionMove(move)) {
+        result.promotion = "nbrq"[promotionType(move) - KNIGHT];
+    }
+    return result;
 }
 
-std::vector<Move> ChessAI::getAllPossibleMoves(const std::vector<std::vector<std::string>>& board, char color) {
-    std::vector<Move> moves;
-    
-    for (int fromRow = 0; fromRow < 8; ++fromRow) {
-        for (int fromCol = 0; fromCol < 8; ++fromCol) {
-            const std::string& piece = board[fromRow][fromCol];
-            if (!piece.empty() && getPieceColor(piece) == color) {
-                for (int toRow = 0; toRow < 8; ++toRow) {
-                    for (int toCol = 0; toCol < 8; ++toCol) {
-                        if (isValidMove(board, fromRow, fromCol, toRow, toCol)) {
-                            Move move(fromRow, fromCol, toRow, toCol);
-                            move.capturedPiece = board[toRow][toCol];
-                            moves.push_back(move);
-                        }
-                    }
-                }
+int ChessAI::negamax(Position& pos, int depth, int ply, int alpha, int beta) {
+    stats.nodes++;
+    pvLength[ply] = ply;
+    
+    // Budget checks; the clock is only read every 1024 nodes
+    if (canStop && ((limits.nodes && stats.nodes >= limits.nodes) ||
+                    (limits.milliseconds && (stats.nodes & 1023) == 0 && outOfBudget()))) {
+        stopped = true;
+    }
+    if (stopped) return 0;
+    
+    // Draws that need no move generation; a single repetition inside the
+    // search is enough since the side to move could repeat again
+    if (pos.isRepetition() || pos.hasInsufficientMaterial() ||
+        (pos.halfmoveClock() >= 100 && !pos.inCheck())) {
+        return DRAW_SCORE;
+    }
+    
+    // Exact result in covered endgames
+    bool white = pos.sideToMove() == WHITE;
+    int tbScore;
+    if (probeTablebases(pos, ply, tbScore)) {
+        return tbScore;
+    }
+    if (probeKpk(pos, tbScore)) {
+        return white ? tbScore : -tbScore;
+    }
+    
+    if (depth == 0 || ply >= MAX_PLY - 1) {
+        return white ? evaluate(pos) : -evaluate(pos);
+    }
+    
+    // A stored result deep enough may settle the node, but not on the
+    // principal variation, whose line is wanted in full; a stored move goes
+    // first. An exclusion search shares the key but not the moves, so it
+    // leaves the table alone.
+    bool pvNode = beta - alpha > 1;
+    PackedMove excluded = excludedMoves[ply];
+    TtEntry entry = TtEntry();
+    bool ttHit = excluded == NO_MOVE && tt.probe(pos.key(), entry);
+    PackedMove ttMove = NO_MOVE;
+    int ttScore = 0;
+    if (ttHit) {
+        ttMove = entry.move;
+        ttScore = scoreFromTt(entry.score, ply);
+        if (!pvNode && entry.depth >= depth &&
+            (entry.bound == TT_EXACT || (entry.bound == TT_LOWER && ttScore >= beta) ||
+             (entry.bound == TT_UPPER && ttScore <= alpha))) {
+            return ttScore;
+        }
+    }
+    
+    // Without a move to try first the node is likely badly ordered: on the
+    // principal variation a shallower search finds one, elsewhere the node
+    // is not worth its full depth
+    if (ttMove == NO_MOVE && depth >= IIR_DEPTH && excluded == NO_MOVE) {
+        if (pvNode) {
+            negamax(pos, depth - 2, ply, alpha, beta);
+            pvLength[ply] = ply;
+            if (stopped) return 0;
+            if (tt.probe(pos.key(), entry)) ttMove = entry.move;
+        } else {
+            depth--;
+        }
+    }
+    
+    MoveList moves;
+    getAllPossibleMoves(pos, moves);
+    
+    if (moves.empty()) {
+        // Checkmate or stalemate; nearer mates score higher for the winner
+        if (!pos.inCheck()) return DRAW_SCORE;
+        return -(MATE_SCORE - ply);
+    }
+    
+    if (pos.halfmoveClock() >= 100) {
+        return DRAW_SCORE; // In check but not mated on the hundredth half-move
+    }
+    
+    orderMoves(moves, pos);
+    PackedMove* ttMoveAt = std::find(moves.begin(), moves.end(), ttMove);
+    if (ttMoveAt != moves.end()) {
+        std::rotate(moves.begin(), ttMoveAt, ttMoveAt + 1);
+    }
+    
+    // Extensions are kept to lines at most twice the iteration's depth
+    bool canExtend = ply < 2 * rootDepth;
+    
+    // Singular extension: when the table move is the only one near its
+    // score, the position hinges on it and it gets another ply. The other
+    // moves are tried at half depth against a bound below that score.
+    bool singular = false;
+    if (canExtend && depth >= SINGULAR_DEPTH && ttHit && ttMove == moves[0] && entry.bound != TT_UPPER &&
+        entry.depth >= depth - SINGULAR_TT_DEPTH && std::abs(ttScore) < MATE_BOUND) {
+        int singularBeta = ttScore - SINGULAR_MARGIN * depth;
+        excludedMoves[ply] = ttMove;
+        int score = negamax(pos, (depth - 1) / 2, ply, singularBeta - 1, singularBeta);
+        excludedMoves[ply] = NO_MOVE;
+        pvLength[ply] = ply;
+        if (stopped) return 0;
+        singular = score < singularBeta;
+    }
+    
+    int alphaOrig = alpha;
+    int bestScore = -INFINITE_SCORE;
+    PackedMove bestMove = NO_MOVE;
+    bool first = true;
+    
+    for (PackedMove move : moves) {
+        if (move == excluded) continue;
+        pos.makeMove(move);
+        // Checks are extended, since the reply is forced and the line may
+        // end in mate just past the horizon
+        int newDepth = depth - 1;
+        if (canExtend && (pos.inCheck() || (singular && move == ttMove))) {
+            newDepth++;
+        }
+        int score;
+        if (first) {
+            score = -negamax(pos, newDepth, ply + 1, -beta, -alpha);
+        } else {
+            // Zero window: only whether the move beats alpha
+            score = -negamax(pos, newDepth, ply + 1, -alpha - 1, -alpha);
+            if (score > alpha && score < beta && !stopped) {
+                score = -negamax(pos, newDepth, ply + 1, -beta, -alpha);
+            }
+        }
+        pos.unmakeMove(move);
+        if (stopped) return 0;
+        first = false;
+        
+        if (score > bestScore) {
+            bestScore = score;
+            bestMove = move;
+            if (score > alpha) {
+                alpha = score;
+                updatePv(ply, move);
             }
         }
+        if (alpha >= beta) break; // Beta cutoff
     }
     
-    return moves;
+    if (excluded != NO_MOVE) {
+        return bestMove == NO_MOVE ? alpha : bestScore; // The excluded move was the only one
+    }
+    TtBound bound = bestScore <= alphaOrig ? TT_UPPER : bestScore >= beta ? TT_LOWER : TT_EXACT;
+    tt.store(pos.key(), scoreToTt(bestScore, ply), bestMove, depth, bound);
+    return bestScore;
 }
 
-bool ChessAI::isValidMove(const std::vector<std::vector<std::string>>& board, int fromRow, int fromCol, int toRow, int toCol) {
-    if (board[fromRow][fromCol].empty()) return false;
+int ChessAI::evaluate(const Position& pos) {
+    int score;
+    if (evalCacheEnabled && evalCache.probe(pos.key(), score)) {
+        return score;
+    }
     
-    std::string piece = board[fromRow][fromCol];
-    char race = getPieceColor(piece);
-    char name = std::tolower(piece[0]);
+    if (isUsingNetwork()) {
+        score = nnue.evaluate(pos);
+        if (pos.sideToMove() == BLACK) score = -score;
+    } else {
+        score = evaluateBoard(pos);
+    }
     
-    return CheckIfValidMove(fromRow, fromCol, toRow, toCol, 
-                           const_cast<std::vector<std::vector<std::string>>&>(board), race, name);
+    if (evalCacheEnabled) {
+        evalCache.store(pos.key(), score);
+    }
+    return score;
 }
 
-void ChessAI::makeMove(std::vector<std::vector<std::string>>& board, const Move& move) {
-    board[move.toRow][move.toCol] = board[move.fromRow][move.fromCol];
-    board[move.fromRow][move.fromCol] = "";
-}
+// Game phase weight of each piece type; 24 means all minor and major pieces are on
+static const int PhaseWeight[6] = {0, 1, 1, 2, 4, 0};
+static const int MaxPhase = 24;
+
+// Typical number of reachable squares; MobilityWeight counts the squares beyond it
+static const int MobilityBase[6] = {0, 4, 6, 7, 13, 0};
 
-void ChessAI::undoMove(std::vector<std::vector<std::string>>& board, const Move& move) {
-    board[move.fromRow][move.fromCol] = board[move.toRow][move.toCol];
-    board[move.toRow][move.toCol] = move.capturedPiece;
+// Attack units per square of the enemy king zone a piece hits
+static const int KingAttackWeight[6] = {0, 2, 2, 3, 5, 0};
+
+// Piece-square table index; the tables are drawn with the 8th rank on top, as seen by white
+static int tableIndex(Piece piece, Square square) {
+    int row = colorOf(piece) == WHITE ? rowOf(square) : rankOf(square);
+    return row * 8 + colOf(square);
 }
 
-int ChessAI::getPieceValue(const std::string& piece) {
-    if (piece.empty()) return 0;
-    
-    char p = std::tolower(piece[0]);
-    switch (p) {
-        case 'p': return 100;   // Pawn
-        case 'n': return 320;   // Knight
-        case 'b': return 330;   // Bishop
-        case 'r': return 500;   // Rook
-        case 'q': return 900;   // Queen
-        case 'k': return 20000; // King
-        default: return 0;
-    }
+int ChessAI::traceEvaluation(const Position& pos, EvalTrace& trace) {
+    std::memset(&trace, 0, sizeof(trace));
+    return evaluateBoard(pos, &trace);
 }
 
-char ChessAI::getPieceColor(const std::string& piece) {
-    if (piece.empty()) return 'n';
-    return std::isupper(piece[0]) ? 'w' : 'b';
-}
-
-int ChessAI::getPositionValue(const std::string& piece, int row, int col) {
-    if (piece.empty()) return 0;
-    
-    char p = std::tolower(piece[0]);
-    
-    // Position value tables (from white's perspective)
-    static const int pawnTable[8][8] = {
-        {0,  0,  0,  0,  0,  0,  0,  0},
-        {50, 50, 50, 50, 50, 50, 50, 50},
-        {10, 10, 20, 30, 30, 20, 10, 10},
-        {5,  5, 10, 25, 25, 10,  5,  5},
-        {0,  0,  0, 20, 20,  0,  0,  0},
-        {5, -5,-10,  0,  0,-10, -5,  5},
-        {5, 10, 10,-20,-20, 10, 10,  5},
-        {0,  0,  0,  0,  0,  0,  0,  0}
-    };
-    
-    static const int knightTable[8][8] = {
-        {-50,-40,-30,-30,-30,-30,-40,-50},
-        {-40,-20,  0,  0,  0,  0,-20,-40},
-        {-30,  0, 10, 15, 15, 10,  0,-30},
-        {-30,  5, 15, 20, 20, 15,  5,-30},
-        {-30,  0, 15, 20, 20, 15,  0,-30},
-        {-30,  5, 10, 15, 15, 10,  5,-30},
-        {-40,-20,  0,  5,  5,  0,-20,-40},
-        {-50,-40,-30,-30,-30,-30,-40,-50}
-    };
-    
-    static const int bishopTable[8][8] = {
-        {-20,-10,-10,-10,-10,-10,-10,-20},
-        {-10,  0,  0,  0,  0,  0,  0,-10},
-        {-10,  0,  5, 10, 10,  5,  0,-10},
-        {-10,  5,  5, 10, 10,  5,  5,-10},
-        {-10,  0, 10, 10, 10, 10,  0,-10},
-        {-10, 10, 10, 10, 10, 10, 10,-10},
-        {-10,  5,  0,  0,  0,  0,  5,-10},
-        {-20,-10,-10,-10,-10,-10,-10,-20}
-    };
-    
-    static const int rookTable[8][8] = {
-        { 0,  0,  0,  0,  0,  0,  0,  0},
-        { 5, 10, 10, 10, 10, 10, 10,  5},
-        {-5,  0,  0,  0,  0,  0,  0, -5},
-        {-5,  0,  0,  0,  0,  0,  0, -5},
-        {-5,  0,  0,  0,  0,  0,  0, -5},
-        {-5,  0,  0,  0,  0,  0,  0, -5},
-        {-5,  0,  0,  0,  0,  0,  0, -5},
-        { 0,  0,  0,  5,  5,  0,  0,  0}
-    };
-    
-    static const int queenTable[8][8] = {
-        {-20,-10,-10, -5, -5,-10,-10,-20},
-        {-10,  0,  0,  0,  0,  0,  0,-10},
-        {-10,  0,  5,  5,  5,  5,  0,-10},
-        { -5,  0,  5,  5,  5,  5,  0, -5},
-        {  0,  0,  5,  5,  5,  5,  0, -5},
-        {-10,  5,  5,  5,  5,  5,  0,-10},
-        {-10,  0,  5,  0,  0,  0,  0,-10},
-        {-20,-10,-10, -5, -5,-10,-10,-20}
-    };
-    
-    static const int kingTable[8][8] = {
-        {-30,-40,-40,-50,-50,-40,-40,-30},
-        {-30,-40,-40,-50,-50,-40,-40,-30},
-        {-30,-40,-40,-50,-50,-40,-40,-30},
-        {-30,-40,-40,-50,-50,-40,-40,-30},
-        {-20,-30,-30,-40,-40,-30,-30,-20},
-        {-10,-20,-20,-20,-20,-20,-20,-10},
-        { 20, 20,  0,  0,  0,  0, 20, 20},
-        { 20, 30, 10,  0,  0, 10, 30, 20}
-    };
-    
-    int value = 0;
-    bool isWhite = std::isupper(piece[0]);
-    int actualRow = isWhite ? row : (7 - row);
-    
-    switch (p) {
-        case 'p': value = pawnTable[actualRow][col]; break;
-        case 'n': value = knightTable[actualRow][col]; break;
-        case 'b': value = bishopTable[actualRow][col]; break;
-        case 'r': value = rookTable[actualRow][col]; break;
-        case 'q': value = queenTable[actualRow][col]; break;
-        case 'k': value = kingTable[actualRow][col]; break;
-    }
-    
-    return isWhite ? value : -value;
-}
-
-bool ChessAI::isUnderAttack(const std::vector<std::vector<std::string>>& board, int row, int col, char attackingColor) {
-    for (int fromRow = 0; fromRow < 8; ++fromRow) {
-        for (int fromCol = 0; fromCol < 8; ++fromCol) {
-            const std::string& piece = board[fromRow][fromCol];
-            if (!piece.empty() && getPieceColor(piece) == attackingColor) {
-                if (isValidMove(board, fromRow, fromCol, row, col)) {
-                    return true;
+int ChessAI::evaluateBoard(const Position& pos, EvalTrace* trace) {
+    int mg[2] = {0, 0}, eg[2] = {0, 0};
+    int phase = 0;
+    
+    // Pawn structure rarely changes, so it comes from the pawn hash table
+    PawnEntry* pawns = pawnHash.probe(pos);
+    Bitboard occupied = pos.pieces();
+    
+    for (int c = WHITE; c <= BLACK; ++c) {
+        Color us = Color(c), them = ~us;
+        
+        // Squares worth counting for mobility: not our own pieces, not covered by enemy pawns
+        Bitboard mobilityArea = ~pos.pieces(us) & ~pawns->pawnAttacks[them];
+        Square theirKing = pos.kingSquare(them);
+        Bitboard kingZone = KingAttacks[theirKing] | squareBB(theirKing);
+        int attackUnits = 0, attackers = 0;
+        int sign = us == WHITE ? 1 : -1; // For the trace, which counts white minus black
+        
+        for (Bitboard b = pos.pieces(us); b;) {
+            Square square = popLsb(b);
+            Piece piece = pos.pieceOn(square);
+            PieceType type = typeOf(piece);
+            
+            mg[us] += PieceValue[type][0] + getPositionValue(piece, square, false);
+            eg[us] += PieceValue[type][1] + getPositionValue(piece, square, true);
+            phase += PhaseWeight[type];
+            if (trace) {
+                trace->material[type] += sign;
+                trace->pieceSquare[type][tableIndex(piece, square)] += sign;
+            }
+            
+            if (type == PAWN || type == KING) continue;
+            
+            Bitboard attacks = pieceAttacks(type, square, occupied);
+            int mobility = popCount(attacks & mobilityArea) - MobilityBase[type];
+            mg[us] += mobility * MobilityWeight[type][0];
+            eg[us] += mobility * MobilityWeight[type][1];
+            if (trace) trace->mobility[type] += sign * mobility;
+            
+            if (attacks & kingZone) {
+                ++attackers;
+                attackUnits += KingAttackWeight[type] * popCount(attacks & kingZone);
+            }
+            
+            if (type == ROOK) {
+                int file = fileOf(square);
+                bool semiOpen = pawns->semiOpenFiles[us] & (1 << file);
+                if (semiOpen && (pawns->semiOpenFiles[them] & (1 << file))) {
+                    mg[us] += RookOpenFileBonus[0];
+                    eg[us] += RookOpenFileBonus[1];
+                    if (trace) trace->rookOpenFile += sign;
+                } else if (semiOpen) {
+                    mg[us] += RookSemiOpenFileBonus[0];
+                    eg[us] += RookSemiOpenFileBonus[1];
+                    if (trace) trace->rookSemiOpenFile += sign;
                 }
             }
         }
+        
+        // A lone attacker is rarely dangerous; two or more grow quadratically
+        if (attackers >= 2) {
+            int danger = attackUnits * attackUnits / 2;
+            mg[us] += danger < 500 ? danger : 500;
+        }
+        
+        if (popCount(pos.pieces(us, BISHOP)) >= 2) {
+            mg[us] += BishopPairBonus[0];
+            eg[us] += BishopPairBonus[1];
+            if (trace) trace->bishopPair += sign;
+        }
+        
+        // King shelter is a middlegame term; the taper fades it out
+        mg[us] += pawnHash.kingShelter(pos, pawns, us);
+    }
+    
+    int mgScore = mg[WHITE] - mg[BLACK] + pawns->scoreMg;
+    int egScore = eg[WHITE] - eg[BLACK] + pawns->scoreEg;
+    if (phase > MaxPhase) phase = MaxPhase; // Early promotions
+    if (trace) trace->phase = phase;
+    
+    return (mgScore * phase + egScore * (MaxPhase - phase)) / MaxPhase;
+}
+
+void ChessAI::getAllPossibleMoves(const Position& pos, MoveList& moves) {
+    generateLegalMoves(pos, moves);
+}
+
+int ChessAI::getPieceValue(PieceType type) {
+    switch (type) {
+        case PAWN:   return 100;   // Pawn
+        case KNIGHT: return 320;   // Knight
+        case BISHOP: return 330;   // Bishop
+        case ROOK:   return 500;   // Rook
+        case QUEEN:  return 900;   // Queen
+        case KING:   return 20000; // King
+        default: return 0;
     }
-    return false;
 }
 
-void ChessAI::orderMoves(std::vector<Move>& moves, const std::vector<std::vector<std::string>>& board) {
-    // Simple move ordering: captures first, then other moves
-    std::sort(moves.begin(), moves.end(), [&board](const Move& a, const Move& b) {
-        bool aIsCapture = !board[a.toRow][a.toCol].empty();
-        bool bIsCapture = !board[b.toRow][b.toCol].empty();
+int ChessAI::getPositionValue(Piece piece, Square square, bool endgame) {
+    if (piece == NO_PIECE) return 0;
+    return PieceSquare[typeOf(piece)][endgame ? 1 : 0][tableIndex(piece, square)];
+}
+
+bool ChessAI::isUnderAttack(const Position& pos, Square square, Color attackingColor) {
+    return pos.isAttacked(square, attackingColor);
+}
+
+void ChessAI::orderMoves(MoveList& moves, const Position& pos) {
+    // Simple move ordering: captures first (most valuable victim first), then other moves
+    std::sort(moves.begin(), moves.end(), [this, &pos](PackedMove a, PackedMove b) {
+        bool aIsCapture = isCaptureMove(a);
+        bool bIsCapture = isCaptureMove(b);
         
         if (aIsCapture && !bIsCapture) return true;
         if (!aIsCapture && bIsCapture) return false;
         
         if (aIsCapture && bIsCapture) {
-            // Order captures by captured piece value
-            int aValue = ChessAI().getPieceValue(board[a.toRow][a.toCol]);
-            int bValue = ChessAI().getPieceValue(board[b.toRow][b.toCol]);
+            // Order captures by captured piece value (en passant always takes a pawn)
+            int aValue = moveFlags(a) == EP_CAPTURE ? getPieceValue(PAWN) : getPieceValue(typeOf(pos.pieceOn(moveTo(a))));
+            int bValue = moveFlags(b) == EP_CAPTURE ? getPieceValue(PAWN) : getPieceValue(typeOf(pos.pieceOn(moveTo(b))));
             return aValue > bValue;
         }
         
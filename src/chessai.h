@@ -6,79 +6,315 @@
 #include <limits>
 #include <algorithm>
 #include <random>
+#include <chrono>
+#include <functional>
+#include "position.h"
+#include "movegen.h"
+#include "pawntable.h"
+#include "evalcache.h"
+#include "nnue.h"
+#include "tablebase.h"
+#include "kpk.h"
+#include "openingbook.h"
+#include "transposition.h"
 
 struct Move {
     int fromRow, fromCol;
     int toRow, toCol;
     int score;
     std::string capturedPiece;
-    
-    Move() : fromRow(-1), fromCol(-1), toRow(-1), toCol(-1), score(0), capturedPiece("") {}
-    Move(int fr, int fc, int tr, int tc) : fromRow(fr), fromCol(fc), toRow(tr), toCol(tc), score(0), capturedPiece("") {}
+    char promotion;      // 'q', 'r', 'b', 'n' or 0
+    PackedMove packed;   // Engine encoding, NO_MOVE if unknown
+
+    Move() : fromRow(-1), fromCol(-1), toRow(-1), toCol(-1), score(0), capturedPiece(""), promotion(0), packed(NO_MOVE) {}
+    Move(int fr, int fc, int tr, int tc) : fromRow(fr), fromCol(fc), toRow(tr), toCol(tc), score(0), capturedPiece(""), promotion(0), packed(NO_MOVE) {}
+};
+
+// Counters for the most recent search
+struct SearchStats {
+    uint64_t nodes;
+    uint64_t evalCacheProbes;
+    uint64_t evalCacheHits;
+    uint64_t pawnTableProbes;
+    uint64_t pawnTableHits;
+    uint64_t tablebaseHits;
+    uint64_t ttProbes;
+    uint64_t ttHits;
+    int depth;          // Deepest completed iteration of search()
+    bool bookMove;      // The move came from the opening book without a search
+    double seconds;
+
+    SearchStats() : nodes(0), evalCacheProbes(0), evalCacheHits(0), pawnTableProbes(0), pawnTableHits(0), tablebaseHits(0), ttProbes(0), ttHits(0), depth(0), bookMove(false), seconds(0) {}
+
+    double evalCacheHitRate() const { return evalCacheProbes ? double(evalCacheHits) / evalCacheProbes : 0.0; }
+    double pawnTableHitRate() const { return pawnTableProbes ? double(pawnTableHits) / pawnTableProbes : 0.0; }
+    double ttHitRate() const { return ttProbes ? double(ttHits) / ttProbes : 0.0; }
+    double nodesPerSecond() const { return seconds > 0 ? nodes / seconds : 0.0; }
+};
+
+// How often each tunable term of the hand-written evaluation occurs in a
+// position, white's count minus black's. The evaluation is linear in these
+// weights within each phase, which is what the tuner relies on.
+struct EvalTrace {
+    int phase;              // 24 with all pieces on, 0 with only kings and pawns
+    int material[6];
+    int pieceSquare[6][64]; // Indexed like the tables in evalparams.inc
+    int mobility[6];        // Reachable squares beyond the typical count
+    int rookOpenFile;
+    int rookSemiOpenFile;
+    int bishopPair;
+};
+
+// Budget for ChessAI::search(); zero means no limit
+struct SearchLimits {
+    int depth;
+    uint64_t nodes;
+    int milliseconds;
+
+    SearchLimits() : depth(0), nodes(0), milliseconds(0) {}
+};
+
+// One ranked root move of search() with the line expected after it
+struct PvLine {
+    int score;                  // From white's point of view
+    std::vector<PackedMove> pv; // Starting with the root move
+};
+
+struct SearchResult {
+    PackedMove bestMove; // NO_MOVE if the side to move has no legal move
+    int score;           // From white's point of view, like Move::score
+    int depth;           // Deepest completed iteration
+    uint64_t nodes;      // Searched when that iteration completed
+    double seconds;
+    std::vector<PackedMove> pv; // Expected line, starting with bestMove
+    std::vector<PvLine> lines;  // Best first; more than one with setMultiPv()
+
+    SearchResult() : bestMove(NO_MOVE), score(0), depth(0), nodes(0), seconds(0) {}
 };
 
 class ChessAI {
 public:
+    // Levels are a node budget and a skill (see setSkill()), not a depth,
+    // so every level answers in about the same time whatever the position
     enum Difficulty {
-        EASY = 2,     // Depth 2
-        MEDIUM = 3,   // Depth 3
-        HARD = 4,     // Depth 4
-        EXPERT = 5    // Depth 5
+        EASY,     // 1000 nodes, skill 2
+        MEDIUM,   // 10000 nodes, skill 8
+        HARD,     // 100000 nodes, skill 14
+        EXPERT    // 1000000 nodes, full skill
     };
-    
+
+    // Scores beyond MATE_BOUND are forced mates, MATE_SCORE - |score| plies away
+    static const int MATE_SCORE = 100000;
+    static const int MATE_BOUND = MATE_SCORE - 1000;
+    static const int DRAW_SCORE = 0;
+    // Tablebase win without a known distance (WDL-only tables)
+    static const int TB_WIN_SCORE = MATE_BOUND - 1000;
+    // Won king and pawn ending; below a new queen so promoting still pays
+    static const int KPK_WIN_SCORE = 500;
+    // Plies of a game the opening book is used for
+    static const int DEFAULT_BOOK_DEPTH = 20;
+    // Deepest iteration search() starts
+    static const int MAX_SEARCH_DEPTH = 64;
+    // Deepest ply a search reaches, and the longest principal variation
+    static const int MAX_PLY = 128;
+    // Skill of full strength: always one of the best moves
+    static const int MAX_SKILL = 20;
+    // Lines ranked for a getBestMove() below full skill to sample from
+    static const int SKILL_CANDIDATES = 4;
+    // Longest any getBestMove() search runs, whatever its node budget
+    static const int MOVE_TIME_LIMIT = 2000;
+
     ChessAI(Difficulty difficulty = MEDIUM);
+
+    // Main AI function to get the best move for the side to move: a search
+    // to the node budget, then a move sampled by skill from the ranked lines
+    Move getBestMove(const Position& position);
+
+    // Iterative deepening until a limit is reached; an iteration cut short
+    // is thrown away, but the first one always completes. Without limits the
+    // node budget is used. Unlike getBestMove() there are no book moves and
+    // no random choice between moves.
+    SearchResult search(const Position& position, const SearchLimits& limits);
+
+    // Called by search() after every completed iteration
+    void setIterationCallback(std::function<void(const SearchResult&)> callback) { onIteration = callback; }
+
+    // Number of best root moves search() ranks (default 1). Each line after
+    // the first searches the root without the moves already ranked in that
+    // iteration, sharing the transposition table.
+    void setMultiPv(int lines) { multiPv = std::max(1, lines); }
+    int getMultiPv() const { return multiPv; }
+
+    // Called by search() as soon as each line of an iteration is complete;
+    // rank 0 is the best move
+    void setLineCallback(std::function<void(int depth, int rank, const PvLine&)> callback) { onLine = callback; }
     
-    // Main AI function to get the best move
-    Move getBestMove(const std::vector<std::vector<std::string>>& board, char aiColor);
-    
-    // Set AI difficulty
+    // Set AI difficulty: its node budget and skill
     void setDifficulty(Difficulty difficulty);
-    
+
     // Get current difficulty
     Difficulty getDifficulty() const { return currentDifficulty; }
+
+    // Nodes a getBestMove() search may take; also set by setDifficulty()
+    void setNodeBudget(uint64_t nodes) { nodeBudget = std::max<uint64_t>(nodes, 1); }
+    uint64_t getNodeBudget() const { return nodeBudget; }
+
+    // Skill 0 to MAX_SKILL; also set by setDifficulty(). Below MAX_SKILL,
+    // getBestMove() ranks SKILL_CANDIDATES lines and samples one, weighting
+    // each by how far it is below the best, more leniently the lower the skill.
+    // At MAX_SKILL the best line is played.
+    void setSkill(int level) { skill = std::max(0, std::min(int(MAX_SKILL), level)); }
+    int getSkill() const { return skill; }
+
+    // Deterministic mode: the random choices (book moves and skill
+    // sampling) follow a fixed seed and getBestMove() has no time cap, so
+    // the same calls in the same order give the same moves and node counts
+    // however fast the machine is. Turning it on restarts the sequence.
+    void setDeterministic(bool enabled);
+    bool isDeterministic() const { return deterministic; }
+
+    // Evaluation cache size; 0 disables the cache
+    void setEvalCacheSize(size_t kilobytes);
     
+    // Transposition table size; every instance has its own table
+    void setHashSize(size_t kilobytes) { tt.resize(kilobytes); }
+    void clearHash() { tt.clear(); }
+
+    // Optional neural network evaluation; falls back to the hand-written
+    // evaluation when no network is loaded
+    bool loadNetwork(const std::string& path);
+    void setNetwork(std::shared_ptr<const NnueNetwork> network); // Share one mapping between engines
+    std::shared_ptr<const NnueNetwork> getNetwork() const { return network; }
+    void setUseNetwork(bool enabled);
+    bool isUsingNetwork() const { return useNetwork && nnue.isReady(); }
+
+    // Optional endgame tablebases; returns the number of tables found
+    int loadTablebases(const std::string& directory);
+    void setTablebases(std::shared_ptr<const Tablebases> tables);
+    std::shared_ptr<const Tablebases> getTablebases() const { return tablebases; }
+
+    // Optional opening book, consulted for the first bookDepth plies of the game
+    bool loadOpeningBook(const std::string& path);
+    void setOpeningBook(std::shared_ptr<const OpeningBook> openingBook);
+    std::shared_ptr<const OpeningBook> getOpeningBook() const { return book; }
+    void setBookDepth(int plies) { bookDepth = plies; }
+    int getBookDepth() const { return bookDepth; }
+
+    // Hand-written evaluation (positive = good for white), with the terms
+    // it used counted into trace
+    int traceEvaluation(const Position& position, EvalTrace& trace);
+
+    // Static evaluation (positive = good for white) through the evaluation
+    // cache, with the network if one is in use; for searches built on top
+    int staticEvaluation(const Position& position) { return evaluate(position); }
+
+    // Statistics of the last getBestMove() call
+    const SearchStats& getSearchStats() const { return stats; }
+
+    // Expected line of the last getBestMove() or search(), starting with
+    // the move it returned; empty for book moves
+    const std::vector<PackedMove>& getPrincipalVariation() const { return principalVariation; }
+
+    // Ranked lines of the last getBestMove() or search(), best first; empty
+    // for book and tablebase moves
+    const std::vector<PvLine>& getLines() const { return rankedLines; }
+
+    // Convert an engine move into the GUI's row/column form
+    static Move toMove(const Position& position, PackedMove move);
+
 private:
     Difficulty currentDifficulty;
     std::mt19937 randomGenerator;
+    PawnTable pawnHash; // Pawn structure cache, owned by this search instance
+    EvalCache evalCache;
+    bool evalCacheEnabled;
+    SearchStats stats;
+    std::shared_ptr<const NnueNetwork> network;
+    NnueEvaluator nnue;
+    bool useNetwork;
+    std::shared_ptr<const Tablebases> tablebases;
+    std::shared_ptr<const OpeningBook> book;
+    int bookDepth;
+    TranspositionTable tt;
+    std::function<void(const SearchResult&)> onIteration;
+    std::function<void(int, int, const PvLine&)> onLine;
+    int multiPv;
+    uint64_t nodeBudget;
+    int skill;
+    bool deterministic;
+    std::vector<PackedMove> principalVariation;
+    std::vector<PvLine> rankedLines;
     
-    // Minimax algorithm with alpha-beta pruning
-    int minimax(std::vector<std::vector<std::string>> board, int depth, int alpha, int beta, 
-                bool maximizing, char aiColor, Move& bestMove);
-    
-    // Board evaluation function
-    int evaluateBoard(const std::vector<std::vector<std::string>>& board, char aiColor);
-    
-    // Get all possible moves for a color
-    std::vector<Move> getAllPossibleMoves(const std::vector<std::vector<std::string>>& board, char color);
-    
-    // Check if a move is valid (uses existing chess logic)
-    bool isValidMove(const std::vector<std::vector<std::string>>& board, int fromRow, int fromCol, int toRow, int toCol);
+    // Triangular PV table: row ply holds the best line found from ply on,
+    // in pvTable[ply][ply] up to pvLength[ply]
+    PackedMove pvTable[MAX_PLY][MAX_PLY];
+    int pvLength[MAX_PLY];
     
-    // Make a move on the board (temporary for AI calculations)
-    void makeMove(std::vector<std::vector<std::string>>& board, const Move& move);
+    // Move left out at each ply by a singular extension's exclusion search
+    PackedMove excludedMoves[MAX_PLY];
+    // Depth of the running iteration; extensions stop at twice its plies
+    int rootDepth;
     
-    // Undo a move on the board
-    void undoMove(std::vector<std::vector<std::string>>& board, const Move& move);
-    
-    // Get piece value for evaluation
-    int getPieceValue(const std::string& piece);
-    
-    // Get piece color
-    char getPieceColor(const std::string& piece);
-    
-    // Position evaluation tables for better play
-    int getPositionValue(const std::string& piece, int row, int col);
+    // Budget of the running search(); getBestMove() runs without one
+    SearchLimits limits;
+    std::chrono::steady_clock::time_point searchStart;
+    bool canStop;
+    bool stopped;
+
+    // Principal variation search; scores are from the side to move's point
+    // of view. Only the first move of a node gets the full window, the rest
+    // are proven worse with a zero window and re-searched if they aren't.
+    // Checks and singular table moves are searched a ply deeper; nodes
+    // without a table move are reduced a ply, or on the principal
+    // variation first searched shallower for one.
+    int negamax(Position& pos, int depth, int ply, int alpha, int beta);
+
+    // Root moves [begin, end) in one iteration of search(), within a window
+    int searchRoot(Position& pos, PackedMove* begin, PackedMove* end, int depth, int alpha, int beta);
+
+    // Index of the line getBestMove() plays, sampled by skill
+    size_t pickLine(const std::vector<PvLine>& lines, bool white);
+
+    // Put move in front of the line below ply
+    void updatePv(int ply, PackedMove move);
+
+    // Line of the table's root row, as a vector
+    std::vector<PackedMove> rootPv() const;
+
+    // Whether the search budget is used up
+    bool outOfBudget() const;
     
+    // Counters of the caches for stats, at the end of a search
+    void finishStats(std::chrono::steady_clock::time_point startTime);
+
+    // Tablebase score of pos for the side to move, if it is covered
+    bool probeTablebases(const Position& pos, int ply, int& score);
+
+    // Exact king and pawn against king result from the built-in bitbase
+    // (positive = good for white)
+    bool probeKpk(const Position& pos, int& score);
+
+    // Static evaluation through the evaluation cache
+    int evaluate(const Position& pos);
+
+    // Phase-tapered board evaluation (positive = good for white); the
+    // weights come from evalparams.inc
+    int evaluateBoard(const Position& pos, EvalTrace* trace = nullptr);
+
+    // Get all legal moves for the side to move
+    void getAllPossibleMoves(const Position& pos, MoveList& moves);
+
+    // Piece value for move ordering
+    int getPieceValue(PieceType type);
+
+    // Position evaluation tables for better play (from the piece owner's point of view)
+    int getPositionValue(Piece piece, Square square, bool endgame);
+
     // Check if position is under attack
-    bool isUnderAttack(const std::vector<std::vector<std::string>>& board, int row, int col, char attackingColor);
-    
+    bool isUnderAttack(const Position& pos, Square square, Color attackingColor);
+
     // Order moves for better alpha-beta pruning
-    void orderMoves(std::vector<Move>& moves, const std::vector<std::vector<std::string>>& board);
+    void orderMoves(MoveList& moves, const Position& pos);
 };
 
-// External chess logic functions (from existing code)
-extern bool CheckIfValidMove(int CurrentPosX, int CurrentPosY, int ExpectedPosX, int ExpectedPosY,
-                            std::vector<std::vector<std::string>> Board, char Race, char name);
-extern char Race(std::string str);
-
 #endif // CHESSAI_H
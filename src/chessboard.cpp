@@ -2,10 +2,12 @@
 #include <QPaintEvent>
 #include <QDebug>
 #include <cctype>
-#include <cmath>
+#include <cstdlib>
+#include <sstream>
+#include "san.h"
 
 ChessBoard::ChessBoard(QWidget *parent)
-    : QWidget(parent), selectedRow(-1), selectedCol(-1), pieceSelected(false), currentPlayer('w'),
+    : QWidget(parent), selectedRow(-1), selectedCol(-1), pieceSelected(false), currentPlayer('w'), gameOver(false),
       aiEnabled(false), aiColor('b'), chessAI(nullptr), aiTimer(nullptr)
 {
     setFixedSize(BOARD_SIZE * SQUARE_SIZE, BOARD_SIZE * SQUARE_SIZE);
@@ -47,22 +49,30 @@ void ChessBoard::loadPieceImages()
 
 void ChessBoard::initializeBoard()
 {
-    board = {
-        {"r", "n", "b", "q", "k", "b", "n", "r"}, // 0 black back rank
-        {"p", "p", "p", "p", "p", "p", "p", "p"}, // 1 black pawns
-        {"", "", "", "", "", "", "", ""},         // 2
-        {"", "", "", "", "", "", "", ""},         // 3
-        {"", "", "", "", "", "", "", ""},         // 4
-        {"", "", "", "", "", "", "", ""},         // 5
-        {"P", "P", "P", "P", "P", "P", "P", "P"}, // 6 white pawns
-        {"R", "N", "B", "Q", "K", "B", "N", "R"}  // 7 white back rank
-    };
+    position.setStartPosition();
+    startPosition = position;
+    gameMoves.clear();
+    syncBoard();
+}
+
+void ChessBoard::syncBoard()
+{
+    board.assign(BOARD_SIZE, std::vector<std::string>(BOARD_SIZE));
+    for (int row = 0; row < BOARD_SIZE; ++row) {
+        for (int col = 0; col < BOARD_SIZE; ++col) {
+            Piece piece = position.pieceOn(squareFromRowCol(row, col));
+            if (piece != NO_PIECE) {
+                board[row][col] = std::string(1, pieceToChar(piece));
+            }
+        }
+    }
 }
 
 void ChessBoard::resetBoard()
 {
     initializeBoard();
     currentPlayer = 'w';
+    gameOver = false;
     pieceSelected = false;
     selectedRow = selectedCol = -1;
     update();
@@ -72,6 +82,87 @@ void ChessBoard::resetBoard()
     checkForAITurn();
 }
 
+bool ChessBoard::loadFen(const QString& fen)
+{
+    if (!position.setFen(fen.trimmed().toStdString())) {
+        return false;
+    }
+    startPosition = position;
+    gameMoves.clear();
+    syncBoard();
+    gameOver = false;
+    pieceSelected = false;
+    selectedRow = selectedCol = -1;
+    update();
+    
+    // Reports mate or stalemate right away and hands over to the AI if it is to move
+    switchPlayer();
+    return true;
+}
+
+QString ChessBoard::fen() const
+{
+    char buffer[FEN_MAX_LENGTH];
+    int length = position.writeFen(buffer);
+    return QString::fromLatin1(buffer, length);
+}
+
+QString ChessBoard::resultTag() const
+{
+    switch (gameOver ? gameStatus(position) : GAME_ONGOING) {
+        case GAME_ONGOING:   return "*";
+        case GAME_CHECKMATE: return position.sideToMove() == WHITE ? "0-1" : "1-0";
+        default:             return "1/2-1/2";
+    }
+}
+
+QString ChessBoard::gamePgn(const std::vector<std::pair<std::string, std::string>>& tags) const
+{
+    std::ostringstream out;
+    writePgnGame(out, tags, startPosition, gameMoves, resultTag().toStdString());
+    return QString::fromStdString(out.str());
+}
+
+int ChessBoard::loadGame(const PgnGame& game)
+{
+    Position start;
+    std::string fen = game.tag("FEN");
+    if (!fen.empty() && !start.setFen(fen)) {
+        return -1;
+    }
+    
+    position = start;
+    startPosition = start;
+    gameMoves.clear();
+    for (std::string_view san : game.moves) {
+        PackedMove move = parseSan(position, san);
+        if (move == NO_MOVE) break; // Keep the legal part of a broken game
+        position.makeMove(move);
+        gameMoves.push_back(move);
+    }
+    
+    syncBoard();
+    gameOver = false;
+    pieceSelected = false;
+    selectedRow = selectedCol = -1;
+    update();
+    switchPlayer();
+    return int(gameMoves.size());
+}
+
+QStringList ChessBoard::moveListSan() const
+{
+    QStringList list;
+    Position replay = startPosition;
+    char san[SAN_MAX_LENGTH];
+    for (PackedMove move : gameMoves) {
+        int length = writeSan(replay, move, san);
+        list << QString::fromLatin1(san, length);
+        replay.makeMove(move);
+    }
+    return list;
+}
+
 void ChessBoard::paintEvent(QPaintEvent */*event*/)
 {
     QPainter painter(this);
@@ -129,8 +220,8 @@ void ChessBoard::mousePressEvent(QMouseEvent *event)
 {
     if (event->button() != Qt::LeftButton) return;
     
-    // Prevent human input if it's AI's turn
-    if (aiEnabled && currentPlayer == aiColor) {
+    // Prevent human input once the game is over or if it's AI's turn
+    if (gameOver || (aiEnabled && currentPlayer == aiColor)) {
         return;
     }
     
@@ -158,7 +249,7 @@ void ChessBoard::mousePressEvent(QMouseEvent *event)
             pieceSelected = false;
             selectedRow = selectedCol = -1;
         } else if (isValidMove(selectedRow, selectedCol, row, col)) {
-            QString moveNotation = getMoveNotation(selectedRow, selectedCol, row, col);
+            QString moveNotation = getMoveNotation(findLegalMove(selectedRow, selectedCol, row, col));
             makeMove(selectedRow, selectedCol, row, col);
             emit moveMade(moveNotation);
             emit moveMadeWithCoords(moveNotation, selectedRow, selectedCol, row, col);
@@ -187,19 +278,42 @@ void ChessBoard::mousePressEvent(QMouseEvent *event)
 
 bool ChessBoard::isValidMove(int fromRow, int fromCol, int toRow, int toCol)
 {
-    if (board[fromRow][fromCol].empty()) return false;
+    return findLegalMove(fromRow, fromCol, toRow, toCol) != NO_MOVE;
+}
+
+PackedMove ChessBoard::findLegalMove(int fromRow, int fromCol, int toRow, int toCol, char promotion)
+{
+    if (fromRow < 0 || fromRow >= BOARD_SIZE || fromCol < 0 || fromCol >= BOARD_SIZE ||
+        toRow < 0 || toRow >= BOARD_SIZE || toCol < 0 || toCol >= BOARD_SIZE) {
+        return NO_MOVE;
+    }
     
-    std::string piece = board[fromRow][fromCol];
-    char race = getPieceRace(piece);
-    char name = std::tolower(piece[0]);
+    Square from = squareFromRowCol(fromRow, fromCol);
+    Square to = squareFromRowCol(toRow, toCol);
     
-    return CheckIfValidMove(fromRow, fromCol, toRow, toCol, board, race, name);
+    MoveList moves;
+    generateLegalMoves(position, moves);
+    for (PackedMove move : moves) {
+        if (moveFrom(move) != from || moveTo(move) != to) continue;
+        if (isPromotionMove(move) && "nbrq"[promotionType(move) - KNIGHT] != promotion) continue;
+        return move;
+    }
+    return NO_MOVE;
 }
 
 void ChessBoard::makeMove(int fromRow, int fromCol, int toRow, int toCol)
 {
-    board[toRow][toCol] = board[fromRow][fromCol];
-    board[fromRow][fromCol] = "";
+    PackedMove move = findLegalMove(fromRow, fromCol, toRow, toCol);
+    if (move == NO_MOVE) return;
+    
+    playMove(move);
+}
+
+void ChessBoard::playMove(PackedMove move)
+{
+    position.makeMove(move);
+    gameMoves.push_back(move);
+    syncBoard();
     update();
 }
 
@@ -211,203 +325,73 @@ char ChessBoard::getPieceRace(const std::string &piece)
 
 void ChessBoard::switchPlayer()
 {
-    currentPlayer = (currentPlayer == 'w') ? 'b' : 'w';
+    currentPlayer = (position.sideToMove() == WHITE) ? 'w' : 'b';
+    
+    GameStatus status = gameStatus(position);
+    if (status != GAME_ONGOING) {
+        gameOver = true;
+        QString result = getResultText(status);
+        emit gameStatusChanged(result);
+        emit gameEnded(result);
+        return;
+    }
+    
     QString playerName = (currentPlayer == 'w') ? "White" : "Black";
-    emit gameStatusChanged(playerName + " to move");
+    emit gameStatusChanged(playerName + (position.inCheck() ? " to move - Check!" : " to move"));
     
     // Check for AI turn
     checkForAITurn();
 }
 
-QString ChessBoard::getMoveNotation(int fromRow, int fromCol, int toRow, int toCol)
+QString ChessBoard::getMoveNotation(PackedMove move)
 {
-    QString from = QString("%1%2").arg(char('a' + fromCol)).arg(8 - fromRow);
-    QString to = QString("%1%2").arg(char('a' + toCol)).arg(8 - toRow);
-    QString piece = QString::fromStdString(board[fromRow][fromCol]);
-    
-    return QString("%1: %2-%3").arg(piece, from, to);
+    char san[SAN_MAX_LENGTH];
+    int length = writeSan(position, move, san);
+    return QString::fromLatin1(san, length);
 }
 
-// Chess logic functions (from original main.cpp)
-char Race(std::string str) {
-    if (str.empty()) return 'n'; // no piece
-    for (char c : str) {
-        if (!isupper(static_cast<unsigned char>(c))) {
-            return 'b';  // Found a lowercase character (black piece)
+QString ChessBoard::getLineNotation(const std::vector<PackedMove>& line) const
+{
+    Position pos = position;
+    QStringList moves;
+    for (PackedMove move : line) {
+        QString number;
+        if (pos.sideToMove() == WHITE) {
+            number = QString("%1.").arg(pos.fullmoveNumber());
+        } else if (moves.isEmpty()) {
+            number = QString("%1...").arg(pos.fullmoveNumber());
         }
+        char san[SAN_MAX_LENGTH];
+        int length = writeSan(pos, move, san);
+        moves << number + QString::fromLatin1(san, length);
+        pos.makeMove(move);
     }
-    return 'w'; // All uppercase (white piece)
+    return moves.join(' ');
 }
 
-bool CheckIfValidMove(int CurrentPosX, int CurrentPosY, int ExpectedPosX,
-                      int ExpectedPosY,
-                      std::vector<std::vector<std::string>> Board, char Race,
-                      char name) {
-    // Bounds checking
-    if (CurrentPosX < 0 || CurrentPosX > 7 || CurrentPosY < 0 || CurrentPosY > 7 ||
-        ExpectedPosX < 0 || ExpectedPosX > 7 || ExpectedPosY < 0 || ExpectedPosY > 7) {
-        return false; // Out of bounds
-    }
-    
-    // Can't move to same position
-    if (CurrentPosX == ExpectedPosX && CurrentPosY == ExpectedPosY) {
-        return false;
-    }
-    
-    // Can't capture own pieces
-    if (!Board[ExpectedPosX][ExpectedPosY].empty()) {
-        char targetRace = ::Race(Board[ExpectedPosX][ExpectedPosY]);
-        if (targetRace == Race) {
-            return false;
-        }
+// Engine score for white as pawns, or moves to mate
+static QString scoreText(int score)
+{
+    if (std::abs(score) > ChessAI::MATE_BOUND) {
+        int moves = (ChessAI::MATE_SCORE - std::abs(score) + 1) / 2;
+        return QString(score > 0 ? "#%1" : "#-%1").arg(moves);
     }
-    
-    char opposite = (Race == 'b') ? 'w' : 'b';
-
-    if (name == 'p' || name == 'P') {
-        if (Race == 'w') {
-            // single forward
-            if (ExpectedPosX == CurrentPosX - 1 && ExpectedPosY == CurrentPosY &&
-                Board[ExpectedPosX][ExpectedPosY].empty())
-                return true;
-
-            // double forward from start
-            if (CurrentPosX == 6 && ExpectedPosX == CurrentPosX - 2 &&
-                ExpectedPosY == CurrentPosY &&
-                Board[CurrentPosX - 1][CurrentPosY].empty() &&
-                Board[ExpectedPosX][ExpectedPosY].empty())
-                return true;
-
-            // capture
-            if (ExpectedPosX == CurrentPosX - 1 &&
-                (ExpectedPosY == CurrentPosY - 1 ||
-                 ExpectedPosY == CurrentPosY + 1) &&
-                !Board[ExpectedPosX][ExpectedPosY].empty() &&
-                ::Race(Board[ExpectedPosX][ExpectedPosY]) == opposite)
-                return true;
-        }
-        if (Race == 'b') {
-            if (ExpectedPosX == CurrentPosX + 1 && ExpectedPosY == CurrentPosY &&
-                Board[ExpectedPosX][ExpectedPosY].empty())
-                return true;
-
-            // double forward from start
-            if (CurrentPosX == 1 && ExpectedPosX == CurrentPosX + 2 &&
-                ExpectedPosY == CurrentPosY &&
-                Board[CurrentPosX + 1][CurrentPosY].empty() &&
-                Board[ExpectedPosX][ExpectedPosY].empty())
-                return true;
-
-            // capture
-            if (ExpectedPosX == CurrentPosX + 1 &&
-                (ExpectedPosY == CurrentPosY - 1 ||
-                 ExpectedPosY == CurrentPosY + 1) &&
-                !Board[ExpectedPosX][ExpectedPosY].empty() &&
-                ::Race(Board[ExpectedPosX][ExpectedPosY]) == opposite)
-                return true;
-        }
-    } else if (name == 'r' || name == 'R') {
-        if (CurrentPosX == ExpectedPosX) {
-            // doing for the Y value
-            int y = (ExpectedPosY > CurrentPosY) ? 1 : -1;
-
-            for (int i = CurrentPosY + y; i != ExpectedPosY; i += y) {
-                if (!Board[CurrentPosX][i].empty()) {
-                    return false;
-                }
-            }
-            return Board[ExpectedPosX][ExpectedPosY].empty() ||
-                   ::Race(Board[ExpectedPosX][ExpectedPosY]) == opposite;
-
-        } else if (CurrentPosY == ExpectedPosY) {
-
-            int x = (ExpectedPosX > CurrentPosX) ? 1 : -1;
-
-            for (int i = CurrentPosX + x; i != ExpectedPosX; i += x) {
-                if (!Board[i][CurrentPosY].empty()) {
-                    return false;
-                }
-            }
-
-            return Board[ExpectedPosX][ExpectedPosY].empty() ||
-                   ::Race(Board[ExpectedPosX][ExpectedPosY]) == opposite;
-        }
-    } else if (name == 'n' || name == 'N') {
-        int dx = std::abs(ExpectedPosX - CurrentPosX);
-        int dy = std::abs(ExpectedPosY - CurrentPosY);
-        if ((dx == 2 && dy == 1) || (dx == 1 && dy == 2)) {
-            return Board[ExpectedPosX][ExpectedPosY].empty() ||
-                   ::Race(Board[ExpectedPosX][ExpectedPosY]) == opposite;
-        }
-    } else if (name == 'b' || name == 'B') {
-        // Bishop
-        if (abs(ExpectedPosX - CurrentPosX) != abs(ExpectedPosY - CurrentPosY))
-            return false;
-
-        int dx = (ExpectedPosX > CurrentPosX) ? 1 : -1;
-        int dy = (ExpectedPosY > CurrentPosY) ? 1 : -1;
-
-        int x = CurrentPosX + dx;
-        int y = CurrentPosY + dy;
-
-        while (x != ExpectedPosX && y != ExpectedPosY) {
-            if (!Board[x][y].empty())
-                return false;
-            x += dx;
-            y += dy;
-        }
-
-        return Board[ExpectedPosX][ExpectedPosY].empty() ||
-               ::Race(Board[ExpectedPosX][ExpectedPosY]) == opposite;
-    } else if (name == 'k' || name == 'K') {
-        // King - can move one square in any direction
-        int dx = std::abs(ExpectedPosX - CurrentPosX);
-        int dy = std::abs(ExpectedPosY - CurrentPosY);
-        if ((dx == 0 && dy == 1) || (dx == 1 && dy == 0) || (dx == 1 && dy == 1)) {
-            return Board[ExpectedPosX][ExpectedPosY].empty() ||
-                   ::Race(Board[ExpectedPosX][ExpectedPosY]) == opposite;
-        }
-    } else if (name == 'q' || name == 'Q') {
-        int dx = ExpectedPosX - CurrentPosX;
-        int dy = ExpectedPosY - CurrentPosY;
-
-        if (dx == 0 || dy == 0) {
-            // Rook-like move
-            int stepX = (dx == 0) ? 0 : (dx > 0 ? 1 : -1);
-            int stepY = (dy == 0) ? 0 : (dy > 0 ? 1 : -1);
-
-            int x = CurrentPosX + stepX;
-            int y = CurrentPosY + stepY;
-
-            while (x != ExpectedPosX || y != ExpectedPosY) {
-                if (!Board[x][y].empty())
-                    return false;
-                x += stepX;
-                y += stepY;
-            }
-        } else if (abs(dx) == abs(dy)) {
-            // Bishop-like move
-            int stepX = (dx > 0) ? 1 : -1;
-            int stepY = (dy > 0) ? 1 : -1;
-
-            int x = CurrentPosX + stepX;
-            int y = CurrentPosY + stepY;
-
-            while (x != ExpectedPosX && y != ExpectedPosY) {
-                if (!Board[x][y].empty())
-                    return false;
-                x += stepX;
-                y += stepY;
-            }
-        } else {
-            return false; // invalid queen move
-        }
+    return QString("%1%2").arg(score >= 0 ? "+" : "").arg(score / 100.0, 0, 'f', 2);
+}
 
-        return Board[ExpectedPosX][ExpectedPosY].empty() ||
-               ::Race(Board[ExpectedPosX][ExpectedPosY]) == opposite;
+QString ChessBoard::getResultText(GameStatus status) const
+{
+    // After checkmate the side to move is the loser
+    QString winner = (position.sideToMove() == WHITE) ? "Black" : "White";
+    
+    switch (status) {
+        case GAME_CHECKMATE:             return QString("Checkmate - %1 wins").arg(winner);
+        case GAME_STALEMATE:             return "Draw by stalemate";
+        case GAME_THREEFOLD_REPETITION:  return "Draw by threefold repetition";
+        case GAME_FIFTY_MOVE_RULE:       return "Draw by the fifty-move rule";
+        case GAME_INSUFFICIENT_MATERIAL: return "Draw by insufficient material";
+        default:                         return QString();
     }
-
-    return false;
 }
 
 // AI Implementation
@@ -428,17 +412,70 @@ void ChessBoard::setAIDifficulty(ChessAI::Difficulty difficulty) {
     }
 }
 
+bool ChessBoard::loadAINetwork(const QString& path) {
+    return chessAI && chessAI->loadNetwork(path.toStdString());
+}
+
+int ChessBoard::loadAITablebases(const QString& directory) {
+    return chessAI ? chessAI->loadTablebases(directory.toStdString()) : 0;
+}
+
+bool ChessBoard::loadAIOpeningBook(const QString& path) {
+    return chessAI && chessAI->loadOpeningBook(path.toStdString());
+}
+
+void ChessBoard::setAIAnalysisLines(int lines) {
+    if (chessAI) {
+        chessAI->setMultiPv(lines);
+    }
+}
+
+void ChessBoard::setAIBookDepth(int plies) {
+    if (chessAI) {
+        chessAI->setBookDepth(plies);
+    }
+}
+
 void ChessBoard::makeAIMove() {
-    if (!chessAI || !aiEnabled || currentPlayer != aiColor) {
+    if (!chessAI || !aiEnabled || gameOver || currentPlayer != aiColor) {
         return;
     }
     
-    Move aiMove = chessAI->getBestMove(board, aiColor);
+    Move aiMove = chessAI->getBestMove(position);
+    
+    const SearchStats& stats = chessAI->getSearchStats();
+    if (stats.bookMove) {
+        qDebug() << "AI move from the opening book";
+    } else {
+        qDebug() << "AI search:" << stats.nodes << "nodes in" << stats.seconds << "s,"
+                 << "eval cache hit rate" << stats.evalCacheHitRate()
+                 << ", pawn table hit rate" << stats.pawnTableHitRate()
+                 << ", tablebase hits" << stats.tablebaseHits;
+        
+        const std::vector<PackedMove>& line = chessAI->getPrincipalVariation();
+        const std::vector<PvLine>& lines = chessAI->getLines();
+        if (!lines.empty() && chessAI->getMultiPv() > 1) {
+            // The search ranked these lines already; below full skill the
+            // move played may be one of the lower ones
+            QStringList text;
+            text << QString("Depth %1").arg(stats.depth);
+            size_t count = std::min(lines.size(), size_t(chessAI->getMultiPv()));
+            for (size_t i = 0; i < count; ++i) {
+                text << QString("%1) %2: %3").arg(i + 1).arg(scoreText(lines[i].score))
+                        .arg(getLineNotation(lines[i].pv));
+            }
+            emit aiPrincipalVariation(text.join('\n'));
+        } else if (!line.empty()) {
+            // Tablebase moves come without a search
+            QString source = stats.depth ? QString("Depth %1").arg(stats.depth) : QString("Tablebase");
+            emit aiPrincipalVariation(QString("%1, %2: %3").arg(source)
+                                      .arg(scoreText(aiMove.score)).arg(getLineNotation(line)));
+        }
+    }
     
-    if (aiMove.fromRow != -1) { // Valid move found
-        QString moveNotation = getMoveNotation(aiMove.fromRow, aiMove.fromCol, 
-                                             aiMove.toRow, aiMove.toCol);
-        makeMove(aiMove.fromRow, aiMove.fromCol, aiMove.toRow, aiMove.toCol);
+    if (aiMove.packed != NO_MOVE) { // Valid move found
+        QString moveNotation = getMoveNotation(aiMove.packed);
+        playMove(aiMove.packed);
         emit moveMade(moveNotation);
         switchPlayer();
         
@@ -447,7 +484,7 @@ void ChessBoard::makeAIMove() {
 }
 
 void ChessBoard::checkForAITurn() {
-    if (aiEnabled && currentPlayer == aiColor) {
+    if (aiEnabled && !gameOver && currentPlayer == aiColor) {
         QString aiColorName = (aiColor == 'w') ? "White AI" : "Black AI";
         emit gameStatusChanged(aiColorName + " is thinking...");
         
@@ -463,15 +500,35 @@ void ChessBoard::onAITimerTimeout() {
 // External move handling for Bluetooth multiplayer
 bool ChessBoard::makeExternalMove(int fromRow, int fromCol, int toRow, int toCol) {
     // Validate move
-    if (!isValidMove(fromRow, fromCol, toRow, toCol)) {
+    if (gameOver || !isValidMove(fromRow, fromCol, toRow, toCol)) {
         return false;
     }
     
     // Make the move
-    QString moveNotation = getMoveNotation(fromRow, fromCol, toRow, toCol);
+    QString moveNotation = getMoveNotation(findLegalMove(fromRow, fromCol, toRow, toCol));
     makeMove(fromRow, fromCol, toRow, toCol);
     emit moveMade(moveNotation);
     switchPlayer();
     
     return true;
 }
+
+// Moves played from outside the board, such as the opening explorer
+bool ChessBoard::makeUserMove(PackedMove move)
+{
+    MoveList moves;
+    generateLegalMoves(position, moves);
+    if (gameOver || (aiEnabled && currentPlayer == aiColor) || !moves.contains(move)) {
+        return false;
+    }
+    
+    Square from = moveFrom(move), to = moveTo(move);
+    QString moveNotation = getMoveNotation(move);
+    playMove(move);
+    emit moveMade(moveNotation);
+    emit moveMadeWithCoords(moveNotation, rowOf(from), colOf(from), rowOf(to), colOf(to));
+    pieceSelected = false;
+    selectedRow = selectedCol = -1;
+    switchPlayer();
+    return true;
+}
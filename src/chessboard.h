@@ -10,6 +10,8 @@
 #include <string>
 #include <map>
 #include "chessai.h"
+#include "position.h"
+#include "pgn.h"
 
 class ChessBoard : public QWidget
 {
@@ -20,15 +22,45 @@ public:
     ~ChessBoard();
     void resetBoard();
     
+    // Position import/export in FEN; loadFen() leaves the board alone on bad input
+    bool loadFen(const QString& fen);
+    QString fen() const;
+    int getPlyCount() const { return position.plyCount(); }
+    const Position& getPosition() const { return position; }
+    
+    // The game so far as PGN, with the given tags and the current result
+    QString gamePgn(const std::vector<std::pair<std::string, std::string>>& tags) const;
+    // Replace the game with a PGN game; returns how many of its moves were
+    // legal and played, or -1 if its starting position is invalid
+    int loadGame(const PgnGame& game);
+    // Moves of the game in SAN, from its starting position
+    QStringList moveListSan() const;
+    // A line of moves from the current position, in numbered SAN
+    QString getLineNotation(const std::vector<PackedMove>& line) const;
+    int getStartPlyCount() const { return startPosition.plyCount(); }
+    
     // AI-related methods
     void setAIEnabled(bool enabled);
     void setAIColor(char color); // 'w' for white AI, 'b' for black AI
     void setAIDifficulty(ChessAI::Difficulty difficulty);
+    bool loadAINetwork(const QString& path);
+    int loadAITablebases(const QString& directory);
+    bool loadAIOpeningBook(const QString& path);
+    void setAIBookDepth(int plies);
+    // Best moves shown with their lines after each AI move (default 1)
+    void setAIAnalysisLines(int lines);
     bool isAIEnabled() const { return aiEnabled; }
     char getAIColor() const { return aiColor; }
     
+    // Game termination
+    GameStatus getGameStatus() const { return gameStatus(position); }
+    bool isGameOver() const { return gameOver; }
+    
     // External move handling (for Bluetooth multiplayer)
     bool makeExternalMove(int fromRow, int fromCol, int toRow, int toCol);
+    // Play a legal move for the side to move as if it was made on the board
+    // (sent to a Bluetooth opponent too); refused on the AI's turn
+    bool makeUserMove(PackedMove move);
     
 protected:
     void paintEvent(QPaintEvent *event) override;
@@ -38,13 +70,17 @@ private:
     static const int BOARD_SIZE = 8;
     static const int SQUARE_SIZE = 80;
     
-    std::vector<std::vector<std::string>> board;
+    Position position; // Authoritative game state (castling, en passant, ...)
+    Position startPosition; // Where the game started, for PGN export
+    std::vector<PackedMove> gameMoves; // Moves played since startPosition
+    std::vector<std::vector<std::string>> board; // Mirror of position used for drawing
     std::map<std::string, QPixmap> pieceImages;
     
     int selectedRow;
     int selectedCol;
     bool pieceSelected;
     char currentPlayer; // 'w' for white, 'b' for black
+    bool gameOver;
     
     // AI-related members
     bool aiEnabled;
@@ -54,14 +90,19 @@ private:
     
     void loadPieceImages();
     void initializeBoard();
+    void syncBoard();
     void drawBoard(QPainter &painter);
     void drawPieces(QPainter &painter);
     void drawSelection(QPainter &painter);
     void makeMove(int fromRow, int fromCol, int toRow, int toCol);
+    void playMove(PackedMove move);
     bool isValidMove(int fromRow, int fromCol, int toRow, int toCol);
+    PackedMove findLegalMove(int fromRow, int fromCol, int toRow, int toCol, char promotion = 'q');
     char getPieceRace(const std::string &piece);
     void switchPlayer();
-    QString getMoveNotation(int fromRow, int fromCol, int toRow, int toCol);
+    QString getMoveNotation(PackedMove move);
+    QString resultTag() const;
+    QString getResultText(GameStatus status) const;
     
     // AI-related private methods
     void makeAIMove();
@@ -74,13 +115,10 @@ signals:
     void moveMade(QString moveNotation);
     void moveMadeWithCoords(QString moveNotation, int fromRow, int fromCol, int toRow, int toCol);
     void gameStatusChanged(QString status);
+    void gameEnded(QString result);
+    // The line the AI expects after its move: depth, score for white and
+    // moves; one line per ranked move when more analysis lines are set
+    void aiPrincipalVariation(QString line);
 };
 
-// Chess logic functions (from original code)
-char Race(std::string str);
-bool CheckIfValidMove(int CurrentPosX, int CurrentPosY, int ExpectedPosX,
-                      int ExpectedPosY,
-                      std::vector<std::vector<std::string>> Board, char Race,
-                      char name);
-
 #endif // CHESSBOARD_H
@@ -0,0 +1,238 @@
+#include "epdsuite.h"
+#include "san.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+bool EpdEntry::isSolution(PackedMove move) const
+{
+    if (!points.empty() && bestMoves.empty() && avoidMoves.empty())
+        return pointsFor(move) == maxPoints();
+    if (!bestMoves.empty() && std::find(bestMoves.begin(), bestMoves.end(), move) == bestMoves.end())
+        return false;
+    return std::find(avoidMoves.begin(), avoidMoves.end(), move) == avoidMoves.end();
+}
+
+int EpdEntry::pointsFor(PackedMove move) const
+{
+    for (const auto& p : points) {
+        if (p.first == move)
+            return p.second;
+    }
+    return 0;
+}
+
+int EpdEntry::maxPoints() const
+{
+    int best = 0;
+    for (const auto& p : points)
+        best = std::max(best, p.second);
+    return best;
+}
+
+bool parseEpd(const std::string& line, EpdEntry& entry)
+{
+    entry = EpdEntry();
+    std::istringstream fields(line);
+    std::string field;
+    for (int i = 0; i < 4 && fields >> field; ++i)
+        entry.fen += (i ? " " : "") + field;
+    Position pos;
+    if (!pos.setFen(entry.fen))
+        return false;
+
+    // Operations: an opcode, operands separated by spaces, then ';'.
+    // Quoted operands may contain spaces and semicolons.
+    std::string rest;
+    std::getline(fields, rest);
+    size_t i = 0;
+    while (i < rest.size()) {
+        std::vector<std::string> words;
+        bool quoted = false;
+        std::string word;
+        for (; i < rest.size(); ++i) {
+            char c = rest[i];
+            if (c == '"') {
+                quoted = !quoted;
+            } else if (!quoted && c == ';') {
+                ++i;
+                break;
+            } else if (!quoted && (c == ' ' || c == '\t' || c == '\r')) {
+                if (!word.empty())
+                    words.push_back(word);
+                word.clear();
+            } else {
+                word += c;
+            }
+        }
+        if (!word.empty())
+            words.push_back(word);
+        if (words.empty())
+            continue;
+
+        const std::string& opcode = words[0];
+        if (opcode == "id" && words.size() > 1) {
+            entry.id = words[1];
+        } else if (opcode == "bm" || opcode == "am") {
+            for (size_t w = 1; w < words.size(); ++w) {
+                PackedMove move = parseSan(pos, words[w]);
+                if (move != NO_MOVE)
+                    (opcode == "bm" ? entry.bestMoves : entry.avoidMoves).push_back(move);
+            }
+        } else if (opcode == "c0" && words.size() > 1 && words[1].find('=') != std::string::npos) {
+            // "Nf3=10, e4=5"; the quotes kept it one operand
+            std::istringstream list(words[1]);
+            std::string item;
+            while (std::getline(list, item, ',')) {
+                item.erase(std::remove(item.begin(), item.end(), ' '), item.end());
+                size_t eq = item.find('=');
+                PackedMove move = eq == std::string::npos ? NO_MOVE : parseSan(pos, item.substr(0, eq));
+                if (move != NO_MOVE)
+                    entry.points.push_back({move, std::atoi(item.c_str() + eq + 1)});
+            }
+        }
+    }
+    return !entry.bestMoves.empty() || !entry.avoidMoves.empty() || !entry.points.empty();
+}
+
+EpdSuiteRunner::EpdSuiteRunner(int threads)
+    : threadCount(threads > 0 ? threads : std::max(1, int(std::thread::hardware_concurrency()))),
+      hashKilobytes(16384)
+{
+    limits.milliseconds = 1000;
+}
+
+int EpdSuiteRunner::load(const std::string& path)
+{
+    std::ifstream in(path);
+    if (!in) {
+        message(path + ": could not be opened");
+        return 0;
+    }
+    suite.clear();
+    std::string line;
+    int unusable = 0;
+    EpdEntry entry;
+    while (std::getline(in, line)) {
+        if (line.find_first_not_of(" \t\r") == std::string::npos)
+            continue;
+        if (parseEpd(line, entry))
+            suite.push_back(entry);
+        else
+            ++unusable;
+    }
+    char text[120];
+    std::snprintf(text, sizeof(text), ": %zu positions, %d without a usable position or test", suite.size(), unusable);
+    message(path + text);
+    return int(suite.size());
+}
+
+// SAN of the moves of a list, space separated
+static std::string sanList(const Position& pos, const std::vector<PackedMove>& moves)
+{
+    std::string text;
+    for (PackedMove move : moves) {
+        if (move == NO_MOVE)
+            continue;
+        Position copy = pos;
+        char san[SAN_MAX_LENGTH];
+        text += (text.empty() ? "" : " ") + std::string(san, size_t(writeSan(copy, move, san)));
+    }
+    return text;
+}
+
+std::vector<EpdOutcome> EpdSuiteRunner::run()
+{
+    std::vector<EpdOutcome> outcomes(suite.size());
+    std::vector<char> finished(suite.size(), 0);
+    std::mutex lock;
+    std::condition_variable wake;
+    std::atomic<size_t> next(0);
+
+    auto worker = [&]() {
+        ChessAI engine;
+        engine.setHashSize(hashKilobytes);
+        if (network)
+            engine.setNetwork(network);
+        if (tablebases)
+            engine.setTablebases(tablebases);
+        std::vector<SearchResult> iterations;
+        engine.setIterationCallback([&iterations](const SearchResult& r) { iterations.push_back(r); });
+
+        Position pos;
+        size_t n;
+        while ((n = next.fetch_add(1)) < suite.size()) {
+            const EpdEntry& entry = suite[n];
+            pos.setFen(entry.fen);
+            engine.clearHash();
+            iterations.clear();
+            SearchResult result = engine.search(pos, limits);
+
+            EpdOutcome outcome;
+            outcome.move = result.bestMove;
+            outcome.solved = entry.isSolution(result.bestMove);
+            outcome.points = entry.pointsFor(result.bestMove);
+            outcome.depth = result.depth;
+            outcome.nodes = engine.getSearchStats().nodes;
+            outcome.seconds = engine.getSearchStats().seconds;
+            outcome.solveNodes = 0;
+            outcome.solveSeconds = 0;
+            // Back from the last iteration to where the solution was first kept
+            for (size_t i = iterations.size(); i-- > 0 && entry.isSolution(iterations[i].bestMove);) {
+                outcome.solveNodes = iterations[i].nodes;
+                outcome.solveSeconds = iterations[i].seconds;
+            }
+
+            std::lock_guard<std::mutex> guard(lock);
+            outcomes[n] = outcome;
+            finished[n] = 1;
+            wake.notify_one();
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (int i = 0; i < threadCount; ++i)
+        workers.emplace_back(worker);
+
+    // Report in suite order as positions come in
+    int solved = 0;
+    for (size_t n = 0; n < suite.size(); ++n) {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            wake.wait(guard, [&] { return finished[n] != 0; });
+        }
+        const EpdEntry& entry = suite[n];
+        const EpdOutcome& outcome = outcomes[n];
+        Position pos;
+        pos.setFen(entry.fen);
+        solved += outcome.solved;
+
+        char text[256];
+        int length = std::snprintf(text, sizeof(text), "%4zu %-16s %-6s %-7s", n + 1,
+                                   entry.id.empty() ? "-" : entry.id.c_str(), outcome.solved ? "solved" : "failed",
+                                   sanList(pos, {outcome.move}).c_str());
+        if (outcome.solved) {
+            length += std::snprintf(text + length, sizeof(text) - size_t(length), "  %.2fs  %llu nodes",
+                                    outcome.solveSeconds, (unsigned long long)outcome.solveNodes);
+        } else {
+            std::string wanted = entry.bestMoves.empty() ? "" : "  bm " + sanList(pos, entry.bestMoves);
+            if (!entry.avoidMoves.empty())
+                wanted += "  am " + sanList(pos, entry.avoidMoves);
+            length += std::snprintf(text + length, sizeof(text) - size_t(length), "%s", wanted.c_str());
+        }
+        if (!entry.points.empty())
+            length += std::snprintf(text + length, sizeof(text) - size_t(length), "  %d/%d points",
+                                    outcome.points, entry.maxPoints());
+        std::snprintf(text + length, sizeof(text) - size_t(length), "  depth %d  [%d/%zu]",
+                      outcome.depth, solved, n + 1);
+        message(text);
+    }
+    for (std::thread& t : workers)
+        t.join();
+    return outcomes;
+}
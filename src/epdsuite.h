@@ -0,0 +1,77 @@
+#ifndef EPDSUITE_H
+#define EPDSUITE_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "chessai.h"
+
+// One test position: the FEN fields and the operations a suite checks
+struct EpdEntry {
+    std::string fen;
+    std::string id;
+    std::vector<PackedMove> bestMoves;               // bm: any of these solves it
+    std::vector<PackedMove> avoidMoves;              // am: anything but these solves it
+    std::vector<std::pair<PackedMove, int>> points;  // c0 "Nf3=10, e4=5" as in STS
+
+    bool isSolution(PackedMove move) const;
+    int pointsFor(PackedMove move) const;
+    int maxPoints() const;
+};
+
+// Parse an EPD line; moves are SAN. False if the position is unreadable or
+// the line sets no bm, am or points to test.
+bool parseEpd(const std::string& line, EpdEntry& entry);
+
+// How the engine did on one position
+struct EpdOutcome {
+    PackedMove move;     // Final best move
+    bool solved;
+    int points;
+    int depth;
+    uint64_t nodes;
+    double seconds;
+    uint64_t solveNodes; // When the engine settled on a solution for good
+    double solveSeconds;
+};
+
+// Runs the engine on every position of a test suite with a fixed budget,
+// one position per thread, each thread with its own ChessAI. A position is
+// solved when the final best move is a bm move (or no am move); its time
+// to solution is the end of the first iteration after which the best move
+// stayed a solution. Lines are logged in suite order as positions finish.
+class EpdSuiteRunner {
+public:
+    explicit EpdSuiteRunner(int threads = 0); // 0 = all cores
+
+    void setLogger(std::function<void(const std::string&)> logger) { log = logger; }
+    // Budget of each position (default one second)
+    void setLimits(const SearchLimits& searchLimits) { limits = searchLimits; }
+    void setHashSize(size_t kilobytes) { hashKilobytes = kilobytes; }
+    void setNetwork(std::shared_ptr<const NnueNetwork> nnue) { network = nnue; }
+    void setTablebases(std::shared_ptr<const Tablebases> tables) { tablebases = tables; }
+
+    // Read a suite; returns the number of usable positions
+    int load(const std::string& path);
+
+    // Run every position; outcomes are in suite order
+    std::vector<EpdOutcome> run();
+
+    const std::vector<EpdEntry>& entries() const { return suite; }
+
+private:
+    int threadCount;
+    SearchLimits limits;
+    size_t hashKilobytes;
+    std::shared_ptr<const NnueNetwork> network;
+    std::shared_ptr<const Tablebases> tablebases;
+    std::vector<EpdEntry> suite;
+    std::function<void(const std::string&)> log;
+
+    void message(const std::string& text) const { if (log) log(text); }
+};
+
+#endif // EPDSUITE_H
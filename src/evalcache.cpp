@@ -0,0 +1,27 @@
+#include "evalcache.h"
+
+EvalCache::EvalCache(size_t sizeInKilobytes)
+    : mask(0), probeCount(0), hitCount(0)
+{
+    resize(sizeInKilobytes);
+}
+
+void EvalCache::resize(size_t sizeInKilobytes)
+{
+    size_t wanted = sizeInKilobytes * 1024 / sizeof(Entry);
+    size_t size = 1;
+    while (size * 2 <= wanted) size *= 2;
+
+    table.assign(size, Entry());
+    mask = size - 1;
+    clear();
+}
+
+void EvalCache::clear()
+{
+    for (Entry& e : table) {
+        e.check = 0;
+        e.score = 0;
+        e.valid = 0;
+    }
+}
@@ -0,0 +1,53 @@
+#ifndef EVALCACHE_H
+#define EVALCACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Direct-mapped cache of static evaluations keyed by the position's Zobrist key.
+// The low key bits select the slot and the high 32 bits verify it, so an entry
+// is only 8 bytes.
+class EvalCache {
+public:
+    explicit EvalCache(size_t sizeInKilobytes = 1024);
+
+    // Resize (rounded down to a power of two) and clear the cache
+    void resize(size_t sizeInKilobytes);
+    void clear();
+
+    bool probe(uint64_t key, int& score) {
+        const Entry& e = table[key & mask];
+        ++probeCount;
+        if (e.check != uint32_t(key >> 32) || !e.valid) return false;
+        ++hitCount;
+        score = e.score;
+        return true;
+    }
+
+    void store(uint64_t key, int score) {
+        Entry& e = table[key & mask];
+        e.check = uint32_t(key >> 32);
+        e.score = score;
+        e.valid = 1;
+    }
+
+    size_t sizeInKilobytes() const { return table.size() * sizeof(Entry) / 1024; }
+    uint64_t probes() const { return probeCount; }
+    uint64_t hits() const { return hitCount; }
+    void resetStats() { probeCount = hitCount = 0; }
+
+private:
+    struct Entry {
+        uint32_t check;
+        int32_t score : 31;
+        uint32_t valid : 1;
+    };
+
+    std::vector<Entry> table;
+    uint64_t mask;
+    uint64_t probeCount;
+    uint64_t hitCount;
+};
+
+#endif // EVALCACHE_H
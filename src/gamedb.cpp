@@ -0,0 +1,238 @@
+#include "gamedb.h"
+#include "movegen.h"
+#include <algorithm>
+#include <cstring>
+
+static const char DbMagic[8] = {'C', 'B', 'G', 'D', 'B', '1', 0, 0};
+static const char* const ResultNames[4] = {"*", "1-0", "0-1", "1/2-1/2"};
+
+std::string DbGame::tag(const std::string& name) const
+{
+    for (const auto& t : tags) {
+        if (t.first == name)
+            return t.second;
+    }
+    return std::string();
+}
+
+GameDatabase::GameDatabase()
+    : games(0), indexCount(0), gameTable(nullptr), gameData(nullptr), gameDataSize(0), index(nullptr)
+{
+}
+
+bool GameDatabase::open(const std::string& path)
+{
+    close();
+    if (!file.open(path))
+        return false;
+
+    const unsigned char* data = file.data();
+    if (file.size() < size_t(HEADER_SIZE) || std::memcmp(data, DbMagic, sizeof(DbMagic)) != 0) {
+        file.close();
+        return false;
+    }
+
+    uint32_t count;
+    uint64_t tableOffset, dataOffset, indexOffset, entries;
+    std::memcpy(&count, data + 8, 4);
+    std::memcpy(&tableOffset, data + 16, 8);
+    std::memcpy(&dataOffset, data + 24, 8);
+    std::memcpy(&indexOffset, data + 32, 8);
+    std::memcpy(&entries, data + 40, 8);
+
+    if (tableOffset + uint64_t(count) * GAME_RECORD_SIZE > dataOffset || dataOffset > indexOffset ||
+        indexOffset + entries * INDEX_ENTRY_SIZE > file.size()) {
+        file.close();
+        return false;
+    }
+
+    games = count;
+    indexCount = entries;
+    gameTable = data + tableOffset;
+    gameData = data + dataOffset;
+    gameDataSize = size_t(indexOffset - dataOffset);
+    index = data + indexOffset;
+    return true;
+}
+
+void GameDatabase::close()
+{
+    file.close();
+    games = 0;
+    indexCount = 0;
+    gameTable = gameData = index = nullptr;
+    gameDataSize = 0;
+}
+
+const char* GameDatabase::resultString(int code)
+{
+    return ResultNames[code & 3];
+}
+
+int GameDatabase::resultCode(const std::string& result)
+{
+    for (int i = 1; i < 4; ++i) {
+        if (result == ResultNames[i])
+            return i;
+    }
+    return 0;
+}
+
+uint8_t GameDatabase::encodeMove(const Position& pos, PackedMove move)
+{
+    MoveList list;
+    generateLegalMoves(pos, list);
+    int rank = 0;
+    for (PackedMove m : list) {
+        if (m < move)
+            ++rank;
+    }
+    return uint8_t(rank);
+}
+
+PackedMove GameDatabase::decodeMove(const Position& pos, uint8_t code)
+{
+    MoveList list;
+    generateLegalMoves(pos, list);
+    if (code >= list.size())
+        return NO_MOVE;
+    std::nth_element(list.begin(), list.begin() + code, list.end());
+    return list[code];
+}
+
+bool GameDatabase::readGame(uint32_t n, DbGame& game, int maxPlies) const
+{
+    game.tags.clear();
+    game.moves.clear();
+    game.start.setStartPosition();
+    if (n >= games)
+        return false;
+
+    const unsigned char* record = gameTable + size_t(n) * GAME_RECORD_SIZE;
+    uint64_t offset;
+    uint16_t plies;
+    uint32_t tagBytes;
+    std::memcpy(&offset, record, 8);
+    std::memcpy(&plies, record + 8, 2);
+    std::memcpy(&tagBytes, record + 12, 4);
+    int tagCount = record[11];
+    game.result = resultString(record[10]);
+    if (offset + tagBytes + plies > gameDataSize)
+        return false;
+
+    // Tags are zero-terminated strings, name then value
+    const char* text = reinterpret_cast<const char*>(gameData + offset);
+    const char* textEnd = text + tagBytes;
+    for (int i = 0; i < tagCount; ++i) {
+        const char* name = text;
+        const char* value = static_cast<const char*>(std::memchr(name, 0, size_t(textEnd - name)));
+        if (!value)
+            return false;
+        ++value;
+        const char* next = static_cast<const char*>(std::memchr(value, 0, size_t(textEnd - value)));
+        if (!next)
+            return false;
+        game.tags.emplace_back(std::string(name, size_t(value - 1 - name)), std::string(value, size_t(next - value)));
+        text = next + 1;
+    }
+
+    std::string fen = game.tag("FEN");
+    if (!fen.empty() && !game.start.setFen(fen))
+        return false;
+
+    int count = maxPlies >= 0 ? std::min<int>(maxPlies, plies) : plies;
+    const unsigned char* codes = gameData + offset + tagBytes;
+    Position pos = game.start;
+    for (int ply = 0; ply < count; ++ply) {
+        PackedMove move = decodeMove(pos, codes[ply]);
+        if (move == NO_MOVE)
+            return false;
+        game.moves.push_back(move);
+        pos.makeMove(move);
+    }
+    return true;
+}
+
+int GameDatabase::gameResult(uint32_t n) const
+{
+    return n < games ? gameTable[size_t(n) * GAME_RECORD_SIZE + 10] & 3 : 0;
+}
+
+std::string_view GameDatabase::gameTag(uint32_t n, std::string_view name) const
+{
+    if (n >= games)
+        return std::string_view();
+    const unsigned char* record = gameTable + size_t(n) * GAME_RECORD_SIZE;
+    uint64_t offset;
+    uint32_t tagBytes;
+    std::memcpy(&offset, record, 8);
+    std::memcpy(&tagBytes, record + 12, 4);
+    if (offset + tagBytes > gameDataSize)
+        return std::string_view();
+
+    // Alternating names and values, each zero-terminated
+    std::string_view text(reinterpret_cast<const char*>(gameData + offset), tagBytes);
+    for (bool isName = true; !text.empty(); isName = !isName) {
+        size_t end = text.find('\0');
+        if (end == std::string_view::npos)
+            break;
+        std::string_view field = text.substr(0, end);
+        text.remove_prefix(end + 1);
+        if (isName && field == name) {
+            end = text.find('\0');
+            return end == std::string_view::npos ? std::string_view() : text.substr(0, end);
+        }
+    }
+    return std::string_view();
+}
+
+uint64_t GameDatabase::keyAt(uint64_t i) const
+{
+    uint64_t key;
+    std::memcpy(&key, index + i * INDEX_ENTRY_SIZE, 8);
+    return key;
+}
+
+uint64_t GameDatabase::lowerBound(uint64_t key) const
+{
+    uint64_t low = 0, high = indexCount;
+    while (low < high) {
+        uint64_t mid = low + (high - low) / 2;
+        if (keyAt(mid) < key)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return low;
+}
+
+std::vector<DbHit> GameDatabase::find(const Position& pos) const
+{
+    std::vector<DbHit> hits;
+    uint64_t key = pos.key();
+    uint64_t first = lowerBound(key);
+    if (first == indexCount || keyAt(first) != key)
+        return hits;
+
+    // Move codes are ranks in the sorted legal move list; sort it once
+    MoveList list;
+    generateLegalMoves(pos, list);
+    std::sort(list.begin(), list.end());
+
+    for (uint64_t i = first; i < indexCount && keyAt(i) == key; ++i) {
+        const unsigned char* entry = index + i * INDEX_ENTRY_SIZE;
+        DbHit hit;
+        std::memcpy(&hit.game, entry + 8, 4);
+        std::memcpy(&hit.ply, entry + 12, 2);
+        hit.next = entry[14] < list.size() ? list[entry[14]] : NO_MOVE;
+        hits.push_back(hit);
+    }
+    return hits;
+}
+
+uint64_t GameDatabase::count(const Position& pos) const
+{
+    uint64_t key = pos.key();
+    uint64_t last = key == ~0ULL ? indexCount : lowerBound(key + 1);
+    return last - lowerBound(key);
+}
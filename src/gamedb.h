@@ -0,0 +1,109 @@
+#ifndef GAMEDB_H
+#define GAMEDB_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "position.h"
+#include "mappedfile.h"
+
+// Binary game database (".cbdb"), mapped into memory and read in place.
+//
+// Moves are stored as one byte each: the move's rank among the legal moves
+// of its position, ordered by PackedMove value. No position has more than
+// 218 legal moves, so a byte is always enough, and the code does not depend
+// on the order the move generator happens to produce moves in.
+//
+// File layout (little-endian, each array starts on a 64-byte boundary):
+//   char[8]   magic "CBGDB1"
+//   uint32    game count
+//   uint32    flags (unused)
+//   uint64    offset of the game table, the game data and the index
+//   uint64    index entry count
+//   game table, 16 bytes per game:
+//     uint64  offset of the game's data from the start of the game data
+//     uint16  plies
+//     uint8   result (0 "*", 1 "1-0", 2 "0-1", 3 "1/2-1/2")
+//     uint8   tag count
+//     uint32  bytes of tags
+//   game data, per game: tags as "name\0value\0" pairs (the start position
+//     is the "FEN" tag, as in PGN), then one byte per ply
+//   index, 16 bytes per entry, sorted by key, then game, then ply:
+//     uint64  Zobrist key of the position
+//     uint32  game
+//     uint16  first ply of the game the position occurs at
+//     uint8   code of the move played there, 255 if the game ended
+//     uint8   unused
+// Each game has one index entry per distinct position it passes through,
+// from the start position on (up to the ply limit it was built with).
+
+struct DbGame {
+    std::vector<std::pair<std::string, std::string>> tags;
+    Position start;
+    std::vector<PackedMove> moves;
+    std::string result;
+
+    // Value of a tag, or "" if the game has none
+    std::string tag(const std::string& name) const;
+};
+
+struct DbHit {
+    uint32_t game;
+    uint16_t ply;
+    PackedMove next; // Move the game went on with, NO_MOVE if it ended there
+};
+
+class GameDatabase {
+public:
+    GameDatabase();
+
+    bool open(const std::string& path);
+    void close();
+
+    bool isOpen() const { return file.isOpen(); }
+    uint32_t gameCount() const { return games; }
+    uint64_t indexSize() const { return indexCount; }
+
+    // Game number n (0-based). With maxPlies >= 0 only that many moves are
+    // decoded (0 reads just the tags). False if n is out of range or the
+    // game data is damaged.
+    bool readGame(uint32_t n, DbGame& game, int maxPlies = -1) const;
+    // Result code (see resultString) and one tag of game n, without reading
+    // the rest; the tag is "" if the game has none
+    int gameResult(uint32_t n) const;
+    std::string_view gameTag(uint32_t n, std::string_view name) const;
+
+    // Every game that reaches pos, in game order
+    std::vector<DbHit> find(const Position& pos) const;
+    // Number of games reaching pos, without listing them
+    uint64_t count(const Position& pos) const;
+
+    // Move codes (see above); decodeMove returns NO_MOVE for a code that
+    // is not a legal move's
+    static uint8_t encodeMove(const Position& pos, PackedMove move);
+    static PackedMove decodeMove(const Position& pos, uint8_t code);
+
+    static const int HEADER_SIZE = 64;
+    static const int GAME_RECORD_SIZE = 16;
+    static const int INDEX_ENTRY_SIZE = 16;
+
+    static const char* resultString(int code);
+    static int resultCode(const std::string& result);
+
+private:
+    MappedFile file;
+    uint32_t games;
+    uint64_t indexCount;
+    const unsigned char* gameTable;
+    const unsigned char* gameData;
+    size_t gameDataSize;
+    const unsigned char* index;
+
+    uint64_t keyAt(uint64_t i) const;
+    // First index entry with a key not below key
+    uint64_t lowerBound(uint64_t key) const;
+};
+
+#endif // GAMEDB_H
@@ -0,0 +1,255 @@
+#include "gamedbbuilder.h"
+#include "gamedb.h"
+#include "mappedfile.h"
+#include "pgn.h"
+#include "san.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <thread>
+
+// Size of the pieces a PGN file is cut into
+static const size_t PieceBytes = 4 << 20;
+
+static size_t alignUp(size_t offset)
+{
+    return (offset + 63) & ~size_t(63);
+}
+
+GameDatabaseBuilder::GameDatabaseBuilder(int threads)
+    : threadCount(threads > 0 ? threads : std::max(1, int(std::thread::hardware_concurrency()))),
+      indexPlies(0)
+{
+}
+
+void GameDatabaseBuilder::encodeGame(Chunk& chunk, const std::vector<std::pair<std::string, std::string>>& tags,
+                                     const Position& start, const std::vector<PackedMove>& moves,
+                                     const std::string& result) const
+{
+    Record record;
+    record.offset = chunk.data.size();
+    record.plies = uint16_t(std::min<size_t>(moves.size(), 0xFFFF));
+    record.result = uint8_t(GameDatabase::resultCode(result));
+    record.tagCount = 0;
+
+    // The result has its own field and the start position is kept as a FEN
+    // tag only when it is not the usual one
+    auto addTag = [&](const std::string& name, const std::string& value) {
+        if (record.tagCount == 0xFF)
+            return;
+        chunk.data.insert(chunk.data.end(), name.begin(), name.end());
+        chunk.data.push_back(0);
+        chunk.data.insert(chunk.data.end(), value.begin(), value.end());
+        chunk.data.push_back(0);
+        record.tagCount++;
+    };
+    for (const auto& t : tags) {
+        if (t.first != "Result" && t.first != "SetUp" && t.first != "FEN")
+            addTag(t.first, t.second);
+    }
+    std::string fen = start.fen();
+    if (fen != START_FEN)
+        addTag("FEN", fen);
+    record.tagBytes = uint32_t(chunk.data.size() - record.offset);
+
+    // Moves, and the first ply each distinct position is reached at
+    uint32_t game = uint32_t(chunk.records.size());
+    size_t firstEntry = chunk.index.size();
+    Position pos = start;
+    for (int ply = 0; ply <= record.plies; ++ply) {
+        uint8_t code = ply < record.plies ? GameDatabase::encodeMove(pos, moves[ply]) : 0xFF;
+        if (indexPlies <= 0 || ply <= indexPlies)
+            chunk.index.push_back({pos.key(), game, uint16_t(ply), code});
+        if (ply == record.plies)
+            break;
+        chunk.data.push_back(code);
+        pos.makeMove(moves[ply]);
+    }
+    auto first = chunk.index.begin() + std::ptrdiff_t(firstEntry);
+    std::sort(first, chunk.index.end(), [](const IndexEntry& a, const IndexEntry& b) {
+        return a.key != b.key ? a.key < b.key : a.ply < b.ply;
+    });
+    chunk.index.erase(std::unique(first, chunk.index.end(),
+                                  [](const IndexEntry& a, const IndexEntry& b) { return a.key == b.key; }),
+                      chunk.index.end());
+
+    chunk.records.push_back(record);
+}
+
+bool GameDatabaseBuilder::append(Chunk& chunk)
+{
+    if (records.size() + chunk.records.size() > 0xFFFFFFFFULL) {
+        message("game database is full");
+        return false;
+    }
+    uint32_t firstGame = uint32_t(records.size());
+    uint64_t dataBase = data.size();
+    for (Record& record : chunk.records) {
+        record.offset += dataBase;
+        records.push_back(record);
+    }
+    for (IndexEntry& entry : chunk.index) {
+        entry.game += firstGame;
+        index.push_back(entry);
+    }
+    data.insert(data.end(), chunk.data.begin(), chunk.data.end());
+    chunk = Chunk();
+    return true;
+}
+
+bool GameDatabaseBuilder::addGame(const std::vector<std::pair<std::string, std::string>>& tags,
+                                  const Position& start, const std::vector<PackedMove>& moves,
+                                  const std::string& result)
+{
+    Chunk chunk;
+    encodeGame(chunk, tags, start, moves, result);
+    return append(chunk);
+}
+
+bool GameDatabaseBuilder::addPgn(const std::string& path)
+{
+    MappedFile file;
+    if (!file.open(path)) {
+        message(path + ": could not be opened");
+        return false;
+    }
+    auto startTime = std::chrono::steady_clock::now();
+    const char* text = reinterpret_cast<const char*>(file.data());
+    size_t size = file.size();
+
+    // Cut at game starts so every piece holds whole games
+    std::vector<size_t> cuts = {0};
+    while (cuts.back() < size)
+        cuts.push_back(PgnReader::nextGameStart(text, size, std::min(size, cuts.back() + PieceBytes)));
+
+    std::vector<Chunk> chunks(cuts.size() - 1);
+    std::atomic<size_t> nextPiece(0);
+    std::atomic<uint64_t> skipped(0), truncated(0);
+    auto worker = [&]() {
+        PgnGame game;
+        Position start;
+        std::vector<PackedMove> moves;
+        size_t piece;
+        while ((piece = nextPiece.fetch_add(1)) + 1 < cuts.size()) {
+            PgnReader reader(text + cuts[piece], cuts[piece + 1] - cuts[piece]);
+            while (reader.readGame(game)) {
+                std::string fen = game.tag("FEN");
+                if (fen.empty())
+                    start.setStartPosition();
+                else if (!start.setFen(fen)) {
+                    skipped++;
+                    continue;
+                }
+
+                moves.clear();
+                Position pos = start;
+                for (std::string_view san : game.moves) {
+                    PackedMove move = parseSan(pos, san);
+                    if (move == NO_MOVE) {
+                        truncated++;
+                        break;
+                    }
+                    moves.push_back(move);
+                    pos.makeMove(move);
+                }
+                encodeGame(chunks[piece], game.tags, start, moves, game.result);
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (int i = 1; i < threadCount; ++i)
+        workers.emplace_back(worker);
+    worker();
+    for (std::thread& t : workers)
+        t.join();
+
+    uint64_t added = 0;
+    for (Chunk& chunk : chunks) {
+        added += chunk.records.size();
+        if (!append(chunk))
+            return false;
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    char summary[160];
+    std::snprintf(summary, sizeof(summary), ": %llu games, %llu skipped, %llu cut at an illegal move (%.1fs)",
+                  (unsigned long long)added, (unsigned long long)skipped, (unsigned long long)truncated, seconds);
+    message(path + summary);
+    return true;
+}
+
+bool GameDatabaseBuilder::write(const std::string& path)
+{
+    std::sort(index.begin(), index.end(), [](const IndexEntry& a, const IndexEntry& b) {
+        if (a.key != b.key) return a.key < b.key;
+        return a.game != b.game ? a.game < b.game : a.ply < b.ply;
+    });
+
+    uint64_t tableOffset = GameDatabase::HEADER_SIZE;
+    uint64_t dataOffset = alignUp(size_t(tableOffset + records.size() * GameDatabase::GAME_RECORD_SIZE));
+    uint64_t indexOffset = alignUp(size_t(dataOffset + data.size()));
+    uint64_t entries = index.size();
+    uint32_t games = uint32_t(records.size());
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        message(path + ": could not be written");
+        return false;
+    }
+
+    char header[GameDatabase::HEADER_SIZE] = {'C', 'B', 'G', 'D', 'B', '1'};
+    std::memcpy(header + 8, &games, 4);
+    std::memcpy(header + 16, &tableOffset, 8);
+    std::memcpy(header + 24, &dataOffset, 8);
+    std::memcpy(header + 32, &indexOffset, 8);
+    std::memcpy(header + 40, &entries, 8);
+    out.write(header, sizeof(header));
+
+    // Sections go out through one buffer, padded to their offsets
+    std::vector<char> buffer;
+    auto flush = [&](uint64_t padTo) {
+        if (padTo)
+            buffer.resize(size_t(padTo - uint64_t(out.tellp())), 0);
+        out.write(buffer.data(), std::streamsize(buffer.size()));
+        buffer.clear();
+    };
+
+    for (const Record& r : records) {
+        char bytes[GameDatabase::GAME_RECORD_SIZE];
+        std::memcpy(bytes, &r.offset, 8);
+        std::memcpy(bytes + 8, &r.plies, 2);
+        bytes[10] = char(r.result);
+        bytes[11] = char(r.tagCount);
+        std::memcpy(bytes + 12, &r.tagBytes, 4);
+        buffer.insert(buffer.end(), bytes, bytes + sizeof(bytes));
+    }
+    flush(dataOffset);
+    buffer.assign(data.begin(), data.end());
+    flush(indexOffset);
+
+    for (const IndexEntry& e : index) {
+        char bytes[GameDatabase::INDEX_ENTRY_SIZE] = {};
+        std::memcpy(bytes, &e.key, 8);
+        std::memcpy(bytes + 8, &e.game, 4);
+        std::memcpy(bytes + 12, &e.ply, 2);
+        bytes[14] = char(e.next);
+        buffer.insert(buffer.end(), bytes, bytes + sizeof(bytes));
+        if (buffer.size() >= (1 << 20))
+            flush(0);
+    }
+    flush(0);
+    out.close();
+    if (!out) {
+        message(path + ": could not be written");
+        return false;
+    }
+
+    char summary[120];
+    std::snprintf(summary, sizeof(summary), ": %u games, %llu indexed positions, %.1f MB",
+                  games, (unsigned long long)entries, double(indexOffset + entries * GameDatabase::INDEX_ENTRY_SIZE) / 1048576.0);
+    message(path + summary);
+    return true;
+}
@@ -0,0 +1,72 @@
+#ifndef GAMEDBBUILDER_H
+#define GAMEDBBUILDER_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+#include "position.h"
+
+// Collects games and writes them as a game database (see gamedb.h).
+//
+// PGN files are mapped and cut at game boundaries like for the book
+// builder; worker threads encode the pieces independently and the results
+// are appended in file order, so game numbers follow the PGN files.
+class GameDatabaseBuilder {
+public:
+    explicit GameDatabaseBuilder(int threads = 0); // 0 = all cores
+
+    void setLogger(std::function<void(const std::string&)> logger) { log = logger; }
+    // Index only the first plies of each game (default 0 = all of them)
+    void setIndexPlies(int plies) { indexPlies = plies; }
+
+    // Add every readable game of a PGN file; a game with an illegal move
+    // keeps the moves before it
+    bool addPgn(const std::string& path);
+
+    // Add one game; false if the database is full
+    bool addGame(const std::vector<std::pair<std::string, std::string>>& tags, const Position& start,
+                 const std::vector<PackedMove>& moves, const std::string& result);
+
+    uint32_t gameCount() const { return uint32_t(records.size()); }
+
+    // Write the database; false if the file can't be written
+    bool write(const std::string& path);
+
+private:
+    struct Record {
+        uint64_t offset;
+        uint16_t plies;
+        uint8_t result;
+        uint8_t tagCount;
+        uint32_t tagBytes;
+    };
+    struct IndexEntry {
+        uint64_t key;
+        uint32_t game;
+        uint16_t ply;
+        uint8_t next;
+    };
+    // Encoded games with their own game numbering, starting at 0
+    struct Chunk {
+        std::vector<unsigned char> data;
+        std::vector<Record> records;
+        std::vector<IndexEntry> index;
+    };
+
+    int threadCount;
+    int indexPlies;
+    std::function<void(const std::string&)> log;
+    std::vector<unsigned char> data;
+    std::vector<Record> records;
+    std::vector<IndexEntry> index;
+
+    void message(const std::string& text) const { if (log) log(text); }
+    void encodeGame(Chunk& chunk, const std::vector<std::pair<std::string, std::string>>& tags,
+                    const Position& start, const std::vector<PackedMove>& moves, const std::string& result) const;
+    bool append(Chunk& chunk);
+};
+
+#endif // GAMEDBBUILDER_H
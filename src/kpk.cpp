@@ -0,0 +1,132 @@
+#include "kpk.h"
+
+#include "kpkbitbase.inc"
+
+static_assert(sizeof(KpkBitbase) * 8 == KPK_POSITIONS, "KPK bitbase has one bit per position");
+
+// White has the pawn, on files a-d
+static int kpkIndex(Color sideToMove, Square blackKing, Square whiteKing, Square pawn)
+{
+    return whiteKing | (blackKing << 6) | (sideToMove << 12)
+         | (fileOf(pawn) << 13) | ((6 - rankOf(pawn)) << 15);
+}
+
+bool kpkProbe(Color strongSide, Square strongKing, Square pawn, Square weakKing, Color sideToMove)
+{
+    // Look at it from white's side, with the pawn on the queen side
+    if (strongSide == BLACK) {
+        strongKing = Square(strongKing ^ 56);
+        weakKing = Square(weakKing ^ 56);
+        pawn = Square(pawn ^ 56);
+        sideToMove = ~sideToMove;
+    }
+    if (fileOf(pawn) > 3) {
+        strongKing = Square(strongKing ^ 7);
+        weakKing = Square(weakKing ^ 7);
+        pawn = Square(pawn ^ 7);
+    }
+
+    int index = kpkIndex(sideToMove, weakKing, strongKing, pawn);
+    return KpkBitbase[index >> 5] & (1u << (index & 31));
+}
+
+bool kpkProbe(const Position& pos)
+{
+    Square pawn = lsb(pos.pieces(PAWN));
+    Color strong = colorOf(pos.pieceOn(pawn));
+    return kpkProbe(strong, pos.kingSquare(strong), pawn, pos.kingSquare(~strong), pos.sideToMove());
+}
+
+namespace {
+
+// Flags so that results of several moves can be or-ed together
+enum KpkResult : uint8_t {
+    KPK_INVALID = 0,
+    KPK_UNKNOWN = 1,
+    KPK_DRAW = 2,
+    KPK_WIN = 4
+};
+
+struct KpkPosition {
+    Color us;
+    Square kings[2];
+    Square pawn;
+    uint8_t result;
+
+    void init(int index)
+    {
+        kings[WHITE] = Square(index & 63);
+        kings[BLACK] = Square((index >> 6) & 63);
+        us = Color((index >> 12) & 1);
+        pawn = makeSquare((index >> 13) & 3, 6 - ((index >> 15) & 7));
+
+        Square push = Square(pawn + 8);
+        if ((KingAttacks[kings[WHITE]] & squareBB(kings[BLACK])) || kings[WHITE] == kings[BLACK]
+            || kings[WHITE] == pawn || kings[BLACK] == pawn
+            || (us == WHITE && (PawnAttacks[WHITE][pawn] & squareBB(kings[BLACK])))) {
+            result = KPK_INVALID;
+        } else if (us == WHITE && rankOf(pawn) == 6 && kings[WHITE] != push && kings[BLACK] != push
+                   && (!(KingAttacks[kings[BLACK]] & squareBB(push)) || (KingAttacks[kings[WHITE]] & squareBB(push)))) {
+            result = KPK_WIN; // Promotes and the queen can't be taken
+        } else if (us == BLACK && !(KingAttacks[kings[BLACK]] & ~(KingAttacks[kings[WHITE]] | PawnAttacks[WHITE][pawn]))) {
+            result = KPK_DRAW; // Stalemate
+        } else if (us == BLACK && (KingAttacks[kings[BLACK]] & squareBB(pawn) & ~KingAttacks[kings[WHITE]])) {
+            result = KPK_DRAW; // The pawn falls
+        } else {
+            result = KPK_UNKNOWN;
+        }
+    }
+
+    // White wins if any move wins; black draws if any move draws
+    uint8_t classify(const std::vector<KpkPosition>& db) const
+    {
+        Color them = ~us;
+        uint8_t good = us == WHITE ? KPK_WIN : KPK_DRAW;
+        uint8_t bad = us == WHITE ? KPK_DRAW : KPK_WIN;
+        uint8_t r = KPK_INVALID;
+
+        for (Bitboard b = KingAttacks[kings[us]]; b;) {
+            Square to = popLsb(b);
+            r |= us == WHITE ? db[kpkIndex(them, kings[BLACK], to, pawn)].result
+                             : db[kpkIndex(them, to, kings[WHITE], pawn)].result;
+        }
+
+        if (us == WHITE) {
+            Square push = Square(pawn + 8);
+            if (rankOf(pawn) < 6)
+                r |= db[kpkIndex(them, kings[BLACK], kings[WHITE], push)].result;
+            if (rankOf(pawn) == 1 && push != kings[WHITE] && push != kings[BLACK])
+                r |= db[kpkIndex(them, kings[BLACK], kings[WHITE], Square(push + 8))].result;
+        }
+
+        return (r & good) ? good : (r & KPK_UNKNOWN) ? uint8_t(KPK_UNKNOWN) : bad;
+    }
+};
+
+} // namespace
+
+std::vector<uint32_t> generateKpkBitbase()
+{
+    initBitboards();
+
+    std::vector<KpkPosition> db(KPK_POSITIONS);
+    for (int i = 0; i < KPK_POSITIONS; ++i)
+        db[i].init(i);
+
+    // Sweep until nothing changes; what stays unknown can't be won
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (KpkPosition& p : db) {
+            if (p.result == KPK_UNKNOWN && (p.result = p.classify(db)) != KPK_UNKNOWN)
+                changed = true;
+        }
+    }
+
+    std::vector<uint32_t> bits(KPK_POSITIONS / 32, 0);
+    for (int i = 0; i < KPK_POSITIONS; ++i) {
+        if (db[i].result == KPK_WIN)
+            bits[i >> 5] |= 1u << (i & 31);
+    }
+    return bits;
+}
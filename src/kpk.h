@@ -0,0 +1,26 @@
+#ifndef KPK_H
+#define KPK_H
+
+#include <cstdint>
+#include <vector>
+#include "position.h"
+
+// King and pawn against king: exact win/draw from a 24 KB bitbase compiled
+// into the engine (src/kpkbitbase.inc, written by "chesstool kpkgen").
+//
+// One bit per position, indexed by side to move, pawn square (files a-d,
+// ranks 2-7; other files are mirrored), weak king and strong king squares.
+
+const int KPK_POSITIONS = 2 * 24 * 64 * 64;
+
+// True if strongSide, the side with the pawn, wins with best play
+bool kpkProbe(Color strongSide, Square strongKing, Square pawn, Square weakKing, Color sideToMove);
+
+// pos must have exactly two kings and one pawn
+bool kpkProbe(const Position& pos);
+
+// Solve every KPK position by retrograde analysis; one bit per index, set
+// for wins. Used to write the embedded table and to check it.
+std::vector<uint32_t> generateKpkBitbase();
+
+#endif // KPK_H
@@ -2,12 +2,22 @@
 #include <QWidget>
 #include <QApplication>
 #include <QMessageBox>
+#include <QFileDialog>
 #include <QSplitter>
 #include <QGroupBox>
 #include <QFont>
+#include <QClipboard>
+#include <QInputDialog>
+#include <QFile>
+#include <QDate>
+#include <QHeaderView>
+#include <QtConcurrent/QtConcurrentRun>
+#include "mappedfile.h"
+#include "san.h"
 
 MainWindow::MainWindow(QWidget *parent)
-    : QMainWindow(parent), moveCount(1), isMultiplayerMode(false)
+    : QMainWindow(parent), explorerPendingKey(0), mateProgress(nullptr),
+      mateKey(0), mateMaxMoves(0), isMultiplayerMode(false), moveCount(1)
 {
     // Initialize Bluetooth components
     bluetoothManager = new BluetoothManager(this);
@@ -21,8 +31,18 @@ MainWindow::MainWindow(QWidget *parent)
     connect(chessBoard, &ChessBoard::moveMade, this, &MainWindow::onMoveMade);
     connect(chessBoard, &ChessBoard::moveMadeWithCoords, this, &MainWindow::onMoveMadeWithCoords);
     connect(chessBoard, &ChessBoard::gameStatusChanged, this, &MainWindow::onGameStatusChanged);
+    connect(chessBoard, &ChessBoard::gameEnded, this, &MainWindow::onGameEnded);
+    connect(chessBoard, &ChessBoard::aiPrincipalVariation, this, &MainWindow::onAIPrincipalVariation);
     connect(newGameButton, &QPushButton::clicked, this, &MainWindow::newGame);
     
+    explorerWatcher = new QFutureWatcher<std::vector<ExplorerMove>>(this);
+    connect(explorerWatcher, &QFutureWatcher<std::vector<ExplorerMove>>::finished,
+            this, &MainWindow::onExplorerLookupFinished);
+    connect(explorerTree, &QTreeWidget::itemDoubleClicked, this, &MainWindow::onExplorerMoveActivated);
+    
+    mateWatcher = new QFutureWatcher<MateResult>(this);
+    connect(mateWatcher, &QFutureWatcher<MateResult>::finished, this, &MainWindow::onMateSearchFinished);
+    
     // Connect Bluetooth signals
     connect(bluetoothManager, &BluetoothManager::messageReceived, this, &MainWindow::onBluetoothMessageReceived);
     connect(bluetoothManager, &BluetoothManager::remoteDeviceConnected, this, &MainWindow::onBluetoothConnected);
@@ -36,6 +56,10 @@ MainWindow::MainWindow(QWidget *parent)
 
 MainWindow::~MainWindow()
 {
+    // A running mate search owns its copy of the position; just stop it
+    if (mateSearch) {
+        mateSearch->cancel();
+    }
 }
 
 void MainWindow::setupUI()
@@ -108,6 +132,25 @@ void MainWindow::setupUI()
     historyLayout->addWidget(moveHistory);
     rightLayout->addWidget(historyGroup);
     
+    // Opening explorer
+    explorerGroup = new QGroupBox("Opening Explorer", this);
+    QVBoxLayout *explorerLayout = new QVBoxLayout(explorerGroup);
+    
+    explorerLabel = new QLabel("Open a game database from the File menu to see the moves played here", this);
+    explorerLabel->setWordWrap(true);
+    explorerLayout->addWidget(explorerLabel);
+    
+    explorerTree = new QTreeWidget(this);
+    explorerTree->setColumnCount(4);
+    explorerTree->setHeaderLabels({"Move", "Games", "Score", "Elo"});
+    explorerTree->setRootIsDecorated(false);
+    explorerTree->setFont(QFont("Courier", 10));
+    explorerTree->header()->setSectionResizeMode(QHeaderView::ResizeToContents);
+    explorerTree->setToolTip("Double-click a move to play it");
+    explorerTree->setMaximumHeight(200);
+    explorerLayout->addWidget(explorerTree);
+    rightLayout->addWidget(explorerGroup);
+    
     // AI Controls
     QGroupBox *aiGroup = new QGroupBox("AI Opponent", this);
     QVBoxLayout *aiLayout = new QVBoxLayout(aiGroup);
@@ -150,12 +193,44 @@ void MainWindow::setupUI()
     connect(aiDifficultyComboBox, &QComboBox::currentTextChanged, this, &MainWindow::onAIDifficultyChanged);
     aiLayout->addWidget(aiDifficultyComboBox);
     
+    // Opening book depth, in moves per side
+    QLabel *bookDepthLabel = new QLabel("Book moves:", this);
+    aiLayout->addWidget(bookDepthLabel);
+    
+    bookDepthSpinBox = new QSpinBox(this);
+    bookDepthSpinBox->setRange(0, 40);
+    bookDepthSpinBox->setValue(ChessAI::DEFAULT_BOOK_DEPTH / 2);
+    bookDepthSpinBox->setToolTip("Moves per side played from the opening book, if one is loaded");
+    connect(bookDepthSpinBox, QOverload<int>::of(&QSpinBox::valueChanged), this, &MainWindow::onBookDepthChanged);
+    aiLayout->addWidget(bookDepthSpinBox);
+    
+    // Number of ranked moves shown after each AI move
+    QLabel *analysisLinesLabel = new QLabel("Analysis lines:", this);
+    aiLayout->addWidget(analysisLinesLabel);
+    
+    analysisLinesSpinBox = new QSpinBox(this);
+    analysisLinesSpinBox->setRange(1, 5);
+    analysisLinesSpinBox->setValue(1);
+    analysisLinesSpinBox->setToolTip("Best moves shown with their lines after each AI move");
+    connect(analysisLinesSpinBox, QOverload<int>::of(&QSpinBox::valueChanged), this, &MainWindow::onAnalysisLinesChanged);
+    aiLayout->addWidget(analysisLinesSpinBox);
+    
+    // Line the AI expects after its last move
+    aiLineLabel = new QLabel(this);
+    aiLineLabel->setWordWrap(true);
+    aiLineLabel->setToolTip("Principal variation of the AI's last search, with its evaluation for White");
+    aiLayout->addWidget(aiLineLabel);
+    
     // Initially disable AI controls
     colorLabel->setEnabled(false);
     aiWhiteRadio->setEnabled(false);
     aiBlackRadio->setEnabled(false);
     difficultyLabel->setEnabled(false);
     aiDifficultyComboBox->setEnabled(false);
+    bookDepthLabel->setEnabled(false);
+    bookDepthSpinBox->setEnabled(false);
+    analysisLinesLabel->setEnabled(false);
+    analysisLinesSpinBox->setEnabled(false);
     
     rightLayout->addWidget(aiGroup);
     
@@ -179,6 +254,58 @@ void MainWindow::createMenus()
     connect(newGameAction, &QAction::triggered, this, &MainWindow::newGame);
     fileMenu->addAction(newGameAction);
     
+    QAction *copyPositionAction = new QAction("&Copy Position (FEN)", this);
+    copyPositionAction->setShortcut(QKeySequence("Ctrl+Shift+C"));
+    copyPositionAction->setStatusTip("Copy the current position to the clipboard as FEN");
+    connect(copyPositionAction, &QAction::triggered, this, &MainWindow::copyPosition);
+    fileMenu->addAction(copyPositionAction);
+    
+    QAction *setUpPositionAction = new QAction("&Set Up Position (FEN)...", this);
+    setUpPositionAction->setShortcut(QKeySequence("Ctrl+Shift+V"));
+    setUpPositionAction->setStatusTip("Continue the game from a position given as FEN");
+    connect(setUpPositionAction, &QAction::triggered, this, &MainWindow::setUpPosition);
+    fileMenu->addAction(setUpPositionAction);
+    
+    QAction *findMateAction = new QAction("Find &Mate...", this);
+    findMateAction->setShortcut(QKeySequence("Ctrl+M"));
+    findMateAction->setStatusTip("Search the position on the board for the shortest forced mate");
+    connect(findMateAction, &QAction::triggered, this, &MainWindow::findMate);
+    fileMenu->addAction(findMateAction);
+    
+    QAction *exportGameAction = new QAction("&Export Game (PGN)...", this);
+    exportGameAction->setShortcut(QKeySequence::Save);
+    exportGameAction->setStatusTip("Save the game so far as a PGN file");
+    connect(exportGameAction, &QAction::triggered, this, &MainWindow::exportGame);
+    fileMenu->addAction(exportGameAction);
+    
+    QAction *importGameAction = new QAction("&Import Game (PGN)...", this);
+    importGameAction->setShortcut(QKeySequence::Open);
+    importGameAction->setStatusTip("Continue a game from a PGN file");
+    connect(importGameAction, &QAction::triggered, this, &MainWindow::importGame);
+    fileMenu->addAction(importGameAction);
+    
+    fileMenu->addSeparator();
+    
+    QAction *loadNetworkAction = new QAction("Load &Neural Network...", this);
+    loadNetworkAction->setStatusTip("Use a neural network file for AI evaluation");
+    connect(loadNetworkAction, &QAction::triggered, this, &MainWindow::loadNeuralNetwork);
+    fileMenu->addAction(loadNetworkAction);
+    
+    QAction *loadTablebasesAction = new QAction("Load Endgame &Tablebases...", this);
+    loadTablebasesAction->setStatusTip("Use endgame tablebase files for perfect endgame play");
+    connect(loadTablebasesAction, &QAction::triggered, this, &MainWindow::loadTablebases);
+    fileMenu->addAction(loadTablebasesAction);
+    
+    QAction *loadBookAction = new QAction("Load Opening &Book...", this);
+    loadBookAction->setStatusTip("Play opening moves from a Polyglot-format book file");
+    connect(loadBookAction, &QAction::triggered, this, &MainWindow::loadOpeningBook);
+    fileMenu->addAction(loadBookAction);
+    
+    QAction *loadDatabaseAction = new QAction("Open Game &Database...", this);
+    loadDatabaseAction->setStatusTip("Show the moves played from each position in a game database");
+    connect(loadDatabaseAction, &QAction::triggered, this, &MainWindow::loadGameDatabase);
+    fileMenu->addAction(loadDatabaseAction);
+    
     fileMenu->addSeparator();
     
     QAction *exitAction = new QAction("E&xit", this);
@@ -218,11 +345,214 @@ void MainWindow::newGame()
     if (reply == QMessageBox::Yes) {
         chessBoard->resetBoard();
         moveHistory->clear();
+        aiLineLabel->clear();
         moveCount = 1;
+        updateExplorer();
         statusBar()->showMessage("New game started", 2000);
     }
 }
 
+void MainWindow::copyPosition()
+{
+    QApplication::clipboard()->setText(chessBoard->fen());
+    statusBar()->showMessage("Position copied as FEN", 2000);
+}
+
+void MainWindow::setUpPosition()
+{
+    // Offer the clipboard if it holds something FEN-like, else the current position
+    QString suggestion = QApplication::clipboard()->text().trimmed();
+    if (suggestion.count('/') != 7 || suggestion.contains('\n')) {
+        suggestion = chessBoard->fen();
+    }
+    
+    bool ok = false;
+    QString fen = QInputDialog::getText(this, "Set Up Position", "FEN:", QLineEdit::Normal, suggestion, &ok);
+    if (!ok || fen.trimmed().isEmpty()) {
+        return;
+    }
+    
+    if (!chessBoard->loadFen(fen)) {
+        QMessageBox::warning(this, "Set Up Position", QString("%1 is not a legal position.").arg(fen));
+        return;
+    }
+    positionLoaded();
+    
+    if (isMultiplayerMode && bluetoothManager && bluetoothManager->isConnected()) {
+        bluetoothManager->sendGameState(chessBoard->fen());
+    }
+}
+
+// Rebuild the move list after a position or game was loaded
+void MainWindow::positionLoaded()
+{
+    moveHistory->clear();
+    aiLineLabel->clear();
+    moveCount = chessBoard->getStartPlyCount() + 1;
+    for (const QString& san : chessBoard->moveListSan()) {
+        onMoveMade(san);
+    }
+    updateExplorer();
+    statusBar()->showMessage("Position set up", 2000);
+}
+
+void MainWindow::findMate()
+{
+    if (mateWatcher->isRunning()) {
+        return;
+    }
+    
+    bool ok;
+    int moves = QInputDialog::getInt(this, "Find Mate", "Mate in at most (moves):", 3, 1, 8, 1, &ok);
+    if (!ok) {
+        return;
+    }
+    
+    // Short mates take milliseconds; the node limit keeps long tries bounded
+    // and the progress dialog can cancel them sooner
+    const uint64_t nodeLimit = 50000000;
+    std::shared_ptr<MateSearch> search = std::make_shared<MateSearch>();
+    search->setNodeLimit(nodeLimit);
+    Position snapshot = chessBoard->getPosition();
+    mateSearch = search;
+    mateKey = snapshot.key();
+    mateMaxMoves = moves;
+    
+    mateProgress = new QProgressDialog(QString("Searching for a mate in %1...").arg(moves), "Cancel", 0, 0, this);
+    mateProgress->setWindowTitle("Find Mate");
+    mateProgress->setWindowModality(Qt::WindowModal);
+    mateProgress->setMinimumDuration(500);
+    connect(mateProgress, &QProgressDialog::canceled, this, [search]() {
+        search->cancel();
+    });
+    
+    mateWatcher->setFuture(QtConcurrent::run([search, snapshot, moves]() {
+        return search->find(snapshot, moves);
+    }));
+}
+
+void MainWindow::onMateSearchFinished()
+{
+    bool cancelled = mateProgress->wasCanceled();
+    mateProgress->deleteLater();
+    mateProgress = nullptr;
+    mateSearch.reset();
+    MateResult result = mateWatcher->result();
+    int moves = mateMaxMoves;
+    
+    // The line is only readable against the position it was found in
+    if (chessBoard->getPosition().key() != mateKey) {
+        statusBar()->showMessage("Find Mate: the position changed during the search", 3000);
+        return;
+    }
+    
+    QString side = chessBoard->getPosition().sideToMove() == WHITE ? "White" : "Black";
+    if (result.moves) {
+        QMessageBox::information(this, "Find Mate", QString("%1 mates in %2:\n%3").arg(side).arg(result.moves)
+                                 .arg(chessBoard->getLineNotation(result.line)));
+    } else if (result.ruledOut >= moves) {
+        QMessageBox::information(this, "Find Mate", QString("%1 has no forced mate in %2 moves.").arg(side).arg(moves));
+    } else {
+        QMessageBox::information(this, "Find Mate",
+                                 QString("%1 has no forced mate in %2 moves; the search %3 before checking %4.")
+                                 .arg(side).arg(result.ruledOut).arg(cancelled ? "was cancelled" : "stopped")
+                                 .arg(moves));
+    }
+}
+
+void MainWindow::exportGame()
+{
+    QString path = QFileDialog::getSaveFileName(this, "Export Game", "game.pgn",
+                                                "PGN files (*.pgn);;All files (*)");
+    if (path.isEmpty()) {
+        return;
+    }
+    
+    auto playerName = [this](char color) {
+        if (chessBoard->isAIEnabled() && chessBoard->getAIColor() == color) {
+            return QString("Chess AI (%1)").arg(aiDifficultyComboBox->currentText()).toStdString();
+        }
+        return std::string("Player");
+    };
+    std::vector<std::pair<std::string, std::string>> tags = {
+        {"Event", "Casual game"},
+        {"Site", "Chess-bluetooth"},
+        {"Date", QDate::currentDate().toString("yyyy.MM.dd").toStdString()},
+        {"Round", "-"},
+        {"White", playerName('w')},
+        {"Black", playerName('b')}
+    };
+    
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text) ||
+        file.write(chessBoard->gamePgn(tags).toUtf8()) < 0) {
+        QMessageBox::warning(this, "Export Game", QString("Could not write %1.").arg(path));
+        return;
+    }
+    statusBar()->showMessage(QString("Game saved to %1").arg(path), 3000);
+}
+
+void MainWindow::importGame()
+{
+    QString path = QFileDialog::getOpenFileName(this, "Import Game", QString(),
+                                                "PGN files (*.pgn);;All files (*)");
+    if (path.isEmpty()) {
+        return;
+    }
+    
+    MappedFile file;
+    if (!file.open(path.toStdString())) {
+        QMessageBox::warning(this, "Import Game", QString("Could not open %1.").arg(path));
+        return;
+    }
+    const char* data = reinterpret_cast<const char*>(file.data());
+    
+    // List the games so one can be picked; each is read again from its offset
+    const size_t maxListed = 1000;
+    QStringList labels;
+    std::vector<size_t> offsets;
+    PgnReader reader(data, file.size());
+    PgnGame game;
+    for (size_t offset = 0; offsets.size() < maxListed && reader.readGame(game); offset = reader.offset()) {
+        offsets.push_back(offset);
+        labels << QString("%1. %2 - %3 %4 (%5)").arg(offsets.size())
+                  .arg(QString::fromStdString(game.tag("White")), QString::fromStdString(game.tag("Black")),
+                       QString::fromStdString(game.tag("Date")), QString::fromStdString(game.result));
+    }
+    if (offsets.empty()) {
+        QMessageBox::warning(this, "Import Game", QString("No games found in %1.").arg(path));
+        return;
+    }
+    
+    int index = 0;
+    if (offsets.size() > 1) {
+        bool ok = false;
+        QString choice = QInputDialog::getItem(this, "Import Game", "Game:", labels, 0, false, &ok);
+        if (!ok) {
+            return;
+        }
+        index = labels.indexOf(choice);
+    }
+    
+    PgnReader chosen(data + offsets[index], file.size() - offsets[index]);
+    chosen.readGame(game);
+    int loaded = chessBoard->loadGame(game);
+    if (loaded < 0) {
+        QMessageBox::warning(this, "Import Game", "The game starts from an invalid position.");
+        return;
+    }
+    positionLoaded();
+    if (loaded < int(game.moves.size())) {
+        QMessageBox::warning(this, "Import Game",
+                             QString("Move %1 (%2) is not legal; the game was loaded up to there.")
+                             .arg(loaded + 1).arg(QString::fromUtf8(game.moves[loaded].data(), int(game.moves[loaded].size()))));
+    }
+    
+    if (isMultiplayerMode && bluetoothManager && bluetoothManager->isConnected()) {
+        bluetoothManager->sendGameState(chessBoard->fen());
+    }
+}
+
 void MainWindow::onMoveMade(QString moveNotation)
 {
     // Add move to history
@@ -243,6 +573,7 @@ void MainWindow::onMoveMade(QString moveNotation)
     moveCount++;
     
     statusBar()->showMessage(QString("Move made: %1").arg(moveNotation), 3000);
+    updateExplorer();
     
 }
 
@@ -261,6 +592,17 @@ void MainWindow::onGameStatusChanged(QString status)
     statusBar()->showMessage(status, 3000);
 }
 
+void MainWindow::onGameEnded(QString result)
+{
+    moveHistory->append(QString("\n%1").arg(result));
+    QMessageBox::information(this, "Game Over", result);
+}
+
+void MainWindow::onAIPrincipalVariation(QString line)
+{
+    aiLineLabel->setText(line);
+}
+
 void MainWindow::showAbout()
 {
     QMessageBox::about(this, "About Chess Game",
@@ -285,11 +627,14 @@ void MainWindow::onAIEnabledChanged(bool enabled)
     aiWhiteRadio->setEnabled(enabled);
     aiBlackRadio->setEnabled(enabled);
     aiDifficultyComboBox->setEnabled(enabled);
+    bookDepthSpinBox->setEnabled(enabled);
+    analysisLinesSpinBox->setEnabled(enabled);
     
     // Find and enable/disable labels
     QList<QLabel*> labels = findChildren<QLabel*>();
     for (QLabel* label : labels) {
-        if (label->text() == "AI plays as:" || label->text() == "Difficulty:") {
+        if (label->text() == "AI plays as:" || label->text() == "Difficulty:" ||
+            label->text() == "Book moves:" || label->text() == "Analysis lines:") {
             label->setEnabled(enabled);
         }
     }
@@ -331,6 +676,166 @@ void MainWindow::onAIColorChanged()
     statusBar()->showMessage(QString("AI will play as %1").arg(colorName), 2000);
 }
 
+void MainWindow::loadNeuralNetwork()
+{
+    QString path = QFileDialog::getOpenFileName(this, "Load Neural Network", QString(),
+                                                "NNUE networks (*.nnue);;All files (*)");
+    if (path.isEmpty()) {
+        return;
+    }
+    
+    if (chessBoard->loadAINetwork(path)) {
+        statusBar()->showMessage(QString("AI now evaluates with %1 (%2)")
+                                 .arg(path, NnueEvaluator::simdName()), 4000);
+    } else {
+        QMessageBox::warning(this, "Load Neural Network",
+                             QString("%1 is not a valid network file.").arg(path));
+    }
+}
+
+void MainWindow::loadTablebases()
+{
+    QString directory = QFileDialog::getExistingDirectory(this, "Load Endgame Tablebases");
+    if (directory.isEmpty()) {
+        return;
+    }
+    
+    int count = chessBoard->loadAITablebases(directory);
+    if (count > 0) {
+        statusBar()->showMessage(QString("AI now uses %1 endgame tablebases").arg(count), 4000);
+    } else {
+        QMessageBox::warning(this, "Load Endgame Tablebases",
+                             QString("No tablebase files (*.cbtb) found in %1.").arg(directory));
+    }
+}
+
+void MainWindow::loadOpeningBook()
+{
+    QString path = QFileDialog::getOpenFileName(this, "Load Opening Book", QString(),
+                                                "Opening books (*.bin);;All files (*)");
+    if (path.isEmpty()) {
+        return;
+    }
+    
+    if (chessBoard->loadAIOpeningBook(path)) {
+        statusBar()->showMessage(QString("AI now plays openings from %1").arg(path), 4000);
+    } else {
+        QMessageBox::warning(this, "Load Opening Book",
+                             QString("%1 is not a valid opening book.").arg(path));
+    }
+}
+
+void MainWindow::onBookDepthChanged(int moves)
+{
+    chessBoard->setAIBookDepth(moves * 2);
+}
+
+void MainWindow::onAnalysisLinesChanged(int lines)
+{
+    chessBoard->setAIAnalysisLines(lines);
+}
+
+void MainWindow::loadGameDatabase()
+{
+    QString path = QFileDialog::getOpenFileName(this, "Open Game Database", QString(),
+                                                "Game databases (*.cbdb);;All files (*)");
+    if (path.isEmpty()) {
+        return;
+    }
+    
+    // A lookup still running keeps its own reference to the old database
+    auto database = std::make_shared<GameDatabase>();
+    if (!database->open(path.toStdString())) {
+        QMessageBox::warning(this, "Open Game Database",
+                             QString("%1 is not a valid game database.").arg(path));
+        return;
+    }
+    gameDatabase = database;
+    explorerCache.clear();
+    explorerGroup->setTitle(QString("Opening Explorer (%1 games)").arg(database->gameCount()));
+    statusBar()->showMessage(QString("Exploring %1").arg(path), 4000);
+    updateExplorer();
+}
+
+// Show the current position's moves, from the cache or by starting a lookup
+void MainWindow::updateExplorer()
+{
+    if (!gameDatabase) {
+        return;
+    }
+    
+    const Position& position = chessBoard->getPosition();
+    auto cached = explorerCache.constFind(position.key());
+    if (cached != explorerCache.constEnd()) {
+        showExplorerMoves(*cached);
+        return;
+    }
+    
+    explorerLabel->setText("Searching...");
+    explorerTree->clear();
+    if (explorerWatcher->isRunning()) {
+        return; // Its finished handler looks at the position reached by then
+    }
+    
+    std::shared_ptr<GameDatabase> database = gameDatabase;
+    Position snapshot = position;
+    explorerPendingDatabase = database;
+    explorerPendingKey = position.key();
+    explorerWatcher->setFuture(QtConcurrent::run([database, snapshot]() {
+        return exploreMoves(*database, snapshot);
+    }));
+}
+
+void MainWindow::onExplorerLookupFinished()
+{
+    // Results for a database that was replaced meanwhile are dropped
+    if (explorerPendingDatabase == gameDatabase) {
+        const int maxCachedPositions = 4096;
+        if (explorerCache.size() >= maxCachedPositions) {
+            explorerCache.clear();
+        }
+        explorerCache.insert(explorerPendingKey, explorerWatcher->result());
+    }
+    explorerPendingDatabase.reset();
+    updateExplorer();
+}
+
+void MainWindow::showExplorerMoves(const std::vector<ExplorerMove>& moves)
+{
+    const Position& position = chessBoard->getPosition();
+    Color mover = position.sideToMove();
+    
+    explorerTree->clear();
+    quint64 games = 0;
+    for (const ExplorerMove& move : moves) {
+        games += move.games;
+        
+        QTreeWidgetItem *item = new QTreeWidgetItem(explorerTree);
+        item->setText(0, move.move != NO_MOVE ? QString::fromStdString(moveToSan(position, move.move)) : "(end)");
+        item->setText(1, QString::number(move.games));
+        int score = move.scorePercent(mover);
+        item->setText(2, score >= 0 ? QString("%1%").arg(score) : "-");
+        item->setText(3, move.averageRating() ? QString::number(move.averageRating()) : "-");
+        for (int column = 1; column < 4; ++column) {
+            item->setTextAlignment(column, Qt::AlignRight);
+        }
+        item->setData(0, Qt::UserRole, uint(move.move));
+    }
+    explorerLabel->setText(games ? QString("%1 games reached this position").arg(games)
+                                 : QString("No games reached this position"));
+}
+
+void MainWindow::onExplorerMoveActivated(QTreeWidgetItem *item, int /*column*/)
+{
+    PackedMove move = PackedMove(item->data(0, Qt::UserRole).toUInt());
+    if (move == NO_MOVE) {
+        return;
+    }
+    if (!chessBoard->makeUserMove(move)) {
+        statusBar()->showMessage("That move can't be played now", 2000);
+    }
+}
+
 // Bluetooth Implementation
 void MainWindow::openBluetoothDialog()
 {
@@ -367,12 +872,23 @@ void MainWindow::onBluetoothMessageReceived(const GameMessage& message)
                 if (reply == QMessageBox::Yes) {
                     chessBoard->resetBoard();
                     moveHistory->clear();
+                    aiLineLabel->clear();
                     moveCount = 1;
                     statusBar()->showMessage("New game started by remote player", 3000);
                 }
             }
             break;
             
+        case GameMessage::GAME_STATE:
+            // The remote side set up a position; data is its FEN
+            if (chessBoard->loadFen(message.data)) {
+                positionLoaded();
+                statusBar()->showMessage("Position received from remote player", 3000);
+            } else {
+                statusBar()->showMessage("Invalid position received from remote player", 3000);
+            }
+            break;
+            
         case GameMessage::DISCONNECT:
             statusBar()->showMessage("Remote player disconnected", 3000);
             isMultiplayerMode = false;
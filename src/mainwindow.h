@@ -14,9 +14,19 @@
 #include <QComboBox>
 #include <QButtonGroup>
 #include <QRadioButton>
+#include <QSpinBox>
+#include <QGroupBox>
+#include <QTreeWidget>
+#include <QProgressDialog>
+#include <QFutureWatcher>
+#include <QHash>
+#include <memory>
+#include <vector>
 #include "chessboard.h"
 #include "bluetoothmanager.h"
 #include "bluetoothdialog.h"
+#include "openingexplorer.h"
+#include "matesearch.h"
 
 class MainWindow : public QMainWindow
 {
@@ -28,15 +38,34 @@ public:
 
 private slots:
     void newGame();
+    void copyPosition();
+    void setUpPosition();
+    void findMate();
+    void onMateSearchFinished();
+    void exportGame();
+    void importGame();
     void onMoveMade(QString moveNotation);
     void onMoveMadeWithCoords(QString moveNotation, int fromRow, int fromCol, int toRow, int toCol);
     void onGameStatusChanged(QString status);
+    void onGameEnded(QString result);
+    void onAIPrincipalVariation(QString line);
     void showAbout();
     
     // AI control slots
     void onAIEnabledChanged(bool enabled);
     void onAIDifficultyChanged(const QString& difficulty);
     void onAIColorChanged();
+    void loadNeuralNetwork();
+    void loadTablebases();
+    void loadOpeningBook();
+    void onBookDepthChanged(int moves);
+    void onAnalysisLinesChanged(int lines);
+    
+    // Opening explorer slots
+    void loadGameDatabase();
+    void updateExplorer();
+    void onExplorerLookupFinished();
+    void onExplorerMoveActivated(QTreeWidgetItem *item, int column);
     
     // Bluetooth slots
     void openBluetoothDialog();
@@ -48,6 +77,8 @@ private:
     void setupUI();
     void createMenus();
     void setupStatusBar();
+    void positionLoaded();
+    void showExplorerMoves(const std::vector<ExplorerMove>& moves);
     
     ChessBoard *chessBoard;
     QTextEdit *moveHistory;
@@ -58,9 +89,31 @@ private:
     // AI controls
     QCheckBox *aiEnabledCheckBox;
     QComboBox *aiDifficultyComboBox;
+    QSpinBox *bookDepthSpinBox;
+    QSpinBox *analysisLinesSpinBox;
     QRadioButton *aiWhiteRadio;
     QRadioButton *aiBlackRadio;
     QButtonGroup *aiColorGroup;
+    QLabel *aiLineLabel;
+    
+    // Opening explorer: lookups run on the thread pool, one at a time, and
+    // their results are cached by position key
+    QGroupBox *explorerGroup;
+    QLabel *explorerLabel;
+    QTreeWidget *explorerTree;
+    std::shared_ptr<GameDatabase> gameDatabase;
+    std::shared_ptr<GameDatabase> explorerPendingDatabase;
+    quint64 explorerPendingKey;
+    QFutureWatcher<std::vector<ExplorerMove>> *explorerWatcher;
+    QHash<quint64, std::vector<ExplorerMove>> explorerCache;
+    
+    // Find Mate: one search at a time on the thread pool, cancelled from
+    // its progress dialog
+    std::shared_ptr<MateSearch> mateSearch;
+    QFutureWatcher<MateResult> *mateWatcher;
+    QProgressDialog *mateProgress;
+    quint64 mateKey;
+    int mateMaxMoves;
     
     // Bluetooth components
     BluetoothManager *bluetoothManager;
@@ -0,0 +1,298 @@
+#include "match.h"
+#include "mcts.h"
+#include "movegen.h"
+#include "pgn.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+// Seconds between progress lines
+static const int ProgressInterval = 10;
+
+// Expected score of a player elo points stronger
+static double eloToScore(double elo)
+{
+    return 1.0 / (1.0 + std::pow(10.0, -elo / 400.0));
+}
+
+static double scoreToElo(double score)
+{
+    score = std::min(std::max(score, 1e-6), 1 - 1e-6);
+    return -400.0 * std::log10(1.0 / score - 1.0);
+}
+
+// Mean and variance of a pair's score, in points per game. Every outcome
+// gets half a pseudo pair so one-sided results still have a variance.
+static void pairStatistics(const MatchResult& r, double& mean, double& variance)
+{
+    const double prior = 0.5;
+    double n = r.pairCount() + 5 * prior;
+    mean = variance = 0;
+    for (int i = 0; i < 5; ++i)
+        mean += (r.pairs[i] + prior) * (i / 4.0);
+    mean /= n;
+    for (int i = 0; i < 5; ++i)
+        variance += (r.pairs[i] + prior) * (i / 4.0 - mean) * (i / 4.0 - mean);
+    variance /= n;
+}
+
+double MatchResult::score() const
+{
+    return games() ? (wins + 0.5 * draws) / games() : 0.5;
+}
+
+double MatchResult::elo() const
+{
+    return scoreToElo(score());
+}
+
+double MatchResult::eloError() const
+{
+    double mean, variance;
+    pairStatistics(*this, mean, variance);
+    if (pairCount() < 2)
+        return 0;
+    double margin = 1.96 * std::sqrt(variance / pairCount());
+    return (scoreToElo(mean + margin) - scoreToElo(mean - margin)) / 2;
+}
+
+double MatchResult::llr(double elo0, double elo1) const
+{
+    // Normal approximation of the generalized SPRT over pair scores
+    if (pairCount() == 0)
+        return 0;
+    double mean, variance;
+    pairStatistics(*this, mean, variance);
+    double s0 = eloToScore(elo0), s1 = eloToScore(elo1);
+    return pairCount() * (s1 - s0) * (2 * mean - s0 - s1) / (2 * variance);
+}
+
+MatchRunner::MatchRunner(int threads)
+    : threadCount(threads > 0 ? threads : std::max(1, int(std::thread::hardware_concurrency()))),
+      maxGames(1000), maxPlies(400), sprt(false), elo0(0), elo1(0), lowerBound(0), upperBound(0)
+{
+}
+
+void MatchRunner::setSprt(double h0, double h1, double alpha, double beta)
+{
+    sprt = true;
+    elo0 = h0;
+    elo1 = h1;
+    lowerBound = std::log(beta / (1 - alpha));
+    upperBound = std::log((1 - beta) / alpha);
+}
+
+int MatchRunner::loadOpenings(const std::string& path)
+{
+    std::ifstream in(path);
+    if (!in)
+        return 0;
+    openings.clear();
+    std::string line;
+    Position pos;
+    while (std::getline(in, line)) {
+        // EPD has operations after the first four fields, FEN has two counters
+        std::istringstream fields(line);
+        std::string field, fen;
+        for (int i = 0; i < 6 && fields >> field; ++i) {
+            if (i >= 4 && field.find_first_not_of("0123456789") != std::string::npos)
+                break;
+            fen += (i ? " " : "") + field;
+        }
+        if (!fen.empty() && pos.setFen(fen))
+            openings.push_back(fen);
+    }
+    return int(openings.size());
+}
+
+// One side of a game: the alpha-beta engine, or the tree search with the
+// hash size as its arena
+struct Player {
+    ChessAI alphaBeta;
+    MctsEngine mcts;
+    const EngineConfig* config;
+
+    void configure(const EngineConfig& engine)
+    {
+        config = &engine;
+        alphaBeta.setHashSize(engine.mctsThreads ? 0 : engine.hashKilobytes);
+        alphaBeta.setNetwork(engine.network);
+        alphaBeta.setUseNetwork(engine.network != nullptr);
+        alphaBeta.setTablebases(engine.tablebases);
+        if (engine.mctsThreads) {
+            mcts.setThreads(engine.mctsThreads);
+            mcts.setTreeSize(engine.hashKilobytes);
+            mcts.setNetwork(engine.network);
+        }
+    }
+
+    PackedMove think(const Position& pos)
+    {
+        if (config->mctsThreads)
+            return mcts.search(pos, config->limits).bestMove;
+        return alphaBeta.search(pos, config->limits).bestMove;
+    }
+};
+
+// Play one game to its end; returns the PGN result, or "*" if stopped
+static std::string playGame(Player* players[2], const Position& start, int maxPlies,
+                            std::vector<PackedMove>& moves, std::string& termination,
+                            const std::atomic<bool>& stop)
+{
+    Position pos = start;
+    moves.clear();
+    players[0]->alphaBeta.clearHash();
+    players[1]->alphaBeta.clearHash();
+    for (;;) {
+        switch (gameStatus(pos)) {
+        case GAME_CHECKMATE:
+            termination = "normal";
+            return pos.sideToMove() == WHITE ? "0-1" : "1-0";
+        case GAME_ONGOING:
+            break;
+        default:
+            termination = "normal";
+            return "1/2-1/2";
+        }
+        if (int(moves.size()) >= maxPlies) {
+            termination = "adjudication";
+            return "1/2-1/2";
+        }
+        if (stop)
+            return "*";
+
+        int side = pos.sideToMove() == WHITE ? 0 : 1;
+        PackedMove move = players[side]->think(pos);
+        pos.makeMove(move);
+        moves.push_back(move);
+    }
+}
+
+std::string MatchRunner::summary(const MatchResult& r) const
+{
+    char text[200];
+    int length = std::snprintf(text, sizeof(text), "%u games: +%u -%u =%u, Elo %+.1f +/- %.1f",
+                               r.games(), r.wins, r.losses, r.draws, r.elo(), r.eloError());
+    if (sprt)
+        std::snprintf(text + length, sizeof(text) - size_t(length), ", LLR %.2f (%.2f, %.2f)",
+                      r.llr(elo0, elo1), lowerBound, upperBound);
+    return text;
+}
+
+MatchResult MatchRunner::run(const EngineConfig& a, const EngineConfig& b)
+{
+    MatchResult result;
+    verdict.clear();
+    if (openings.empty()) {
+        message("No openings loaded; a match needs one per game pair");
+        return result;
+    }
+
+    std::ofstream pgn;
+    if (!pgnPath.empty()) {
+        pgn.open(pgnPath, std::ios::binary);
+        if (!pgn)
+            message(pgnPath + ": could not be written");
+    }
+
+    // Each opening is played once: a repeated pair would count twice in the
+    // error bars and the SPRT without adding information
+    int pairCount = (std::max(maxGames, 1) + 1) / 2;
+    if (size_t(pairCount) > openings.size()) {
+        pairCount = int(openings.size());
+        message("Only " + std::to_string(pairCount) + " openings; playing " + std::to_string(2 * pairCount) + " games");
+    }
+    std::atomic<int> nextPair(0);
+    std::atomic<bool> stop(false);
+    std::mutex lock;
+    auto startTime = std::chrono::steady_clock::now();
+    auto lastReport = startTime;
+
+    auto worker = [&]() {
+        Player first, second;
+        first.configure(a);
+        second.configure(b);
+        Position start;
+        std::vector<PackedMove> moves[2];
+        std::string results[2], terminations[2];
+        int pair;
+        while (!stop && (pair = nextPair.fetch_add(1)) < pairCount) {
+            const std::string& fen = openings[size_t(pair)];
+            start.setFen(fen);
+
+            // a plays white in the first game of the pair, black in the second
+            for (int game = 0; game < 2; ++game) {
+                Player* players[2] = {game ? &second : &first, game ? &first : &second};
+                results[game] = playGame(players, start, maxPlies, moves[game], terminations[game], stop);
+            }
+            if (results[1] == "*")
+                continue;
+
+            std::lock_guard<std::mutex> guard(lock);
+            if (stop)
+                continue;
+            int points = 0; // Half points of a over the pair
+            for (int game = 0; game < 2; ++game) {
+                const std::string& r = results[game];
+                bool aWhite = game == 0;
+                if (r == "1/2-1/2") {
+                    result.draws++;
+                    points += 1;
+                } else if ((r == "1-0") == aWhite) {
+                    result.wins++;
+                    points += 2;
+                } else {
+                    result.losses++;
+                }
+
+                if (pgn.is_open()) {
+                    std::vector<std::pair<std::string, std::string>> tags = {
+                        {"Event", "chesstool match"},
+                        {"Round", std::to_string(2 * pair + game + 1)},
+                        {"White", aWhite ? a.name : b.name},
+                        {"Black", aWhite ? b.name : a.name},
+                        {"Termination", terminations[game]},
+                    };
+                    writePgnGame(pgn, tags, start, moves[game], r);
+                }
+            }
+            result.pairs[points]++;
+
+            if (sprt) {
+                double llr = result.llr(elo0, elo1);
+                if (llr >= upperBound)
+                    verdict = "H1 accepted";
+                else if (llr <= lowerBound)
+                    verdict = "H0 accepted";
+                if (!verdict.empty())
+                    stop = true;
+            }
+            auto now = std::chrono::steady_clock::now();
+            if (now - lastReport >= std::chrono::seconds(ProgressInterval)) {
+                message(summary(result));
+                lastReport = now;
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (int i = 1; i < threadCount; ++i)
+        workers.emplace_back(worker);
+    worker();
+    for (std::thread& t : workers)
+        t.join();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    char timing[64];
+    std::snprintf(timing, sizeof(timing), " (%.1fs)", seconds);
+    message(a.name + " vs " + b.name + ": " + summary(result) + timing);
+    if (!verdict.empty())
+        message("SPRT: " + verdict);
+    return result;
+}
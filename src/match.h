@@ -0,0 +1,95 @@
+#ifndef MATCH_H
+#define MATCH_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "chessai.h"
+
+// One player of a match: search budget and optional evaluation data
+struct EngineConfig {
+    std::string name;
+    SearchLimits limits;
+    size_t hashKilobytes;
+    std::shared_ptr<const NnueNetwork> network;    // Hand-written evaluation if null
+    std::shared_ptr<const Tablebases> tablebases;
+    int mctsThreads; // Monte Carlo tree search on this many threads, 0 for alpha-beta
+
+    EngineConfig() : hashKilobytes(16384), mctsThreads(0) {}
+};
+
+// Outcome of a match from the first engine's point of view. Games are
+// played in pairs from the same opening with colors swapped, and pairs
+// count by their total score (0, 1/2, 1, 3/2 or 2 points), which takes out
+// most of the noise the openings bring in.
+struct MatchResult {
+    uint32_t wins;
+    uint32_t draws;
+    uint32_t losses;
+    uint32_t pairs[5]; // Pairs by points scored, in half points
+
+    MatchResult() : wins(0), draws(0), losses(0), pairs() {}
+
+    uint32_t games() const { return wins + draws + losses; }
+    uint32_t pairCount() const { return pairs[0] + pairs[1] + pairs[2] + pairs[3] + pairs[4]; }
+    // Points per game, 0 to 1
+    double score() const;
+    // Elo difference and the half width of its 95% confidence interval
+    double elo() const;
+    double eloError() const;
+    // Log-likelihood ratio of elo1 against elo0 (sequential probability ratio test)
+    double llr(double elo0, double elo1) const;
+};
+
+// Plays two engine configurations against each other, one game pair per
+// thread. Each thread owns both engines of its pair, so no search state is
+// shared. Openings are used in file order, each for one pair and never
+// again, since engines with a node budget would only replay the pair; the
+// match ends when they run out. With a
+// sequential probability ratio test set, the match stops as soon as the
+// log-likelihood ratio leaves the bounds given by alpha and beta; games
+// still running are then thrown away.
+class MatchRunner {
+public:
+    explicit MatchRunner(int threads = 0); // 0 = all cores
+
+    void setLogger(std::function<void(const std::string&)> logger) { log = logger; }
+    // Most games played (default 1000, rounded up to whole pairs, and at
+    // most two per opening)
+    void setGames(int count) { maxGames = count; }
+    // Games still running after this many plies are drawn (default 400)
+    void setMaxPlies(int plies) { maxPlies = plies; }
+    // Test H1 "elo1 or better" against H0 "elo0 or worse"
+    void setSprt(double elo0, double elo1, double alpha = 0.05, double beta = 0.05);
+    // Write every finished game here, in the order they finish
+    void setPgnOutput(const std::string& path) { pgnPath = path; }
+
+    // Start positions from an EPD or FEN file, one per line; returns how
+    // many were read. run() needs at least one.
+    int loadOpenings(const std::string& path);
+
+    // Play the match; the result is from a's point of view
+    MatchResult run(const EngineConfig& a, const EngineConfig& b);
+
+    // "H1 accepted", "H0 accepted" or "" after run()
+    const std::string& sprtVerdict() const { return verdict; }
+
+private:
+    int threadCount;
+    int maxGames;
+    int maxPlies;
+    bool sprt;
+    double elo0, elo1;
+    double lowerBound, upperBound;
+    std::vector<std::string> openings;
+    std::string pgnPath;
+    std::string verdict;
+    std::function<void(const std::string&)> log;
+
+    void message(const std::string& text) const { if (log) log(text); }
+    std::string summary(const MatchResult& result) const;
+};
+
+#endif // MATCH_H
@@ -0,0 +1,177 @@
+#include "matesearch.h"
+#include "movegen.h"
+#include <algorithm>
+#include <chrono>
+
+// Table entries: TT_LOWER proves a mate within depth moves, TT_UPPER
+// refutes every mate within depth moves. The move is the mating move of a
+// proof, or the defense that refuted it.
+
+MateSearch::MateSearch(size_t hashKilobytes)
+    : tt(hashKilobytes), checksOnly(false), nodeLimit(0), nodes(0), stopped(false),
+      limited(true), cancelled(false)
+{
+}
+
+MateResult MateSearch::find(const Position& position, int maxMoves)
+{
+    auto start = std::chrono::steady_clock::now();
+    MateResult result;
+    Position pos = position;
+    tt.clear();
+    nodes = 0;
+    stopped = false;
+
+    for (int n = 1; n <= maxMoves; ++n) {
+        if (attack(pos, n, nullptr)) {
+            result.moves = n;
+            break;
+        }
+        if (stopped)
+            break;
+        result.ruledOut = n;
+    }
+
+    // Walk the proof: the attacker plays a shortest mate, the defender the
+    // reply that delays it longest. The table holds most of it already.
+    if (result.moves) {
+        limited = false;
+        for (int left = result.moves; left > 0; --left) {
+            PackedMove move = NO_MOVE;
+            attack(pos, left, &move);
+            pos.makeMove(move);
+            result.line.push_back(move);
+
+            MoveList replies;
+            generateLegalMoves(pos, replies);
+            if (replies.empty())
+                break;
+            PackedMove longest = replies[0];
+            int longestDistance = 0;
+            for (PackedMove reply : replies) {
+                pos.makeMove(reply);
+                int d = distance(pos, left - 1);
+                pos.unmakeMove(reply);
+                if (d > longestDistance) {
+                    longestDistance = d;
+                    longest = reply;
+                }
+            }
+            pos.makeMove(longest);
+            result.line.push_back(longest);
+        }
+        limited = true;
+    }
+
+    result.nodes = nodes;
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+int MateSearch::distance(Position& pos, int moves)
+{
+    for (int n = 1; n <= moves; ++n) {
+        if (attack(pos, n, nullptr))
+            return n;
+    }
+    return 0;
+}
+
+bool MateSearch::attack(Position& pos, int moves, PackedMove* best)
+{
+    ++nodes;
+    if (limited && ((nodeLimit && nodes >= nodeLimit) || cancelled.load(std::memory_order_relaxed)))
+        stopped = true;
+    if (stopped)
+        return false;
+
+    TtEntry entry;
+    PackedMove ttMove = NO_MOVE;
+    if (tt.probe(pos.key(), entry)) {
+        if (entry.bound == TT_LOWER && entry.depth <= moves) {
+            if (best)
+                *best = entry.move;
+            return true;
+        }
+        if (entry.bound == TT_UPPER && entry.depth >= moves)
+            return false;
+        ttMove = entry.move;
+    }
+    if (pos.halfmoveClock() >= 100)
+        return false; // The defender can claim the draw
+
+    // Checks first, since they leave the defender the fewest replies; the
+    // mating move itself is always a check
+    MoveList legal, checks, quiet;
+    generateLegalMoves(pos, legal);
+    for (PackedMove move : legal) {
+        pos.makeMove(move);
+        bool check = pos.inCheck();
+        pos.unmakeMove(move);
+        if (check)
+            checks.add(move);
+        else if (moves > 1 && !checksOnly)
+            quiet.add(move);
+    }
+    PackedMove* ttAt = std::find(checks.begin(), checks.end(), ttMove);
+    if (ttAt != checks.end())
+        std::rotate(checks.begin(), ttAt, ttAt + 1);
+
+    for (MoveList* list : {&checks, &quiet}) {
+        for (PackedMove move : *list) {
+            pos.makeMove(move);
+            bool mates = defend(pos, moves - 1);
+            pos.unmakeMove(move);
+            if (stopped)
+                return false;
+            if (mates) {
+                tt.store(pos.key(), 1, move, moves, TT_LOWER);
+                if (best)
+                    *best = move;
+                return true;
+            }
+        }
+    }
+    tt.store(pos.key(), 0, NO_MOVE, moves, TT_UPPER);
+    return false;
+}
+
+bool MateSearch::defend(Position& pos, int moves)
+{
+    ++nodes;
+    MoveList replies;
+    generateLegalMoves(pos, replies);
+    if (replies.empty())
+        return pos.inCheck();
+    if (moves == 0 || pos.halfmoveClock() >= 100)
+        return false;
+
+    TtEntry entry;
+    PackedMove ttMove = NO_MOVE;
+    if (tt.probe(pos.key(), entry)) {
+        if (entry.bound == TT_LOWER && entry.depth <= moves)
+            return true;
+        if (entry.bound == TT_UPPER && entry.depth >= moves)
+            return false;
+        ttMove = entry.move;
+    }
+
+    // The defense that refuted a shorter mate is the likeliest again
+    PackedMove* ttAt = std::find(replies.begin(), replies.end(), ttMove);
+    if (ttAt != replies.end())
+        std::rotate(replies.begin(), ttAt, ttAt + 1);
+
+    for (PackedMove reply : replies) {
+        pos.makeMove(reply);
+        bool mated = attack(pos, moves, nullptr);
+        pos.unmakeMove(reply);
+        if (stopped)
+            return false;
+        if (!mated) {
+            tt.store(pos.key(), 0, reply, moves, TT_UPPER);
+            return false;
+        }
+    }
+    tt.store(pos.key(), 1, NO_MOVE, moves, TT_LOWER);
+    return true;
+}
@@ -0,0 +1,65 @@
+#ifndef MATESEARCH_H
+#define MATESEARCH_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "position.h"
+#include "transposition.h"
+
+struct MateResult {
+    int moves;                    // Shortest forced mate, in moves of the side to move; 0 if none found
+    std::vector<PackedMove> line; // That mate against the longest defense, ending in checkmate
+    int ruledOut;                 // No mate in this many moves or fewer
+    uint64_t nodes;
+    double seconds;
+
+    MateResult() : moves(0), ruledOut(0), nodes(0), seconds(0) {}
+};
+
+// Finds forced mates for the side to move and proves them shortest.
+//
+// A yes/no alpha-beta over mate distance, deepened one attacking move at a
+// time. The defender tries every legal move. The attacker's last move, the
+// one that mates, must give check; with checksOnly every attacking move
+// must. Checks are tried first. There are no evaluations, so each node is
+// just move generation. Proofs and
+// refutations go to a transposition table with the distance they were
+// searched to: a mate in n also holds for any greater distance, and a
+// refutation for any smaller one.
+class MateSearch {
+public:
+    explicit MateSearch(size_t hashKilobytes = 16384);
+
+    // Only checking moves for the attacker: far faster, but quiet moves
+    // are missed, so mates found need not be the shortest
+    void setChecksOnly(bool enabled) { checksOnly = enabled; }
+    // Give up after this many nodes (default 0, no limit)
+    void setNodeLimit(uint64_t nodes) { nodeLimit = nodes; }
+    void setHashSize(size_t kilobytes) { tt.resize(kilobytes); }
+    // Makes a running find() return soon, as if its node limit was hit;
+    // safe from any thread, and later searches stop at once too
+    void cancel() { cancelled = true; }
+
+    // Shortest mate in at most maxMoves moves
+    MateResult find(const Position& position, int maxMoves);
+
+private:
+    TranspositionTable tt;
+    bool checksOnly;
+    uint64_t nodeLimit;
+    uint64_t nodes;
+    bool stopped;
+    bool limited; // Off while walking a proven mate, which must finish
+    std::atomic<bool> cancelled;
+
+    // Whether the side to move mates in at most moves moves; best gets the move
+    bool attack(Position& pos, int moves, PackedMove* best);
+    // Whether the side to move is mated with the attacker having moves moves left
+    bool defend(Position& pos, int moves);
+    // Shortest mate of at most moves moves for the side to move, 0 if none
+    int distance(Position& pos, int moves);
+};
+
+#endif // MATESEARCH_H
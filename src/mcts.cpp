@@ -0,0 +1,342 @@
+#include "mcts.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+enum NodeState : uint8_t {
+    NODE_UNEXPANDED,
+    NODE_EXPANDING,
+    NODE_EXPANDED
+};
+
+// Values are kept as fixed point in [-1, 1]
+static const double VALUE_SCALE = 1 << 16;
+// Exploration weight of PUCT
+static const double CPUCT = 1.5;
+// Unvisited children start at the parent's value less this
+static const double FPU_REDUCTION = 0.25;
+// Centipawns per e-fold of prior between two moves
+static const double PRIOR_TEMPERATURE = 80.0;
+// Capture plies of the quiescence search at leaves
+static const int QUIESCENCE_DEPTH = 4;
+// Moves this far below the best of a node get next to no prior, so their
+// values only need to be known that far
+static const int PRIOR_WINDOW = 400;
+// Most a capture may gain beyond the piece it takes, for delta pruning
+static const int DELTA_MARGIN = 200;
+// Playouts between clock checks of each thread
+static const uint64_t CLOCK_INTERVAL = 16;
+// Default arena
+static const size_t DEFAULT_TREE_KILOBYTES = 65536;
+
+static const int INFINITE_SCORE = ChessAI::MATE_SCORE + 1;
+static const int PieceOrderValue[6] = {100, 320, 330, 500, 900, 0};
+
+// Expected score as a value: 0 for equal, +-1 for certain results
+static double scoreToValue(int centipawns)
+{
+    return 2.0 / (1.0 + std::pow(10.0, -centipawns / 400.0)) - 1.0;
+}
+
+static int valueToScore(double value)
+{
+    value = std::max(-0.999, std::min(0.999, value));
+    return int(std::lround(400.0 * std::log10((1 + value) / (1 - value))));
+}
+
+// Captures and promotions only, from the side to move's point of view
+static int quiesce(Position& pos, ChessAI& evaluator, int alpha, int beta, int depth)
+{
+    int standPat = evaluator.staticEvaluation(pos);
+    if (pos.sideToMove() == BLACK) standPat = -standPat;
+    if (standPat >= beta || depth == 0) return standPat;
+    alpha = std::max(alpha, standPat);
+
+    MoveList captures;
+    generateLegalCaptures(pos, captures);
+    auto victimValue = [&pos](PackedMove m) {
+        if (isPromotionMove(m)) return PieceOrderValue[QUEEN];
+        return moveFlags(m) == EP_CAPTURE ? PieceOrderValue[PAWN] : PieceOrderValue[typeOf(pos.pieceOn(moveTo(m)))];
+    };
+    std::sort(captures.begin(), captures.end(),
+              [&victimValue](PackedMove a, PackedMove b) { return victimValue(a) > victimValue(b); });
+
+    for (PackedMove move : captures) {
+        // Delta pruning: a capture that can't lift the score to alpha isn't tried
+        if (standPat + victimValue(move) + DELTA_MARGIN <= alpha) break;
+        pos.makeMove(move);
+        int score = -quiesce(pos, evaluator, -beta, -alpha, depth - 1);
+        pos.unmakeMove(move);
+        if (score >= beta) return score;
+        alpha = std::max(alpha, score);
+    }
+    return alpha;
+}
+
+MctsEngine::MctsEngine(ChessAI::Difficulty difficulty)
+    : currentDifficulty(difficulty), threadCount(1), capacity(0), used(0)
+{
+    setTreeSize(DEFAULT_TREE_KILOBYTES);
+}
+
+MctsEngine::~MctsEngine()
+{
+}
+
+void MctsEngine::setTreeSize(size_t kilobytes)
+{
+    capacity = std::max<size_t>(kilobytes * 1024 / sizeof(Node), 1024);
+    arena.reset(new Node[capacity]);
+}
+
+void MctsEngine::setNetwork(std::shared_ptr<const NnueNetwork> network)
+{
+    nnue = network;
+    for (auto& evaluator : evaluators) {
+        evaluator->setNetwork(nnue);
+        evaluator->setUseNetwork(nnue != nullptr);
+    }
+}
+
+Move MctsEngine::getBestMove(const Position& position)
+{
+    SearchResult result = search(position, SearchLimits());
+    if (result.bestMove == NO_MOVE) {
+        return Move();
+    }
+    Move bestMove = ChessAI::toMove(position, result.bestMove);
+    bestMove.score = result.score;
+    return bestMove;
+}
+
+SearchResult MctsEngine::search(const Position& position, const SearchLimits& limits)
+{
+    auto startTime = std::chrono::steady_clock::now();
+    stats = SearchStats();
+    principalVariation.clear();
+    SearchResult result;
+    bool white = position.sideToMove() == WHITE;
+
+    static const uint64_t DifficultyPlayouts[] = {1000, 3000, 8000, 20000};
+    uint64_t playoutLimit = limits.nodes;
+    if (!limits.nodes && !limits.milliseconds) {
+        playoutLimit = DifficultyPlayouts[std::max(0, std::min(3, int(currentDifficulty) - ChessAI::EASY))];
+    }
+
+    while (int(evaluators.size()) < threadCount) {
+        std::unique_ptr<ChessAI> evaluator(new ChessAI());
+        evaluator->setHashSize(0); // Only its evaluation is used
+        evaluator->setNetwork(nnue);
+        evaluator->setUseNetwork(nnue != nullptr);
+        evaluators.push_back(std::move(evaluator));
+    }
+
+    // The root is expanded before the threads start, so there is always a move
+    Node& root = arena[0];
+    root.visits.store(0, std::memory_order_relaxed);
+    root.valueSum.store(0, std::memory_order_relaxed);
+    root.state.store(NODE_UNEXPANDED, std::memory_order_relaxed);
+    root.childCount = 0;
+    root.move = NO_MOVE;
+    root.prior = 1;
+    used = 1;
+    Position pos = position;
+    int rootScore;
+    if (!expand(root, pos, *evaluators[0], rootScore) || root.childCount == 0) {
+        if (pos.inCheck()) result.score = white ? -ChessAI::MATE_SCORE : ChessAI::MATE_SCORE;
+        stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        return result;
+    }
+
+    std::atomic<uint64_t> started(0), finished(0);
+    std::atomic<bool> stop(false);
+    auto worker = [&](int index) {
+        ChessAI& evaluator = *evaluators[size_t(index)];
+        Position local = position;
+        while (!stop) {
+            uint64_t n = started.fetch_add(1);
+            if (playoutLimit && n >= playoutLimit) {
+                stop = true;
+                break;
+            }
+            playout(local, evaluator);
+            finished++;
+            if (limits.milliseconds && n % CLOCK_INTERVAL == 0 &&
+                std::chrono::steady_clock::now() - startTime >= std::chrono::milliseconds(limits.milliseconds)) {
+                stop = true;
+            }
+        }
+    };
+    std::vector<std::thread> helpers;
+    for (int i = 1; i < threadCount; ++i)
+        helpers.emplace_back(worker, i);
+    worker(0);
+    for (std::thread& t : helpers)
+        t.join();
+
+    // The most visited move is played; the line follows the most visited
+    // child down as far as the tree is expanded
+    const Node* node = &root;
+    const Node* best = nullptr;
+    while (node->state.load(std::memory_order_acquire) == NODE_EXPANDED && node->childCount > 0 &&
+           principalVariation.size() < size_t(ChessAI::MAX_PLY)) {
+        const Node* next = &arena[node->firstChild];
+        for (int i = 1; i < node->childCount; ++i) {
+            const Node& child = arena[node->firstChild + uint32_t(i)];
+            if (child.visits.load(std::memory_order_relaxed) > next->visits.load(std::memory_order_relaxed))
+                next = &child;
+        }
+        if (next->visits.load(std::memory_order_relaxed) == 0)
+            break;
+        if (!best)
+            best = next;
+        principalVariation.push_back(next->move);
+        node = next;
+    }
+    if (!best)
+        best = &arena[root.firstChild]; // Out of time before the first playout
+    int32_t visits = best->visits.load(std::memory_order_relaxed);
+    int score = visits ? valueToScore(best->valueSum.load(std::memory_order_relaxed) / (VALUE_SCALE * visits))
+                       : rootScore;
+    if (principalVariation.empty())
+        principalVariation.push_back(best->move);
+    // Values can't tell a mate from a won position; a mate on the board is reported as one
+    Position after = position;
+    after.makeMove(best->move);
+    MoveList replies;
+    generateLegalMoves(after, replies);
+    if (replies.empty() && after.inCheck())
+        score = ChessAI::MATE_SCORE - 1;
+
+    result.bestMove = best->move;
+    result.score = white ? score : -score;
+    result.depth = int(principalVariation.size());
+    result.nodes = finished;
+    result.pv = principalVariation;
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    result.lines.push_back({result.score, principalVariation});
+    stats.nodes = finished;
+    stats.depth = result.depth;
+    stats.seconds = result.seconds;
+    return result;
+}
+
+void MctsEngine::playout(Position& pos, ChessAI& evaluator)
+{
+    // Descend, with a virtual loss on every node taken so other threads
+    // spread out; the root only counts the visit
+    Node* path[ChessAI::MAX_PLY];
+    int length = 0;
+    Node* node = &arena[0];
+    node->visits.fetch_add(1, std::memory_order_relaxed);
+    path[length++] = node;
+    while (node->state.load(std::memory_order_acquire) == NODE_EXPANDED && node->childCount > 0 &&
+           length < ChessAI::MAX_PLY) {
+        node = &select(*node);
+        node->visits.fetch_add(1, std::memory_order_relaxed);
+        node->valueSum.fetch_sub(int64_t(VALUE_SCALE), std::memory_order_relaxed);
+        pos.makeMove(node->move);
+        path[length++] = node;
+    }
+
+    // Value of the leaf for its side to move
+    double value;
+    int score;
+    if (length > 1 && (pos.isRepetition() || pos.hasInsufficientMaterial() ||
+                       (pos.halfmoveClock() >= 100 && !pos.inCheck()))) {
+        value = 0;
+    } else if (expand(*node, pos, evaluator, score)) {
+        value = node->childCount ? scoreToValue(score) : (pos.inCheck() ? -1 : 0);
+    } else if (node->state.load(std::memory_order_acquire) == NODE_EXPANDED && node->childCount == 0) {
+        value = pos.inCheck() ? -1 : 0; // Mate or stalemate found before
+    } else {
+        value = scoreToValue(quiesce(pos, evaluator, -INFINITE_SCORE, INFINITE_SCORE, QUIESCENCE_DEPTH));
+    }
+
+    // Back up: each node holds the value for the side that moved into it.
+    // The virtual loss comes off as the real value goes on.
+    for (int i = length - 1; i >= 0; --i) {
+        value = -value;
+        double added = i > 0 ? value + 1 : value;
+        path[i]->valueSum.fetch_add(int64_t(std::lround(added * VALUE_SCALE)), std::memory_order_relaxed);
+        if (i > 0)
+            pos.unmakeMove(path[i]->move);
+    }
+}
+
+bool MctsEngine::expand(Node& node, Position& pos, ChessAI& evaluator, int& score)
+{
+    uint8_t expected = NODE_UNEXPANDED;
+    if (!node.state.compare_exchange_strong(expected, NODE_EXPANDING, std::memory_order_acquire))
+        return false;
+
+    MoveList moves;
+    generateLegalMoves(pos, moves);
+    if (moves.empty()) {
+        node.childCount = 0;
+        node.state.store(NODE_EXPANDED, std::memory_order_release);
+        score = pos.inCheck() ? -ChessAI::MATE_SCORE : ChessAI::DRAW_SCORE;
+        return true;
+    }
+    size_t first = used.fetch_add(size_t(moves.size()), std::memory_order_relaxed);
+    if (first + size_t(moves.size()) > capacity) {
+        node.state.store(NODE_UNEXPANDED, std::memory_order_release);
+        return false;
+    }
+
+    // Priors: a softmax over the quiescence value after each move. The best
+    // of those values is the node's own value, so it needs no other search.
+    int scores[256];
+    score = -INFINITE_SCORE;
+    for (int i = 0; i < moves.size(); ++i) {
+        int alpha = std::max(score - PRIOR_WINDOW, -INFINITE_SCORE);
+        pos.makeMove(moves[i]);
+        scores[i] = -quiesce(pos, evaluator, -INFINITE_SCORE, -alpha, QUIESCENCE_DEPTH);
+        pos.unmakeMove(moves[i]);
+        score = std::max(score, scores[i]);
+    }
+    double weights[256];
+    double sum = 0;
+    for (int i = 0; i < moves.size(); ++i) {
+        weights[i] = std::exp((scores[i] - score) / PRIOR_TEMPERATURE);
+        sum += weights[i];
+    }
+    for (int i = 0; i < moves.size(); ++i) {
+        Node& child = arena[first + size_t(i)];
+        child.visits.store(0, std::memory_order_relaxed);
+        child.valueSum.store(0, std::memory_order_relaxed);
+        child.state.store(NODE_UNEXPANDED, std::memory_order_relaxed);
+        child.childCount = 0;
+        child.firstChild = 0;
+        child.move = moves[i];
+        child.prior = float(weights[i] / sum);
+    }
+    node.firstChild = uint32_t(first);
+    node.childCount = uint16_t(moves.size());
+    node.state.store(NODE_EXPANDED, std::memory_order_release);
+    return true;
+}
+
+MctsEngine::Node& MctsEngine::select(Node& node)
+{
+    int32_t parentVisits = node.visits.load(std::memory_order_relaxed);
+    double explore = CPUCT * std::sqrt(double(std::max(parentVisits, 1)));
+    // The parent's value is for the other side; unvisited children start below it
+    double parentValue = parentVisits ? -node.valueSum.load(std::memory_order_relaxed) / (VALUE_SCALE * parentVisits) : 0;
+    double firstPlay = parentValue - FPU_REDUCTION;
+
+    Node* best = &arena[node.firstChild];
+    double bestUrgency = -1e9;
+    for (int i = 0; i < node.childCount; ++i) {
+        Node& child = arena[node.firstChild + uint32_t(i)];
+        int32_t visits = child.visits.load(std::memory_order_relaxed);
+        double q = visits ? child.valueSum.load(std::memory_order_relaxed) / (VALUE_SCALE * visits) : firstPlay;
+        double urgency = q + explore * child.prior / (1 + visits);
+        if (urgency > bestUrgency) {
+            bestUrgency = urgency;
+            best = &child;
+        }
+    }
+    return *best;
+}
@@ -0,0 +1,79 @@
+#ifndef MCTS_H
+#define MCTS_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "chessai.h"
+
+// Monte Carlo tree search with PUCT selection, as an alternative to the
+// alpha-beta search of ChessAI with the same getBestMove()/search() calls.
+//
+// The tree lives in one arena allocated up front; the children of a node
+// are a contiguous block of it, taken with one atomic add when the node is
+// expanded. Visit counts and value sums are atomics, so every thread
+// descends the same tree without locks, and a thread in flight adds a
+// virtual loss to each node of its path to steer the others elsewhere.
+// Leaves are valued by a short capture-only quiescence search over the
+// evaluation of ChessAI (hand-written or network), and the priors of a new
+// node's moves come from the quiescence value after each move.
+class MctsEngine {
+public:
+    MctsEngine(ChessAI::Difficulty difficulty = ChessAI::MEDIUM);
+    ~MctsEngine();
+
+    // Best move after the difficulty's playouts (EASY 1000 ... EXPERT 20000),
+    // like ChessAI::getBestMove(); the score is from white's point of view
+    Move getBestMove(const Position& position);
+
+    // Playouts until a limit is reached: nodes counts playouts, depth is
+    // ignored. Without limits the difficulty's playouts are used.
+    SearchResult search(const Position& position, const SearchLimits& limits);
+
+    void setDifficulty(ChessAI::Difficulty difficulty) { currentDifficulty = difficulty; }
+    ChessAI::Difficulty getDifficulty() const { return currentDifficulty; }
+
+    // Threads descending the tree together (default 1)
+    void setThreads(int threads) { threadCount = std::max(1, threads); }
+    // Arena size; a full arena stops growing the tree, not the search
+    void setTreeSize(size_t kilobytes);
+    void setNetwork(std::shared_ptr<const NnueNetwork> network);
+
+    // Statistics of the last search; nodes counts playouts
+    const SearchStats& getSearchStats() const { return stats; }
+    const std::vector<PackedMove>& getPrincipalVariation() const { return principalVariation; }
+
+private:
+    struct Node {
+        std::atomic<int32_t> visits;   // Including virtual losses in flight
+        std::atomic<int64_t> valueSum; // For the side that moved into the node, in 1/VALUE_SCALE
+        std::atomic<uint8_t> state;    // Unexpanded, expanding or expanded
+        uint16_t childCount;
+        uint32_t firstChild;
+        PackedMove move;
+        float prior;
+    };
+
+    ChessAI::Difficulty currentDifficulty;
+    int threadCount;
+    std::unique_ptr<Node[]> arena;
+    size_t capacity;
+    std::atomic<size_t> used;
+    std::shared_ptr<const NnueNetwork> nnue;
+    std::vector<std::unique_ptr<ChessAI>> evaluators; // One per thread
+    SearchStats stats;
+    std::vector<PackedMove> principalVariation;
+
+    // One descent from the root position pos, its leaf valued and the
+    // value backed up; pos is back at the root afterwards
+    void playout(Position& pos, ChessAI& evaluator);
+    // Give node its children, and its value for the side to move in score;
+    // false if it has them, another thread is at it or the arena is full
+    bool expand(Node& node, Position& pos, ChessAI& evaluator, int& score);
+    // Child to descend into by PUCT
+    Node& select(Node& node);
+};
+
+#endif // MCTS_H
@@ -0,0 +1,215 @@
+#include "movegen.h"
+
+Bitboard pinnedPieces(const Position& pos, Color c)
+{
+    Square ksq = pos.kingSquare(c);
+    Bitboard occupied = pos.pieces();
+    Bitboard snipers = (rookAttacks(ksq, 0) & pos.pieces(~c, ROOK, QUEEN))
+                     | (bishopAttacks(ksq, 0) & pos.pieces(~c, BISHOP, QUEEN));
+    Bitboard pinned = 0;
+
+    while (snipers) {
+        Bitboard between = BetweenBB[ksq][popLsb(snipers)] & occupied;
+        if (between && !moreThanOne(between))
+            pinned |= between & pos.pieces(c);
+    }
+    return pinned;
+}
+
+// Every square attacked by 'by', computed with the defending king lifted off the
+// board so it cannot step backwards along a slider's ray
+static Bitboard kingDangerSquares(const Position& pos, Color by, Bitboard occupied)
+{
+    Bitboard danger = pawnAttacksBB(by, pos.pieces(by, PAWN));
+    for (Bitboard b = pos.pieces(by, KNIGHT); b;)
+        danger |= KnightAttacks[popLsb(b)];
+    for (Bitboard b = pos.pieces(by, BISHOP, QUEEN); b;)
+        danger |= bishopAttacks(popLsb(b), occupied);
+    for (Bitboard b = pos.pieces(by, ROOK, QUEEN); b;)
+        danger |= rookAttacks(popLsb(b), occupied);
+    danger |= KingAttacks[pos.kingSquare(by)];
+    return danger;
+}
+
+static void addPromotions(MoveList& list, Square from, Square to, int captureFlag)
+{
+    list.add(makePackedMove(from, to, PROMO_QUEEN | captureFlag));
+    list.add(makePackedMove(from, to, PROMO_KNIGHT | captureFlag));
+    list.add(makePackedMove(from, to, PROMO_ROOK | captureFlag));
+    list.add(makePackedMove(from, to, PROMO_BISHOP | captureFlag));
+}
+
+// En passant can expose the king along the rank of the two pawns, so it is
+// checked by lifting both pawns off the board and looking for slider attacks
+static bool epIsLegal(const Position& pos, Square from, Square to)
+{
+    Color us = pos.sideToMove(), them = ~us;
+    Square ksq = pos.kingSquare(us);
+    Square capSq = Square(to ^ 8);
+    Bitboard occupied = (pos.pieces() ^ squareBB(from) ^ squareBB(capSq)) | squareBB(to);
+
+    return !(rookAttacks(ksq, occupied) & pos.pieces(them, ROOK, QUEEN))
+        && !(bishopAttacks(ksq, occupied) & pos.pieces(them, BISHOP, QUEEN))
+        && !(KnightAttacks[ksq] & pos.pieces(them, KNIGHT))
+        && !(PawnAttacks[us][ksq] & pos.pieces(them, PAWN) & ~squareBB(capSq));
+}
+
+template<bool CapturesOnly>
+static void generate(const Position& pos, MoveList& list)
+{
+    Color us = pos.sideToMove(), them = ~us;
+    Square ksq = pos.kingSquare(us);
+    Bitboard occupied = pos.pieces();
+    Bitboard ours = pos.pieces(us), theirs = pos.pieces(them);
+    Bitboard checkers = pos.checkers();
+
+    // King moves never need a pin or check mask, only the danger map
+    Bitboard danger = kingDangerSquares(pos, them, occupied ^ squareBB(ksq));
+    Bitboard kingTargets = KingAttacks[ksq] & ~ours & ~danger;
+    if (CapturesOnly) kingTargets &= theirs;
+    while (kingTargets) {
+        Square to = popLsb(kingTargets);
+        list.add(makePackedMove(ksq, to, (theirs & squareBB(to)) ? CAPTURE : QUIET));
+    }
+
+    // In double check only the king can move
+    if (moreThanOne(checkers)) return;
+
+    // Non-king moves must capture the checker or block its ray
+    Bitboard checkMask = checkers ? (BetweenBB[ksq][lsb(checkers)] | checkers) : ~0ULL;
+    Bitboard targets = ~ours & checkMask;
+    if (CapturesOnly) targets &= theirs;
+    Bitboard pinned = pinnedPieces(pos, us);
+
+    // Pinned knights can never move
+    for (Bitboard b = pos.pieces(us, KNIGHT) & ~pinned; b;) {
+        Square from = popLsb(b);
+        for (Bitboard t = KnightAttacks[from] & targets; t;) {
+            Square to = popLsb(t);
+            list.add(makePackedMove(from, to, (theirs & squareBB(to)) ? CAPTURE : QUIET));
+        }
+    }
+
+    for (Bitboard b = pos.pieces(us, BISHOP) | pos.pieces(us, ROOK) | pos.pieces(us, QUEEN); b;) {
+        Square from = popLsb(b);
+        Bitboard t = pieceAttacks(typeOf(pos.pieceOn(from)), from, occupied) & targets;
+        if (pinned & squareBB(from))
+            t &= LineBB[ksq][from];
+        while (t) {
+            Square to = popLsb(t);
+            list.add(makePackedMove(from, to, (theirs & squareBB(to)) ? CAPTURE : QUIET));
+        }
+    }
+
+    int up = us == WHITE ? 8 : -8;
+    Bitboard promoRank = us == WHITE ? RANK_8_BB : RANK_1_BB;
+    Bitboard doubleRank = us == WHITE ? RANK_4_BB : RANK_5_BB;
+    Square ep = pos.epSquare();
+
+    for (Bitboard b = pos.pieces(us, PAWN); b;) {
+        Square from = popLsb(b);
+        Bitboard allowed = checkMask;
+        if (pinned & squareBB(from))
+            allowed &= LineBB[ksq][from];
+
+        Square to = Square(from + up);
+        if (!(occupied & squareBB(to))) {
+            if (promoRank & squareBB(to)) {
+                if (allowed & squareBB(to))
+                    addPromotions(list, from, to, 0);
+            } else if (!CapturesOnly) {
+                if (allowed & squareBB(to))
+                    list.add(makePackedMove(from, to, QUIET));
+                Square to2 = Square(to + up);
+                if ((doubleRank & squareBB(to2)) && !(occupied & squareBB(to2)) && (allowed & squareBB(to2)))
+                    list.add(makePackedMove(from, to2, DOUBLE_PUSH));
+            }
+        }
+
+        for (Bitboard t = PawnAttacks[us][from] & theirs & allowed; t;) {
+            Square capTo = popLsb(t);
+            if (promoRank & squareBB(capTo))
+                addPromotions(list, from, capTo, CAPTURE);
+            else
+                list.add(makePackedMove(from, capTo, CAPTURE));
+        }
+
+        if (ep != NO_SQUARE && (PawnAttacks[us][from] & squareBB(ep)) && epIsLegal(pos, from, ep))
+            list.add(makePackedMove(from, ep, EP_CAPTURE));
+    }
+
+    if (CapturesOnly || checkers) return;
+
+    // Castling: rights imply king and rook are on their original squares
+    int rights = pos.castlingRights();
+    if (us == WHITE) {
+        if ((rights & WHITE_OO) && !(occupied & (squareBB(F1) | squareBB(G1)))
+            && !(danger & (squareBB(F1) | squareBB(G1))))
+            list.add(makePackedMove(E1, G1, KING_CASTLE));
+        if ((rights & WHITE_OOO) && !(occupied & (squareBB(B1) | squareBB(C1) | squareBB(D1)))
+            && !(danger & (squareBB(C1) | squareBB(D1))))
+            list.add(makePackedMove(E1, C1, QUEEN_CASTLE));
+    } else {
+        if ((rights & BLACK_OO) && !(occupied & (squareBB(F8) | squareBB(G8)))
+            && !(danger & (squareBB(F8) | squareBB(G8))))
+            list.add(makePackedMove(E8, G8, KING_CASTLE));
+        if ((rights & BLACK_OOO) && !(occupied & (squareBB(B8) | squareBB(C8) | squareBB(D8)))
+            && !(danger & (squareBB(C8) | squareBB(D8))))
+            list.add(makePackedMove(E8, C8, QUEEN_CASTLE));
+    }
+}
+
+void generateLegalMoves(const Position& pos, MoveList& list)
+{
+    list.count = 0;
+    generate<false>(pos, list);
+}
+
+void generateLegalCaptures(const Position& pos, MoveList& list)
+{
+    list.count = 0;
+    generate<true>(pos, list);
+}
+
+GameStatus gameStatus(const Position& pos)
+{
+    MoveList list;
+    generateLegalMoves(pos, list);
+    if (list.empty())
+        return pos.inCheck() ? GAME_CHECKMATE : GAME_STALEMATE;
+
+    // Mate on the hundredth half-move takes precedence, hence checked after
+    if (pos.halfmoveClock() >= 100)
+        return GAME_FIFTY_MOVE_RULE;
+    if (pos.repetitionCount() >= 2)
+        return GAME_THREEFOLD_REPETITION;
+    if (pos.hasInsufficientMaterial())
+        return GAME_INSUFFICIENT_MATERIAL;
+    return GAME_ONGOING;
+}
+
+PackedMove parseUciMove(const Position& pos, const std::string& uci)
+{
+    MoveList list;
+    generateLegalMoves(pos, list);
+    for (PackedMove m : list)
+        if (moveToUci(m) == uci)
+            return m;
+    return NO_MOVE;
+}
+
+uint64_t perft(Position& pos, int depth)
+{
+    MoveList list;
+    generateLegalMoves(pos, list);
+    if (depth <= 1)
+        return depth == 1 ? uint64_t(list.size()) : 1;
+
+    uint64_t nodes = 0;
+    for (PackedMove m : list) {
+        pos.makeMove(m);
+        nodes += perft(pos, depth - 1);
+        pos.unmakeMove(m);
+    }
+    return nodes;
+}
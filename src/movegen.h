@@ -0,0 +1,58 @@
+#ifndef MOVEGEN_H
+#define MOVEGEN_H
+
+#include <cstdint>
+#include <string>
+#include "position.h"
+
+// Fixed-capacity move list; 218 is the most legal moves any position has
+struct MoveList {
+    PackedMove moves[256];
+    int count;
+
+    MoveList() : count(0) {}
+    void add(PackedMove m) { moves[count++] = m; }
+    int size() const { return count; }
+    bool empty() const { return count == 0; }
+    bool contains(PackedMove m) const {
+        for (int i = 0; i < count; ++i)
+            if (moves[i] == m) return true;
+        return false;
+    }
+    PackedMove& operator[](int i) { return moves[i]; }
+    PackedMove operator[](int i) const { return moves[i]; }
+    PackedMove* begin() { return moves; }
+    PackedMove* end() { return moves + count; }
+    const PackedMove* begin() const { return moves; }
+    const PackedMove* end() const { return moves + count; }
+};
+
+// Strictly legal move generation. Checkers and pinned pieces are computed once,
+// then every piece is restricted to the check-evasion mask and its pin ray.
+void generateLegalMoves(const Position& pos, MoveList& list);
+
+// Legal captures and promotions only, for quiescence search
+void generateLegalCaptures(const Position& pos, MoveList& list);
+
+// Own pieces pinned against their king
+Bitboard pinnedPieces(const Position& pos, Color c);
+
+enum GameStatus {
+    GAME_ONGOING,
+    GAME_CHECKMATE,          // Side to move is mated
+    GAME_STALEMATE,
+    GAME_THREEFOLD_REPETITION,
+    GAME_FIFTY_MOVE_RULE,
+    GAME_INSUFFICIENT_MATERIAL
+};
+
+// Result of the game in this position; one legal move generation at most
+GameStatus gameStatus(const Position& pos);
+
+// Find the legal move matching a UCI string ("e2e4", "e7e8q"), or NO_MOVE
+PackedMove parseUciMove(const Position& pos, const std::string& uci);
+
+// Count leaf nodes of the legal move tree; the standard move generator test
+uint64_t perft(Position& pos, int depth);
+
+#endif // MOVEGEN_H
@@ -0,0 +1,450 @@
+#include "nnue.h"
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define NNUE_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define NNUE_TARGET(isa)
+#else
+#define NNUE_TARGET(isa) __attribute__((target(isa)))
+#endif
+#elif defined(__ARM_NEON) || defined(__aarch64__)
+#define NNUE_NEON
+#include <arm_neon.h>
+#endif
+
+// ---------------------------------------------------------------------------
+// Kernels. All vector widths divide the layer sizes, so there are no tails.
+
+struct NnueKernels {
+    const char* name;
+    void (*addVector)(int16_t* acc, const int16_t* w, int n);
+    void (*subVector)(int16_t* acc, const int16_t* w, int n);
+    void (*clippedRelu)(const int16_t* in, uint8_t* out, int n);
+    // out[r] = bias[r] + sum_j in[j] * weights[r * inDim + j]
+    void (*affine)(const uint8_t* in, const int8_t* weights, const int32_t* bias,
+                   int32_t* out, int inDim, int outDim);
+};
+
+static void addVectorScalar(int16_t* acc, const int16_t* w, int n)
+{
+    for (int i = 0; i < n; ++i) acc[i] = int16_t(acc[i] + w[i]);
+}
+
+static void subVectorScalar(int16_t* acc, const int16_t* w, int n)
+{
+    for (int i = 0; i < n; ++i) acc[i] = int16_t(acc[i] - w[i]);
+}
+
+static void clippedReluScalar(const int16_t* in, uint8_t* out, int n)
+{
+    for (int i = 0; i < n; ++i)
+        out[i] = uint8_t(in[i] < 0 ? 0 : (in[i] > 127 ? 127 : in[i]));
+}
+
+static void affineScalar(const uint8_t* in, const int8_t* weights, const int32_t* bias,
+                         int32_t* out, int inDim, int outDim)
+{
+    for (int r = 0; r < outDim; ++r) {
+        int32_t sum = bias[r];
+        const int8_t* row = weights + r * inDim;
+        for (int j = 0; j < inDim; ++j) sum += in[j] * row[j];
+        out[r] = sum;
+    }
+}
+
+#ifdef NNUE_X86
+
+NNUE_TARGET("avx2") static void addVectorAvx2(int16_t* acc, const int16_t* w, int n)
+{
+    for (int i = 0; i < n; i += 16) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(w + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc + i), _mm256_add_epi16(a, b));
+    }
+}
+
+NNUE_TARGET("avx2") static void subVectorAvx2(int16_t* acc, const int16_t* w, int n)
+{
+    for (int i = 0; i < n; i += 16) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(w + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc + i), _mm256_sub_epi16(a, b));
+    }
+}
+
+NNUE_TARGET("avx2") static void clippedReluAvx2(const int16_t* in, uint8_t* out, int n)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    for (int i = 0; i < n; i += 32) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i + 16));
+        // packs works per 128-bit lane, the permute restores element order
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi16(a, b), 0xD8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_max_epi8(packed, zero));
+    }
+}
+
+NNUE_TARGET("avx2") static void affineAvx2(const uint8_t* in, const int8_t* weights, const int32_t* bias,
+                                           int32_t* out, int inDim, int outDim)
+{
+    const __m256i ones = _mm256_set1_epi16(1);
+    for (int r = 0; r < outDim; ++r) {
+        const int8_t* row = weights + r * inDim;
+        __m256i sum = _mm256_setzero_si256();
+        for (int j = 0; j < inDim; j += 32) {
+            __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + j));
+            __m256i w = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + j));
+            // Inputs are at most 127, so the pairwise int16 sums cannot saturate
+            sum = _mm256_add_epi32(sum, _mm256_madd_epi16(_mm256_maddubs_epi16(x, w), ones));
+        }
+        __m128i s = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+        s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4E));
+        s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xB1));
+        out[r] = bias[r] + _mm_cvtsi128_si32(s);
+    }
+}
+
+NNUE_TARGET("sse4.1") static void addVectorSse41(int16_t* acc, const int16_t* w, int n)
+{
+    for (int i = 0; i < n; i += 8) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(acc + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(w + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(acc + i), _mm_add_epi16(a, b));
+    }
+}
+
+NNUE_TARGET("sse4.1") static void subVectorSse41(int16_t* acc, const int16_t* w, int n)
+{
+    for (int i = 0; i < n; i += 8) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(acc + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(w + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(acc + i), _mm_sub_epi16(a, b));
+    }
+}
+
+NNUE_TARGET("sse4.1") static void clippedReluSse41(const int16_t* in, uint8_t* out, int n)
+{
+    const __m128i zero = _mm_setzero_si128();
+    for (int i = 0; i < n; i += 16) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i + 8));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_max_epi8(_mm_packs_epi16(a, b), zero));
+    }
+}
+
+NNUE_TARGET("sse4.1") static void affineSse41(const uint8_t* in, const int8_t* weights, const int32_t* bias,
+                                              int32_t* out, int inDim, int outDim)
+{
+    const __m128i ones = _mm_set1_epi16(1);
+    for (int r = 0; r < outDim; ++r) {
+        const int8_t* row = weights + r * inDim;
+        __m128i sum = _mm_setzero_si128();
+        for (int j = 0; j < inDim; j += 16) {
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + j));
+            __m128i w = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + j));
+            sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_maddubs_epi16(x, w), ones));
+        }
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+        out[r] = bias[r] + _mm_cvtsi128_si32(sum);
+    }
+}
+
+static bool cpuHasAvx2()
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) return false;
+    __cpuid(info, 1);
+    bool osxsave = info[2] & (1 << 27);
+    if (!osxsave || (_xgetbv(0) & 6) != 6) return false;
+    __cpuidex(info, 7, 0);
+    return info[1] & (1 << 5);
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+static bool cpuHasSse41()
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 1);
+    return info[2] & (1 << 19);
+#else
+    return __builtin_cpu_supports("sse4.1");
+#endif
+}
+
+#endif // NNUE_X86
+
+#ifdef NNUE_NEON
+
+static void addVectorNeon(int16_t* acc, const int16_t* w, int n)
+{
+    for (int i = 0; i < n; i += 8)
+        vst1q_s16(acc + i, vaddq_s16(vld1q_s16(acc + i), vld1q_s16(w + i)));
+}
+
+static void subVectorNeon(int16_t* acc, const int16_t* w, int n)
+{
+    for (int i = 0; i < n; i += 8)
+        vst1q_s16(acc + i, vsubq_s16(vld1q_s16(acc + i), vld1q_s16(w + i)));
+}
+
+static void clippedReluNeon(const int16_t* in, uint8_t* out, int n)
+{
+    const int8x8_t zero = vdup_n_s8(0);
+    for (int i = 0; i < n; i += 8) {
+        int8x8_t packed = vmax_s8(vqmovn_s16(vld1q_s16(in + i)), zero);
+        vst1_u8(out + i, vreinterpret_u8_s8(packed));
+    }
+}
+
+static void affineNeon(const uint8_t* in, const int8_t* weights, const int32_t* bias,
+                       int32_t* out, int inDim, int outDim)
+{
+    for (int r = 0; r < outDim; ++r) {
+        const int8_t* row = weights + r * inDim;
+        int32x4_t sum = vdupq_n_s32(0);
+        for (int j = 0; j < inDim; j += 16) {
+            // Inputs never exceed 127, so reading them as signed is exact
+            int8x16_t x = vreinterpretq_s8_u8(vld1q_u8(in + j));
+            int8x16_t w = vld1q_s8(row + j);
+            sum = vpadalq_s16(sum, vmull_s8(vget_low_s8(x), vget_low_s8(w)));
+            sum = vpadalq_s16(sum, vmull_s8(vget_high_s8(x), vget_high_s8(w)));
+        }
+#ifdef __aarch64__
+        out[r] = bias[r] + vaddvq_s32(sum);
+#else
+        int32x2_t half = vadd_s32(vget_low_s32(sum), vget_high_s32(sum));
+        out[r] = bias[r] + vget_lane_s32(vpadd_s32(half, half), 0);
+#endif
+    }
+}
+
+#endif // NNUE_NEON
+
+static NnueKernels selectKernels()
+{
+#ifdef NNUE_X86
+    if (cpuHasAvx2())
+        return {"avx2", addVectorAvx2, subVectorAvx2, clippedReluAvx2, affineAvx2};
+    if (cpuHasSse41())
+        return {"sse4.1", addVectorSse41, subVectorSse41, clippedReluSse41, affineSse41};
+#endif
+#ifdef NNUE_NEON
+    return {"neon", addVectorNeon, subVectorNeon, clippedReluNeon, affineNeon};
+#endif
+    return {"scalar", addVectorScalar, subVectorScalar, clippedReluScalar, affineScalar};
+}
+
+static const NnueKernels& kernels()
+{
+    static const NnueKernels selected = selectKernels();
+    return selected;
+}
+
+// ---------------------------------------------------------------------------
+// Network file
+
+NnueNetwork::NnueNetwork()
+    : ftBiases(nullptr), ftWeights(nullptr), l1Biases(nullptr), l1Weights(nullptr),
+      l2Biases(nullptr), l2Weights(nullptr), outBias(0), outWeights(nullptr)
+{
+}
+
+bool NnueNetwork::load(const std::string& fileName)
+{
+    if (!file.open(fileName)) return false;
+
+    const unsigned char* base = file.data();
+    size_t offset = 0;
+    bool ok = true;
+
+    // Hands out the next 64-byte aligned array of 'bytes' bytes
+    auto take = [&](size_t bytes) -> const unsigned char* {
+        offset = (offset + 63) & ~size_t(63);
+        const unsigned char* p = base + offset;
+        offset += bytes;
+        if (offset > file.size()) ok = false;
+        return p;
+    };
+
+    const unsigned char* header = take(8 + 4 * sizeof(uint32_t));
+    if (!ok || std::memcmp(header, "CBNNUE1", 8) != 0) {
+        file.close();
+        return false;
+    }
+
+    uint32_t dims[4];
+    std::memcpy(dims, header + 8, sizeof(dims));
+    if (dims[0] != NNUE_FEATURES || dims[1] != NNUE_HIDDEN || dims[2] != NNUE_L1 || dims[3] != NNUE_L2) {
+        file.close();
+        return false;
+    }
+
+    ftBiases = reinterpret_cast<const int16_t*>(take(NNUE_HIDDEN * sizeof(int16_t)));
+    ftWeights = reinterpret_cast<const int16_t*>(take(size_t(NNUE_FEATURES) * NNUE_HIDDEN * sizeof(int16_t)));
+    l1Biases = reinterpret_cast<const int32_t*>(take(NNUE_L1 * sizeof(int32_t)));
+    l1Weights = reinterpret_cast<const int8_t*>(take(NNUE_L1 * 2 * NNUE_HIDDEN));
+    l2Biases = reinterpret_cast<const int32_t*>(take(NNUE_L2 * sizeof(int32_t)));
+    l2Weights = reinterpret_cast<const int8_t*>(take(NNUE_L2 * NNUE_L1));
+    const unsigned char* outBiasData = take(sizeof(int32_t));
+    outWeights = reinterpret_cast<const int8_t*>(take(NNUE_L2));
+
+    if (!ok) {
+        file.close();
+        return false;
+    }
+
+    std::memcpy(&outBias, outBiasData, sizeof(outBias));
+    path = fileName;
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Evaluator
+
+// Features are mirrored vertically for black so both sides share weights
+static inline int featureIndex(Color perspective, Square ksq, Piece pc, Square s)
+{
+    if (perspective == BLACK) {
+        ksq = flipRank(ksq);
+        s = flipRank(s);
+    }
+    int pieceIndex = typeOf(pc) * 2 + (colorOf(pc) != perspective);
+    return (ksq * 10 + pieceIndex) * 64 + s;
+}
+
+NnueEvaluator::NnueEvaluator()
+    : refreshCount(0), updateCount(0)
+{
+}
+
+void NnueEvaluator::setNetwork(std::shared_ptr<const NnueNetwork> network)
+{
+    net = network;
+    stack.clear();
+}
+
+const char* NnueEvaluator::simdName()
+{
+    return kernels().name;
+}
+
+void NnueEvaluator::refreshAccumulator(const Position& pos, NnueAccumulator& acc, Color perspective)
+{
+    const NnueKernels& k = kernels();
+    int16_t* values = acc.values[perspective];
+    Square ksq = pos.kingSquare(perspective);
+
+    std::memcpy(values, net->ftBiases, sizeof(acc.values[perspective]));
+    for (Bitboard b = pos.pieces() & ~pos.pieces(KING); b;) {
+        Square s = popLsb(b);
+        int f = featureIndex(perspective, ksq, pos.pieceOn(s), s);
+        k.addVector(values, net->ftWeights + size_t(f) * NNUE_HIDDEN, NNUE_HIDDEN);
+    }
+    acc.computed[perspective] = true;
+    ++refreshCount;
+}
+
+void NnueEvaluator::updateAccumulator(const Position& pos, int index, Color perspective)
+{
+    const NnueKernels& k = kernels();
+    Piece ownKing = makePiece(perspective, KING);
+
+    // Walk back to the nearest ancestor that is still valid for this side.
+    // A move of our own king changes every feature, so that forces a refresh.
+    int start = index;
+    bool refresh = false;
+    while (true) {
+        const StateInfo& st = pos.state(start);
+        if (start == 0 || (st.dirtyCount > 0 && st.dirty[0].piece == ownKing)) {
+            refresh = true;
+            break;
+        }
+        --start;
+        const NnueAccumulator& prev = stack[start];
+        if (prev.key == pos.state(start).key && prev.computed[perspective])
+            break;
+    }
+
+    if (refresh) {
+        refreshAccumulator(pos, stack[index], perspective);
+        return;
+    }
+
+    Square ksq = pos.kingSquare(perspective);
+    for (int i = start + 1; i <= index; ++i) {
+        NnueAccumulator& acc = stack[i];
+        const StateInfo& st = pos.state(i);
+        if (acc.key != st.key) {
+            acc.key = st.key;
+            acc.computed[WHITE] = acc.computed[BLACK] = false;
+        }
+
+        int16_t* values = acc.values[perspective];
+        std::memcpy(values, stack[i - 1].values[perspective], sizeof(acc.values[perspective]));
+        for (int d = 0; d < st.dirtyCount; ++d) {
+            const DirtyPiece& dp = st.dirty[d];
+            if (typeOf(dp.piece) == KING) continue;
+            if (dp.from != NO_SQUARE)
+                k.subVector(values, net->ftWeights + size_t(featureIndex(perspective, ksq, dp.piece, dp.from)) * NNUE_HIDDEN, NNUE_HIDDEN);
+            if (dp.to != NO_SQUARE)
+                k.addVector(values, net->ftWeights + size_t(featureIndex(perspective, ksq, dp.piece, dp.to)) * NNUE_HIDDEN, NNUE_HIDDEN);
+        }
+        acc.computed[perspective] = true;
+        ++updateCount;
+    }
+}
+
+int NnueEvaluator::evaluate(const Position& pos)
+{
+    const NnueKernels& k = kernels();
+    int index = pos.stateCount() - 1;
+    if (int(stack.size()) <= index)
+        stack.resize(index + 64, NnueAccumulator());
+
+    NnueAccumulator& acc = stack[index];
+    if (acc.key != pos.key()) {
+        acc.key = pos.key();
+        acc.computed[WHITE] = acc.computed[BLACK] = false;
+    }
+    for (int c = WHITE; c <= BLACK; ++c) {
+        if (!acc.computed[c])
+            updateAccumulator(pos, index, Color(c));
+    }
+
+    // Side to move's half first
+    alignas(64) uint8_t input[2 * NNUE_HIDDEN];
+    alignas(64) int32_t l1Out[NNUE_L1];
+    alignas(64) uint8_t l1Act[NNUE_L1];
+    alignas(64) int32_t l2Out[NNUE_L2];
+    alignas(64) uint8_t l2Act[NNUE_L2];
+
+    Color us = pos.sideToMove();
+    k.clippedRelu(acc.values[us], input, NNUE_HIDDEN);
+    k.clippedRelu(acc.values[~us], input + NNUE_HIDDEN, NNUE_HIDDEN);
+
+    k.affine(input, net->l1Weights, net->l1Biases, l1Out, 2 * NNUE_HIDDEN, NNUE_L1);
+    for (int i = 0; i < NNUE_L1; ++i) {
+        int v = l1Out[i] >> 6;
+        l1Act[i] = uint8_t(v < 0 ? 0 : (v > 127 ? 127 : v));
+    }
+
+    k.affine(l1Act, net->l2Weights, net->l2Biases, l2Out, NNUE_L1, NNUE_L2);
+    for (int i = 0; i < NNUE_L2; ++i) {
+        int v = l2Out[i] >> 6;
+        l2Act[i] = uint8_t(v < 0 ? 0 : (v > 127 ? 127 : v));
+    }
+
+    int32_t output = net->outBias;
+    for (int i = 0; i < NNUE_L2; ++i)
+        output += net->outWeights[i] * l2Act[i];
+    return output / 16;
+}
@@ -0,0 +1,91 @@
+#ifndef NNUE_H
+#define NNUE_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "position.h"
+#include "mappedfile.h"
+
+// Efficiently updatable neural network evaluation (HalfKP 2x256-32-32-1).
+//
+// Input features are (own king square, piece, square) triples seen from each
+// side, kings excluded: 64 * 10 * 64 = 40960 per perspective. The first layer
+// is kept as an int16 accumulator per side and updated from the pieces that
+// changed on each move; the small int8 layers run on every evaluation.
+//
+// Network file layout (little-endian, each array starts on a 64-byte boundary):
+//   char[8]   magic "CBNNUE1"
+//   uint32    features, hidden, l1, l2   (must be 40960, 256, 32, 32)
+//   int16     ftBiases[hidden]
+//   int16     ftWeights[features][hidden]
+//   int32     l1Biases[l1]           int8 l1Weights[l1][2 * hidden]
+//   int32     l2Biases[l2]           int8 l2Weights[l2][l1]
+//   int32     outBias                int8 outWeights[l2]
+// Hidden activations are clamp(x, 0, 127); layer outputs are shifted right by
+// 6 before clamping and the final output is divided by 16 to get centipawns.
+
+const int NNUE_FEATURES = 64 * 10 * 64;
+const int NNUE_HIDDEN = 256;
+const int NNUE_L1 = 32;
+const int NNUE_L2 = 32;
+
+class NnueNetwork {
+public:
+    NnueNetwork();
+
+    // Map a network file; weights are used in place, never copied
+    bool load(const std::string& path);
+    bool isLoaded() const { return file.isOpen(); }
+    const std::string& fileName() const { return path; }
+
+    const int16_t* ftBiases;
+    const int16_t* ftWeights;
+    const int32_t* l1Biases;
+    const int8_t* l1Weights;
+    const int32_t* l2Biases;
+    const int8_t* l2Weights;
+    int32_t outBias;
+    const int8_t* outWeights;
+
+private:
+    MappedFile file;
+    std::string path;
+};
+
+struct alignas(64) NnueAccumulator {
+    int16_t values[2][NNUE_HIDDEN];
+    uint64_t key;        // Key of the position these values belong to
+    bool computed[2];
+};
+
+// Per-thread evaluator: owns the accumulator stack that follows the
+// position's move history, and shares the read-only network.
+class NnueEvaluator {
+public:
+    NnueEvaluator();
+
+    void setNetwork(std::shared_ptr<const NnueNetwork> network);
+    bool isReady() const { return net && net->isLoaded(); }
+
+    // Evaluation in centipawns from the side to move's point of view
+    int evaluate(const Position& pos);
+
+    // Name of the kernel set picked for this CPU ("avx2", "sse4.1", "neon", "scalar")
+    static const char* simdName();
+
+    uint64_t refreshes() const { return refreshCount; }
+    uint64_t updates() const { return updateCount; }
+
+private:
+    std::shared_ptr<const NnueNetwork> net;
+    std::vector<NnueAccumulator> stack; // Indexed like Position::state()
+    uint64_t refreshCount;
+    uint64_t updateCount;
+
+    void updateAccumulator(const Position& pos, int index, Color perspective);
+    void refreshAccumulator(const Position& pos, NnueAccumulator& acc, Color perspective);
+};
+
+#endif // NNUE_H
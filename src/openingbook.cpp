@@ -0,0 +1,152 @@
+#include "openingbook.h"
+#include "movegen.h"
+
+// PolyglotRandom: the published numbers the keys are built from
+#include "polyglotrandom.inc"
+
+// Polyglot key layout: 768 piece-square numbers, castling, en passant, turn
+static const int KeyCastling = 768;
+static const int KeyEnPassant = 772;
+static const int KeyTurn = 780;
+
+static uint64_t readBigEndian(const unsigned char* p, int bytes)
+{
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; ++i)
+        value = (value << 8) | p[i];
+    return value;
+}
+
+OpeningBook::OpeningBook() : count(0)
+{
+}
+
+bool OpeningBook::open(const std::string& path)
+{
+    close();
+    // Keys that aren't Polyglot's would miss every entry without a word
+    if (!checkKeys() || !file.open(path))
+        return false;
+    if (file.size() == 0 || file.size() % ENTRY_SIZE != 0) {
+        file.close();
+        return false;
+    }
+    count = file.size() / ENTRY_SIZE;
+    return true;
+}
+
+void OpeningBook::close()
+{
+    file.close();
+    count = 0;
+}
+
+uint64_t OpeningBook::keyAt(size_t i) const
+{
+    return readBigEndian(file.data() + i * ENTRY_SIZE, 8);
+}
+
+uint64_t OpeningBook::key(const Position& pos)
+{
+    uint64_t k = 0;
+    for (Bitboard b = pos.pieces(); b;) {
+        Square s = popLsb(b);
+        Piece p = pos.pieceOn(s);
+        int kind = 2 * typeOf(p) + (colorOf(p) == WHITE);
+        k ^= PolyglotRandom[64 * kind + s];
+    }
+
+    // Castling bits are in Polyglot order already (white short, white long, ...)
+    for (int i = 0; i < 4; ++i) {
+        if (pos.castlingRights() & (1 << i))
+            k ^= PolyglotRandom[KeyCastling + i];
+    }
+
+    // The en passant file only counts when a pawn can actually take
+    Square ep = pos.epSquare();
+    Color us = pos.sideToMove();
+    if (ep != NO_SQUARE && (PawnAttacks[~us][ep] & pos.pieces(us, PAWN)))
+        k ^= PolyglotRandom[KeyEnPassant + fileOf(ep)];
+
+    if (us == WHITE)
+        k ^= PolyglotRandom[KeyTurn];
+    return k;
+}
+
+bool OpeningBook::checkKeys()
+{
+    // Published key of the initial position
+    Position pos;
+    return key(pos) == 0x463B96181691FC9CULL;
+}
+
+uint16_t OpeningBook::encodeMove(PackedMove move)
+{
+    Square from = moveFrom(move), to = moveTo(move);
+
+    // Castling is stored as the king moving onto its rook
+    if (isCastlingMove(move))
+        to = makeSquare(moveFlags(move) == KING_CASTLE ? 7 : 0, rankOf(from));
+
+    uint16_t code = uint16_t(to | (from << 6));
+    if (isPromotionMove(move))
+        code |= uint16_t(promotionType(move)) << 12; // KNIGHT = 1 .. QUEEN = 4
+    return code;
+}
+
+PackedMove OpeningBook::decodeMove(const Position& pos, uint16_t code)
+{
+    MoveList moves;
+    generateLegalMoves(pos, moves);
+    for (PackedMove move : moves) {
+        if (encodeMove(move) == (code & 0x7FFF))
+            return move;
+    }
+    return NO_MOVE;
+}
+
+std::vector<BookEntry> OpeningBook::lookup(const Position& pos) const
+{
+    std::vector<BookEntry> entries;
+    if (!isOpen())
+        return entries;
+
+    // Binary search for the first entry with the key
+    uint64_t k = key(pos);
+    size_t low = 0, high = count;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (keyAt(mid) < k)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    for (size_t i = low; i < count && keyAt(i) == k; ++i) {
+        const unsigned char* entry = file.data() + i * ENTRY_SIZE;
+        PackedMove move = decodeMove(pos, uint16_t(readBigEndian(entry + 8, 2)));
+        if (move != NO_MOVE) // Hash collisions and broken entries
+            entries.push_back({move, uint16_t(readBigEndian(entry + 10, 2))});
+    }
+    return entries;
+}
+
+PackedMove OpeningBook::pick(const Position& pos, std::mt19937& random) const
+{
+    std::vector<BookEntry> entries = lookup(pos);
+    uint32_t total = 0;
+    for (const BookEntry& entry : entries)
+        total += entry.weight;
+    if (entries.empty())
+        return NO_MOVE;
+    if (total == 0)
+        return entries[std::uniform_int_distribution<size_t>(0, entries.size() - 1)(random)].move;
+
+    uint32_t choice = std::uniform_int_distribution<uint32_t>(0, total - 1)(random);
+    for (const BookEntry& entry : entries) {
+        if (choice < entry.weight)
+            return entry.move;
+        choice -= entry.weight;
+    }
+    return entries.back().move;
+}
@@ -0,0 +1,70 @@
+#ifndef OPENINGBOOK_H
+#define OPENINGBOOK_H
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+#include "position.h"
+#include "mappedfile.h"
+
+// Opening book in the Polyglot ".bin" layout, mapped into memory and read
+// in place.
+//
+// The file is a flat array of 16-byte big-endian entries sorted by key:
+//   uint64  key      position hash (see key() below)
+//   uint16  move     to file/rank in bits 0-5, from in bits 6-11, promotion
+//                    in bits 12-14 (1 knight .. 4 queen); castling is
+//                    written as the king taking its own rook (e1h1)
+//   uint16  weight   relative frequency of the move
+//   uint32  learn    unused
+// Several entries may share a key, one per book move.
+//
+// Keys are Polyglot's: the published Random64 numbers (12 x 64 piece-square
+// numbers ordered black pawn, white pawn, black knight, ..., then 4 castling
+// rights, 8 en passant files counted only when a capture is possible, and
+// white to move), so books from other Polyglot tools work and ours work in
+// them.
+
+struct BookEntry {
+    PackedMove move;
+    uint16_t weight;
+};
+
+class OpeningBook {
+public:
+    OpeningBook();
+
+    bool open(const std::string& path);
+    void close();
+
+    bool isOpen() const { return file.isOpen(); }
+    size_t entryCount() const { return count; }
+
+    // All book moves for pos that are legal there, in file order
+    std::vector<BookEntry> lookup(const Position& pos) const;
+
+    // A book move picked with probability proportional to its weight;
+    // NO_MOVE if pos is not in the book
+    PackedMove pick(const Position& pos, std::mt19937& random) const;
+
+    // Book key of a position
+    static uint64_t key(const Position& pos);
+    // Whether key() gives the published Polyglot key of the initial position
+    static bool checkKeys();
+
+    // Polyglot move code, and back for a position (NO_MOVE if the code
+    // matches no legal move there)
+    static uint16_t encodeMove(PackedMove move);
+    static PackedMove decodeMove(const Position& pos, uint16_t code);
+
+    static const int ENTRY_SIZE = 16;
+
+private:
+    MappedFile file;
+    size_t count;
+
+    uint64_t keyAt(size_t i) const;
+};
+
+#endif // OPENINGBOOK_H
@@ -0,0 +1,47 @@
+#include "openingexplorer.h"
+#include <algorithm>
+
+int ExplorerMove::scorePercent(Color mover) const
+{
+    uint32_t finished = whiteWins + draws + blackWins;
+    if (finished == 0)
+        return -1;
+    uint32_t wins = mover == WHITE ? whiteWins : blackWins;
+    return int((200 * uint64_t(wins) + 100 * uint64_t(draws) + finished) / (2 * uint64_t(finished)));
+}
+
+std::vector<ExplorerMove> exploreMoves(const GameDatabase& db, const Position& pos)
+{
+    std::vector<ExplorerMove> moves;
+    const char* ratingTag = pos.sideToMove() == WHITE ? "WhiteElo" : "BlackElo";
+
+    for (const DbHit& hit : db.find(pos)) {
+        auto it = std::find_if(moves.begin(), moves.end(),
+                               [&](const ExplorerMove& m) { return m.move == hit.next; });
+        if (it == moves.end())
+            it = moves.insert(moves.end(), ExplorerMove{hit.next, 0, 0, 0, 0, 0, 0});
+
+        it->games++;
+        switch (db.gameResult(hit.game)) {
+        case 1: it->whiteWins++; break;
+        case 2: it->blackWins++; break;
+        case 3: it->draws++; break;
+        default: break;
+        }
+
+        int rating = 0;
+        for (char c : db.gameTag(hit.game, ratingTag)) {
+            if (c < '0' || c > '9' || rating > 10000)
+                break;
+            rating = 10 * rating + (c - '0');
+        }
+        if (rating > 0) {
+            it->rated++;
+            it->ratingSum += uint64_t(rating);
+        }
+    }
+
+    std::stable_sort(moves.begin(), moves.end(),
+                     [](const ExplorerMove& a, const ExplorerMove& b) { return a.games > b.games; });
+    return moves;
+}
@@ -0,0 +1,29 @@
+#ifndef OPENINGEXPLORER_H
+#define OPENINGEXPLORER_H
+
+#include <cstdint>
+#include <vector>
+#include "gamedb.h"
+
+// Continuation statistics for one position of a game database
+struct ExplorerMove {
+    PackedMove move;      // NO_MOVE for games that ended in the position
+    uint32_t games;
+    uint32_t whiteWins;
+    uint32_t draws;
+    uint32_t blackWins;
+    uint32_t rated;       // Games where the side playing the move has an Elo tag
+    uint64_t ratingSum;
+
+    // Points scored by the side playing the move, in percent of the
+    // finished games; -1 if none finished
+    int scorePercent(Color mover) const;
+    // Average Elo of the side playing the move, 0 if nobody was rated
+    int averageRating() const { return rated ? int(ratingSum / rated) : 0; }
+};
+
+// Every move played from pos in db, most played first. Reads only the
+// index and each game's result and Elo tag.
+std::vector<ExplorerMove> exploreMoves(const GameDatabase& db, const Position& pos);
+
+#endif // OPENINGEXPLORER_H
@@ -0,0 +1,140 @@
+#include "pawntable.h"
+
+// Pawn structure weights in centipawns, {middlegame, endgame}
+static const int PassedPawnBonus[8][2] = { // By relative rank
+    {0, 0}, {5, 10}, {10, 15}, {15, 25}, {25, 45}, {40, 75}, {60, 120}, {0, 0}
+};
+static const int IsolatedPawnPenalty[2] = {10, 15};
+static const int DoubledPawnPenalty[2] = {10, 20};
+static const int BackwardPawnPenalty[2] = {8, 10};
+
+// King shelter: own pawn one or two ranks in front of the king, or none
+static const int ShelterPawnNear = 12;
+static const int ShelterPawnFar = 6;
+static const int ShelterMissingPenalty = 15;
+
+PawnTable::PawnTable(int sizeInEntries)
+    : probeCount(0), hitCount(0)
+{
+    // Round down to a power of two so the index is a simple mask
+    int size = 1;
+    while (size * 2 <= sizeInEntries) size *= 2;
+    table.resize(size);
+    mask = size - 1;
+    clear();
+}
+
+void PawnTable::clear()
+{
+    for (PawnEntry& entry : table) {
+        entry.key = ~0ULL;
+        entry.kingSquare[WHITE] = entry.kingSquare[BLACK] = NO_SQUARE;
+    }
+}
+
+PawnEntry* PawnTable::probe(const Position& pos)
+{
+    uint64_t key = pos.pawnKey();
+    PawnEntry* entry = &table[key & mask];
+
+    ++probeCount;
+    if (entry->key == key) {
+        ++hitCount;
+        return entry;
+    }
+
+    entry->key = key;
+    entry->kingSquare[WHITE] = entry->kingSquare[BLACK] = NO_SQUARE;
+    evaluateStructure(pos, *entry);
+    return entry;
+}
+
+void PawnTable::evaluateStructure(const Position& pos, PawnEntry& entry)
+{
+    int mg[2] = {0, 0}, eg[2] = {0, 0};
+
+    for (int c = WHITE; c <= BLACK; ++c) {
+        Color us = Color(c), them = ~us;
+        Bitboard ourPawns = pos.pieces(us, PAWN);
+        Bitboard theirPawns = pos.pieces(them, PAWN);
+
+        entry.passedPawns[us] = 0;
+        entry.pawnAttacks[us] = pawnAttacksBB(us, ourPawns);
+        entry.semiOpenFiles[us] = 0xFF;
+
+        for (Bitboard b = ourPawns; b;) {
+            Square s = popLsb(b);
+            int file = fileOf(s);
+            Bitboard adjacent = adjacentFilesBB(file);
+
+            entry.semiOpenFiles[us] &= ~(1 << file);
+
+            bool isolated = !(ourPawns & adjacent);
+            bool doubled = ourPawns & forwardFileBB(us, s);
+            bool passed = !(theirPawns & passedPawnSpan(us, s)) && !doubled;
+
+            // Backward: no own pawn level or behind on an adjacent file to support
+            // the advance, and the stop square is controlled by an enemy pawn
+            Square stop = Square(us == WHITE ? s + 8 : s - 8);
+            bool backward = !isolated
+                         && !(ourPawns & adjacent & ~forwardRanksBB(us, s))
+                         && (PawnAttacks[us][stop] & theirPawns);
+
+            if (passed) {
+                entry.passedPawns[us] |= squareBB(s);
+                mg[us] += PassedPawnBonus[relativeRank(us, s)][0];
+                eg[us] += PassedPawnBonus[relativeRank(us, s)][1];
+            }
+            if (isolated) {
+                mg[us] -= IsolatedPawnPenalty[0];
+                eg[us] -= IsolatedPawnPenalty[1];
+            }
+            if (doubled) {
+                mg[us] -= DoubledPawnPenalty[0];
+                eg[us] -= DoubledPawnPenalty[1];
+            }
+            if (backward) {
+                mg[us] -= BackwardPawnPenalty[0];
+                eg[us] -= BackwardPawnPenalty[1];
+            }
+        }
+    }
+
+    entry.scoreMg = mg[WHITE] - mg[BLACK];
+    entry.scoreEg = eg[WHITE] - eg[BLACK];
+}
+
+int PawnTable::kingShelter(const Position& pos, PawnEntry* entry, Color c)
+{
+    Square ksq = pos.kingSquare(c);
+    if (entry->kingSquare[c] != ksq) {
+        entry->kingSquare[c] = ksq;
+        entry->kingShelter[c] = evaluateShelter(pos, c, ksq);
+    }
+    return entry->kingShelter[c];
+}
+
+int PawnTable::evaluateShelter(const Position& pos, Color c, Square ksq)
+{
+    // Judge the three files around the king, shifted inwards on the edge
+    int center = fileOf(ksq) < 1 ? 1 : (fileOf(ksq) > 6 ? 6 : fileOf(ksq));
+    Bitboard ourPawns = pos.pieces(c, PAWN) & (forwardRanksBB(c, ksq) | rankBB(rankOf(ksq)));
+    int shelter = 0;
+
+    for (int file = center - 1; file <= center + 1; ++file) {
+        Bitboard filePawns = ourPawns & fileBB(file);
+        if (!filePawns) {
+            shelter -= ShelterMissingPenalty;
+            continue;
+        }
+
+        // Nearest own pawn in front of the king on this file
+        Square pawn = c == WHITE ? lsb(filePawns) : msb(filePawns);
+        int distance = relativeRank(c, pawn) - relativeRank(c, ksq);
+        if (distance <= 1)
+            shelter += ShelterPawnNear;
+        else if (distance == 2)
+            shelter += ShelterPawnFar;
+    }
+    return shelter;
+}
@@ -0,0 +1,50 @@
+#ifndef PAWNTABLE_H
+#define PAWNTABLE_H
+
+#include <cstdint>
+#include <vector>
+#include "position.h"
+
+// Cached pawn-structure evaluation for one pawn configuration
+struct PawnEntry {
+    uint64_t key;
+    int scoreMg;               // Structure score, positive = good for white
+    int scoreEg;
+    Bitboard passedPawns[2];
+    Bitboard pawnAttacks[2];
+    int semiOpenFiles[2];      // Bit f set if color has no pawn on file f
+
+    // King shelter (a middlegame term) depends on the king square too, so it is cached lazily
+    Square kingSquare[2];
+    int kingShelter[2];
+};
+
+// Direct-mapped table keyed by Position::pawnKey(). Each search thread owns
+// its own table, so no locking is needed.
+class PawnTable {
+public:
+    explicit PawnTable(int sizeInEntries = 16384);
+
+    // Look up (or compute and store) the structure entry for this position
+    PawnEntry* probe(const Position& pos);
+
+    // Shelter score of c's king, using the entry's cached value when the king hasn't moved
+    int kingShelter(const Position& pos, PawnEntry* entry, Color c);
+
+    void clear();
+
+    uint64_t probes() const { return probeCount; }
+    uint64_t hits() const { return hitCount; }
+    void resetStats() { probeCount = hitCount = 0; }
+
+private:
+    std::vector<PawnEntry> table;
+    uint64_t mask;
+    uint64_t probeCount;
+    uint64_t hitCount;
+
+    void evaluateStructure(const Position& pos, PawnEntry& entry);
+    int evaluateShelter(const Position& pos, Color c, Square ksq);
+};
+
+#endif // PAWNTABLE_H
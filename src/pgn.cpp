@@ -0,0 +1,325 @@
+#include "pgn.h"
+#include "san.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+
+static bool isSpace(char c)
+{
+    return std::isspace(static_cast<unsigned char>(c)) != 0;
+}
+
+static bool isResult(std::string_view token)
+{
+    return token == "1-0" || token == "0-1" || token == "1/2-1/2" || token == "*";
+}
+
+PgnTokenizer::PgnTokenizer(const char* data, size_t size)
+    : begin(data), current(data), end(data + size), lineStart(true)
+{
+}
+
+PgnToken PgnTokenizer::next()
+{
+    while (current < end) {
+        char c = *current;
+        if (c == '\n') {
+            lineStart = true;
+            ++current;
+            continue;
+        }
+        if (isSpace(c)) {
+            ++current;
+            continue;
+        }
+        bool firstOnLine = lineStart;
+        lineStart = false;
+
+        // "%" lines are escapes for other programs
+        if (c == '%' && firstOnLine) {
+            while (current < end && *current != '\n')
+                ++current;
+            continue;
+        }
+
+        if (c == ';' || c == '{') {
+            const char* start = ++current;
+            char close = c == ';' ? '\n' : '}';
+            while (current < end && *current != close)
+                ++current;
+            std::string_view text(start, size_t(current - start));
+            if (current < end && close == '}')
+                ++current;
+            return {PGN_COMMENT, text, {}};
+        }
+
+        if (c == '(' || c == ')') {
+            ++current;
+            return {c == '(' ? PGN_VARIATION_START : PGN_VARIATION_END, {}, {}};
+        }
+
+        if (c == '[') {
+            // [Name "value"]; the value runs to the first unescaped quote
+            ++current;
+            while (current < end && (*current == ' ' || *current == '\t'))
+                ++current;
+            const char* nameStart = current;
+            while (current < end && !isSpace(*current) && *current != '"' && *current != ']')
+                ++current;
+            std::string_view name(nameStart, size_t(current - nameStart));
+
+            while (current < end && *current != '"' && *current != ']' && *current != '\n')
+                ++current;
+            std::string_view value;
+            if (current < end && *current == '"') {
+                const char* valueStart = ++current;
+                while (current < end && *current != '"' && *current != '\n')
+                    current += (*current == '\\' && current + 1 < end) ? 2 : 1;
+                value = std::string_view(valueStart, size_t(current - valueStart));
+            }
+            while (current < end && *current != ']' && *current != '\n')
+                ++current;
+            if (current < end && *current == ']')
+                ++current;
+            return {PGN_TAG, name, value};
+        }
+
+        if (c == ']' || c == '}') {
+            ++current; // Stray bracket
+            continue;
+        }
+
+        const char* start = current++;
+        if (c == '$') {
+            while (current < end && std::isdigit(static_cast<unsigned char>(*current)))
+                ++current;
+            return {PGN_NAG, std::string_view(start, size_t(current - start)), {}};
+        }
+
+        while (current < end && *current && !isSpace(*current) && !std::strchr("{}()[];$\"", *current))
+            ++current;
+        std::string_view token(start, size_t(current - start));
+
+        if (isResult(token))
+            return {PGN_RESULT, token, {}};
+        if (token[0] == '!' || token[0] == '?')
+            return {PGN_NAG, token, {}};
+
+        // Move numbers ("12.", "12...") may be glued to the move
+        size_t digits = 0;
+        while (digits < token.size() && std::isdigit(static_cast<unsigned char>(token[digits])))
+            ++digits;
+        if (digits == token.size())
+            continue; // Bare move number
+        if (token[digits] == '.' || digits == 0) {
+            while (digits < token.size() && token[digits] == '.')
+                ++digits;
+            token.remove_prefix(digits);
+        }
+        if (!token.empty())
+            return {PGN_MOVE, token, {}};
+    }
+    return {PGN_END, {}, {}};
+}
+
+void PgnGame::clear()
+{
+    tags.clear();
+    moves.clear();
+    result.clear();
+}
+
+std::string PgnGame::tag(const std::string& name) const
+{
+    for (const auto& t : tags) {
+        if (t.first == name)
+            return t.second;
+    }
+    return std::string();
+}
+
+PgnReader::PgnReader(const char* data, size_t size)
+    : tokenizer(data, size), hasPending(false)
+{
+}
+
+bool PgnReader::readGame(PgnGame& game)
+{
+    game.clear();
+    bool inMoves = false;
+    int depth = 0;
+
+    for (;;) {
+        PgnToken token = hasPending ? pending : tokenizer.next();
+        hasPending = false;
+
+        switch (token.type) {
+        case PGN_TAG:
+            if (inMoves) {
+                // Tags of the next game; this one had no result
+                pending = token;
+                hasPending = true;
+                game.result = game.tag("Result");
+                if (game.result.empty())
+                    game.result = "*";
+                return true;
+            } else {
+                std::string value;
+                for (size_t i = 0; i < token.value.size(); ++i) {
+                    if (token.value[i] == '\\' && i + 1 < token.value.size())
+                        ++i;
+                    value += token.value[i];
+                }
+                game.tags.emplace_back(std::string(token.text), value);
+            }
+            break;
+        case PGN_MOVE:
+            inMoves = true;
+            if (depth == 0)
+                game.moves.push_back(token.text);
+            break;
+        case PGN_VARIATION_START:
+            inMoves = true;
+            ++depth;
+            break;
+        case PGN_VARIATION_END:
+            if (depth > 0)
+                --depth;
+            break;
+        case PGN_RESULT:
+            if (depth == 0) {
+                game.result = std::string(token.text);
+                return true;
+            }
+            break;
+        case PGN_END:
+            if (game.tags.empty() && game.moves.empty())
+                return false;
+            game.result = game.tag("Result");
+            if (game.result.empty())
+                game.result = "*";
+            return true;
+        default:
+            break; // Comments and NAGs
+        }
+    }
+}
+
+size_t PgnReader::nextGameStart(const char* data, size_t size, size_t from)
+{
+    // A game starts with a tag line that does not follow another tag line
+    for (size_t i = from; i < size; ++i) {
+        if (data[i] != '[' || (i > 0 && data[i - 1] != '\n'))
+            continue;
+        if (i == 0)
+            return 0;
+
+        // Look at the start of the previous non-empty line
+        size_t j = i - 1;
+        while (j > 0 && (data[j - 1] == '\n' || data[j - 1] == '\r'))
+            --j;
+        size_t lineBegin = j;
+        while (lineBegin > 0 && data[lineBegin - 1] != '\n')
+            --lineBegin;
+        if (j == 0 || data[lineBegin] != '[')
+            return i;
+    }
+    return size;
+}
+
+void writePgnGame(std::ostream& out, const std::vector<std::pair<std::string, std::string>>& tags,
+                  const Position& start, const std::vector<PackedMove>& moves, const std::string& result,
+                  const std::vector<PgnNote>& notes)
+{
+    static const char* const roster[] = {"Event", "Site", "Date", "Round", "White", "Black", "Result"};
+
+    auto writeTag = [&out](const std::string& name, const std::string& value) {
+        out << '[' << name << " \"";
+        for (char c : value) {
+            if (c == '"' || c == '\\')
+                out << '\\';
+            out << c;
+        }
+        out << "\"]\n";
+    };
+    auto isRosterTag = [](const std::string& name) {
+        for (const char* r : roster) {
+            if (name == r)
+                return true;
+        }
+        return false;
+    };
+
+    for (const char* name : roster) {
+        std::string value = "?";
+        for (const auto& t : tags) {
+            if (t.first == name)
+                value = t.second;
+        }
+        writeTag(name, std::strcmp(name, "Result") == 0 ? result : value);
+    }
+    std::string startFen = start.fen();
+    bool setUp = startFen != START_FEN;
+    if (setUp) {
+        writeTag("SetUp", "1");
+        writeTag("FEN", startFen);
+    }
+    for (const auto& t : tags) {
+        if (!isRosterTag(t.first) && t.first != "SetUp" && t.first != "FEN")
+            writeTag(t.first, t.second);
+    }
+    out << '\n';
+
+    // Movetext, one word at a time so lines stay under 80 columns
+    size_t column = 0;
+    auto writeWord = [&out, &column](const char* word, size_t length) {
+        if (column > 0 && column + 1 + length > 79) {
+            out << '\n';
+            column = 0;
+        } else if (column > 0) {
+            out << ' ';
+            ++column;
+        }
+        out.write(word, std::streamsize(length));
+        column += length;
+    };
+
+    Position pos = start;
+    char word[SAN_MAX_LENGTH + 16];
+    bool annotated = false;
+    for (size_t i = 0; i < moves.size(); ++i) {
+        // Black's move gets its number again after an annotation
+        if (pos.sideToMove() == WHITE || i == 0 || annotated) {
+            int length = std::snprintf(word, sizeof(word), "%d.%s", pos.fullmoveNumber(),
+                                       pos.sideToMove() == WHITE ? "" : "..");
+            writeWord(word, size_t(length));
+        }
+        writeWord(word, size_t(writeSan(pos, moves[i], word)));
+        pos.makeMove(moves[i]);
+
+        annotated = false;
+        if (i < notes.size() && notes[i].nag > 0) {
+            int length = std::snprintf(word, sizeof(word), "$%d", notes[i].nag);
+            writeWord(word, size_t(length));
+            annotated = true;
+        }
+        if (i < notes.size() && !notes[i].comment.empty()) {
+            // Broken into words like the moves; a '}' would end it early
+            std::string text = "{" + notes[i].comment + "}";
+            std::replace(text.begin() + 1, text.end() - 1, '}', ')');
+            size_t from = 0;
+            while (from < text.size()) {
+                size_t to = text.find(' ', from);
+                if (to == std::string::npos)
+                    to = text.size();
+                if (to > from)
+                    writeWord(text.data() + from, to - from);
+                from = to + 1;
+            }
+            annotated = true;
+        }
+    }
+    writeWord(result.c_str(), result.size());
+    out << "\n\n";
+}
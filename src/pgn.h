@@ -0,0 +1,98 @@
+#ifndef PGN_H
+#define PGN_H
+
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "position.h"
+
+// Portable Game Notation.
+//
+// Reading works on PGN text held in memory, usually a mapped file: the
+// tokenizer hands out views into that text, so nothing is copied per move
+// and the views stay valid as long as the text does.
+
+enum PgnTokenType {
+    PGN_TAG,              // text = tag name, value = raw value (escapes kept)
+    PGN_MOVE,             // SAN as written, move numbers stripped
+    PGN_NAG,              // "$14", or a separate "!?"-style annotation
+    PGN_COMMENT,          // {...} or ; to the end of the line, without the delimiters
+    PGN_VARIATION_START,
+    PGN_VARIATION_END,
+    PGN_RESULT,           // "1-0", "0-1", "1/2-1/2" or "*"
+    PGN_END               // No more input
+};
+
+struct PgnToken {
+    PgnTokenType type;
+    std::string_view text;
+    std::string_view value;
+};
+
+class PgnTokenizer {
+public:
+    PgnTokenizer(const char* data, size_t size);
+
+    PgnToken next();
+
+    // Bytes consumed so far
+    size_t offset() const { return size_t(current - begin); }
+
+private:
+    const char* begin;
+    const char* current;
+    const char* end;
+    bool lineStart;
+};
+
+// One game: tag pairs and the main line. Comments, NAGs and variations are
+// skipped; moves are views into the text the game was read from.
+struct PgnGame {
+    std::vector<std::pair<std::string, std::string>> tags;
+    std::vector<std::string_view> moves;
+    std::string result; // "1-0", "0-1", "1/2-1/2" or "*"
+
+    void clear();
+    // Value of a tag, or "" if the game has none
+    std::string tag(const std::string& name) const;
+};
+
+// Reads games one after another
+class PgnReader {
+public:
+    PgnReader(const char* data, size_t size);
+
+    // Next game; false once the input is used up. Reusing one PgnGame keeps
+    // its buffers, so reading allocates nothing per move.
+    bool readGame(PgnGame& game);
+
+    // Bytes consumed so far
+    size_t offset() const { return tokenizer.offset(); }
+
+    // First game start at or after position from (for splitting a file
+    // into pieces that can be read in parallel)
+    static size_t nextGameStart(const char* data, size_t size, size_t from);
+
+private:
+    PgnTokenizer tokenizer;
+    PgnToken pending;
+    bool hasPending;
+};
+
+// Annotation of one move: a numeric annotation glyph ($2 is "?") and a comment
+struct PgnNote {
+    int nag;             // 0 = none
+    std::string comment; // "" = none
+};
+
+// Write one game: the seven standard tags first ("?" where missing), then
+// the other tags, then the moves from start as SAN, wrapped at 80 columns.
+// SetUp and FEN tags are added when start is not the initial position.
+// notes, if given, has one entry per move, written after it.
+void writePgnGame(std::ostream& out, const std::vector<std::pair<std::string, std::string>>& tags,
+                  const Position& start, const std::vector<PackedMove>& moves, const std::string& result,
+                  const std::vector<PgnNote>& notes = std::vector<PgnNote>());
+
+#endif // PGN_H
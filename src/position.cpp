@@ -0,0 +1,561 @@
+#include "position.h"
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+
+uint64_t Zobrist::psq[12][64];
+uint64_t Zobrist::castling[16];
+uint64_t Zobrist::enPassant[8];
+uint64_t Zobrist::side;
+
+// Castling rights lost when a piece moves from or to a square
+static int castlingRightsMask[64];
+
+static void initZobrist()
+{
+    // splitmix64 with a fixed seed so keys are identical in every run
+    uint64_t seed = 0x1B873593C2B2AE35ULL;
+    auto next = [&seed]() {
+        uint64_t z = (seed += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    };
+
+    for (int p = 0; p < 12; ++p)
+        for (int s = 0; s < 64; ++s)
+            Zobrist::psq[p][s] = next();
+    for (int cr = 0; cr < 16; ++cr)
+        Zobrist::castling[cr] = next();
+    for (int f = 0; f < 8; ++f)
+        Zobrist::enPassant[f] = next();
+    Zobrist::side = next();
+
+    for (int s = 0; s < 64; ++s)
+        castlingRightsMask[s] = ALL_CASTLING;
+    castlingRightsMask[E1] &= ~(WHITE_OO | WHITE_OOO);
+    castlingRightsMask[H1] &= ~WHITE_OO;
+    castlingRightsMask[A1] &= ~WHITE_OOO;
+    castlingRightsMask[E8] &= ~(BLACK_OO | BLACK_OOO);
+    castlingRightsMask[H8] &= ~BLACK_OO;
+    castlingRightsMask[A8] &= ~BLACK_OOO;
+}
+
+Position::Position()
+{
+    static std::once_flag once;
+    initBitboards();
+    std::call_once(once, initZobrist);
+
+    // Enough for any real game, so makeMove never reallocates mid-search
+    states.reserve(1024);
+    setStartPosition();
+}
+
+Position::Position(const Position& other)
+{
+    states.reserve(1024);
+    *this = other;
+}
+
+Position& Position::operator=(const Position& other)
+{
+    if (this == &other) return *this;
+    for (int i = 0; i < 6; ++i) byType[i] = other.byType[i];
+    byColor[WHITE] = other.byColor[WHITE];
+    byColor[BLACK] = other.byColor[BLACK];
+    for (int s = 0; s < 64; ++s) board[s] = other.board[s];
+    side = other.side;
+    gamePly = other.gamePly;
+    // Assigning keeps our own (reserved) capacity instead of the source's
+    states.assign(other.states.begin(), other.states.end());
+    return *this;
+}
+
+void Position::clearBoard()
+{
+    for (int i = 0; i < 6; ++i) byType[i] = 0;
+    byColor[WHITE] = byColor[BLACK] = 0;
+    for (int s = 0; s < 64; ++s) board[s] = NO_PIECE;
+    side = WHITE;
+    gamePly = 0;
+    states.clear();
+    states.push_back(StateInfo());
+    StateInfo& s = st();
+    s.key = s.pawnKey = 0;
+    s.checkers = 0;
+    s.castlingRights = 0;
+    s.epSquare = NO_SQUARE;
+    s.halfmoveClock = 0;
+    s.pliesFromNull = 0;
+    s.captured = NO_PIECE;
+    s.dirtyCount = 0;
+}
+
+void Position::setStartPosition()
+{
+    static const PieceType backRank[8] = {ROOK, KNIGHT, BISHOP, QUEEN, KING, BISHOP, KNIGHT, ROOK};
+
+    clearBoard();
+    for (int f = 0; f < 8; ++f) {
+        putPiece(makePiece(WHITE, backRank[f]), makeSquare(f, 0));
+        putPiece(W_PAWN, makeSquare(f, 1));
+        putPiece(B_PAWN, makeSquare(f, 6));
+        putPiece(makePiece(BLACK, backRank[f]), makeSquare(f, 7));
+    }
+    st().castlingRights = ALL_CASTLING;
+    computeKeys();
+}
+
+void Position::setPosition(const Piece squares[64], Color sideToMove, int castling,
+                           Square enPassant, int halfmoveClock, int fullmoveNumber)
+{
+    clearBoard();
+    for (int s = 0; s < 64; ++s) {
+        if (squares[s] != NO_PIECE)
+            putPiece(squares[s], Square(s));
+    }
+    side = sideToMove;
+    gamePly = 2 * (std::max(fullmoveNumber, 1) - 1) + (side == BLACK);
+
+    StateInfo& s = st();
+    s.castlingRights = castling & ALL_CASTLING;
+    s.halfmoveClock = halfmoveClock;
+    if (enPassant != NO_SQUARE && (PawnAttacks[~side][enPassant] & pieces(side, PAWN)))
+        s.epSquare = enPassant;
+    computeKeys();
+}
+
+static const char PieceLetters[] = "PNBRQKpnbrqk";
+
+static void skipSpaces(const char*& c)
+{
+    while (*c == ' ' || *c == '\t')
+        ++c;
+}
+
+static bool readNumber(const char*& c, int& value)
+{
+    if (*c < '0' || *c > '9')
+        return false;
+    value = 0;
+    while (*c >= '0' && *c <= '9' && value < 100000000)
+        value = value * 10 + (*c++ - '0');
+    return *c == 0 || *c == ' ' || *c == '\t';
+}
+
+static char* writeNumber(char* out, int value)
+{
+    char digits[12];
+    int n = 0;
+    do {
+        digits[n++] = char('0' + value % 10);
+        value /= 10;
+    } while (value > 0);
+    while (n > 0)
+        *out++ = digits[--n];
+    return out;
+}
+
+// Is the king of color c attacked on this board?
+static bool kingAttacked(const Piece squares[64], Color c)
+{
+    Bitboard byPiece[12] = {};
+    Bitboard occupied = 0;
+    for (int s = 0; s < 64; ++s) {
+        if (squares[s] != NO_PIECE) {
+            byPiece[squares[s]] |= squareBB(Square(s));
+            occupied |= squareBB(Square(s));
+        }
+    }
+    Color them = ~c;
+    Square king = lsb(byPiece[makePiece(c, KING)]);
+    Bitboard queens = byPiece[makePiece(them, QUEEN)];
+    return (PawnAttacks[c][king] & byPiece[makePiece(them, PAWN)])
+        || (KnightAttacks[king] & byPiece[makePiece(them, KNIGHT)])
+        || (KingAttacks[king] & byPiece[makePiece(them, KING)])
+        || (bishopAttacks(king, occupied) & (byPiece[makePiece(them, BISHOP)] | queens))
+        || (rookAttacks(king, occupied) & (byPiece[makePiece(them, ROOK)] | queens));
+}
+
+bool Position::setFen(const char* fen)
+{
+    Piece squares[64];
+    std::fill(squares, squares + 64, NO_PIECE);
+    const char* c = fen;
+    skipSpaces(c);
+
+    // Piece placement from rank 8 down
+    int rank = 7, file = 0;
+    int count[12] = {};
+    for (; *c && *c != ' '; ++c) {
+        if (*c == '/') {
+            if (file != 8 || rank == 0)
+                return false;
+            --rank;
+            file = 0;
+        } else if (*c >= '1' && *c <= '8') {
+            file += *c - '0';
+            if (file > 8)
+                return false;
+        } else {
+            const char* letter = std::strchr(PieceLetters, *c);
+            if (!letter || file > 7)
+                return false;
+            Piece p = Piece(letter - PieceLetters);
+            if (typeOf(p) == PAWN && (rank == 0 || rank == 7))
+                return false;
+            squares[makeSquare(file++, rank)] = p;
+            ++count[p];
+        }
+    }
+    if (rank != 0 || file != 8)
+        return false;
+    for (int color = WHITE; color <= BLACK; ++color) {
+        int pieces = 0;
+        for (int pt = PAWN; pt <= KING; ++pt)
+            pieces += count[makePiece(Color(color), PieceType(pt))];
+        if (count[makePiece(Color(color), KING)] != 1 || count[makePiece(Color(color), PAWN)] > 8 || pieces > 16)
+            return false;
+    }
+
+    // Side to move; the other king may not be in check
+    skipSpaces(c);
+    if (*c != 'w' && *c != 'b')
+        return false;
+    Color us = *c++ == 'w' ? WHITE : BLACK;
+    if (kingAttacked(squares, ~us))
+        return false;
+
+    // Castling rights, kept only with king and rook at home
+    skipSpaces(c);
+    int castling = 0;
+    if (*c == '-') {
+        ++c;
+    } else {
+        for (; *c && *c != ' '; ++c) {
+            const char* letter = std::strchr("KQkq", *c);
+            if (!letter)
+                return false;
+            castling |= 1 << (letter - "KQkq");
+        }
+    }
+    if (squares[E1] != W_KING || squares[H1] != W_ROOK) castling &= ~WHITE_OO;
+    if (squares[E1] != W_KING || squares[A1] != W_ROOK) castling &= ~WHITE_OOO;
+    if (squares[E8] != B_KING || squares[H8] != B_ROOK) castling &= ~BLACK_OO;
+    if (squares[E8] != B_KING || squares[A8] != B_ROOK) castling &= ~BLACK_OOO;
+
+    // En passant target, kept only behind a pawn that just moved two squares
+    skipSpaces(c);
+    Square ep = NO_SQUARE;
+    if (*c == '-') {
+        ++c;
+    } else {
+        if (c[0] < 'a' || c[0] > 'h' || c[1] != (us == WHITE ? '6' : '3'))
+            return false;
+        ep = makeSquare(c[0] - 'a', c[1] - '1');
+        Square pushed = Square(us == WHITE ? ep - 8 : ep + 8);
+        if (squares[pushed] != makePiece(~us, PAWN) || squares[ep] != NO_PIECE)
+            ep = NO_SQUARE;
+        c += 2;
+    }
+
+    // Optional move counters
+    int halfmove = 0, fullmove = 1;
+    skipSpaces(c);
+    if (*c) {
+        if (!readNumber(c, halfmove))
+            return false;
+        skipSpaces(c);
+        if (*c && !readNumber(c, fullmove))
+            return false;
+        skipSpaces(c);
+        if (*c)
+            return false;
+    }
+
+    setPosition(squares, us, castling, ep, halfmove, fullmove);
+    return true;
+}
+
+int Position::writeFen(char* buffer) const
+{
+    char* out = buffer;
+    for (int rank = 7; rank >= 0; --rank) {
+        int emptyRun = 0;
+        for (int file = 0; file < 8; ++file) {
+            Piece p = board[makeSquare(file, rank)];
+            if (p == NO_PIECE) {
+                ++emptyRun;
+                continue;
+            }
+            if (emptyRun > 0)
+                *out++ = char('0' + emptyRun);
+            emptyRun = 0;
+            *out++ = PieceLetters[p];
+        }
+        if (emptyRun > 0)
+            *out++ = char('0' + emptyRun);
+        if (rank > 0)
+            *out++ = '/';
+    }
+
+    *out++ = ' ';
+    *out++ = side == WHITE ? 'w' : 'b';
+    *out++ = ' ';
+    int rights = castlingRights();
+    if (!rights)
+        *out++ = '-';
+    for (int i = 0; i < 4; ++i) {
+        if (rights & (1 << i))
+            *out++ = "KQkq"[i];
+    }
+    *out++ = ' ';
+    if (epSquare() == NO_SQUARE) {
+        *out++ = '-';
+    } else {
+        *out++ = char('a' + fileOf(epSquare()));
+        *out++ = char('1' + rankOf(epSquare()));
+    }
+    *out++ = ' ';
+    out = writeNumber(out, halfmoveClock());
+    *out++ = ' ';
+    out = writeNumber(out, fullmoveNumber());
+    *out = 0;
+    return int(out - buffer);
+}
+
+std::string Position::fen() const
+{
+    char buffer[FEN_MAX_LENGTH];
+    int length = writeFen(buffer);
+    return std::string(buffer, length);
+}
+
+void Position::computeKeys()
+{
+    StateInfo& s = st();
+    s.key = s.pawnKey = 0;
+    for (Bitboard b = pieces(); b;) {
+        Square sq = popLsb(b);
+        s.key ^= Zobrist::psq[board[sq]][sq];
+        if (typeOf(board[sq]) == PAWN)
+            s.pawnKey ^= Zobrist::psq[board[sq]][sq];
+    }
+    s.key ^= Zobrist::castling[s.castlingRights];
+    if (s.epSquare != NO_SQUARE)
+        s.key ^= Zobrist::enPassant[fileOf(s.epSquare)];
+    if (side == BLACK)
+        s.key ^= Zobrist::side;
+    s.checkers = attackersTo(kingSquare(side), pieces()) & pieces(~side);
+}
+
+void Position::putPiece(Piece p, Square s)
+{
+    board[s] = p;
+    byType[typeOf(p)] |= squareBB(s);
+    byColor[colorOf(p)] |= squareBB(s);
+}
+
+void Position::removePiece(Square s)
+{
+    Piece p = board[s];
+    byType[typeOf(p)] ^= squareBB(s);
+    byColor[colorOf(p)] ^= squareBB(s);
+    board[s] = NO_PIECE;
+}
+
+void Position::movePiece(Square from, Square to)
+{
+    Piece p = board[from];
+    Bitboard fromTo = squareBB(from) | squareBB(to);
+    byType[typeOf(p)] ^= fromTo;
+    byColor[colorOf(p)] ^= fromTo;
+    board[from] = NO_PIECE;
+    board[to] = p;
+}
+
+Bitboard Position::attackersTo(Square s, Bitboard occupied) const
+{
+    return (PawnAttacks[BLACK][s] & pieces(WHITE, PAWN))
+         | (PawnAttacks[WHITE][s] & pieces(BLACK, PAWN))
+         | (KnightAttacks[s] & byType[KNIGHT])
+         | (rookAttacks(s, occupied) & (byType[ROOK] | byType[QUEEN]))
+         | (bishopAttacks(s, occupied) & (byType[BISHOP] | byType[QUEEN]))
+         | (KingAttacks[s] & byType[KING]);
+}
+
+bool Position::isAttacked(Square s, Color by) const
+{
+    return (PawnAttacks[~by][s] & pieces(by, PAWN))
+        || (KnightAttacks[s] & pieces(by, KNIGHT))
+        || (KingAttacks[s] & pieces(by, KING))
+        || (rookAttacks(s, pieces()) & pieces(by, ROOK, QUEEN))
+        || (bishopAttacks(s, pieces()) & pieces(by, BISHOP, QUEEN));
+}
+
+int Position::repetitionCount() const
+{
+    // Only positions since the last irreversible move can repeat, and only
+    // with the same side to move
+    int end = std::min(st().halfmoveClock, st().pliesFromNull);
+    int count = 0;
+    int last = int(states.size()) - 1;
+    for (int i = 4; i <= end && last - i >= 0; i += 2) {
+        if (states[last - i].key == st().key)
+            ++count;
+    }
+    return count;
+}
+
+bool Position::isRepetition() const
+{
+    int end = std::min(st().halfmoveClock, st().pliesFromNull);
+    int last = int(states.size()) - 1;
+    for (int i = 4; i <= end && last - i >= 0; i += 2) {
+        if (states[last - i].key == st().key)
+            return true;
+    }
+    return false;
+}
+
+bool Position::hasInsufficientMaterial() const
+{
+    if (byType[PAWN] | byType[ROOK] | byType[QUEEN])
+        return false;
+
+    // KvK, a single minor piece, or only bishops all on one square colour
+    Bitboard minors = byType[KNIGHT] | byType[BISHOP];
+    if (!moreThanOne(minors))
+        return true;
+
+    const Bitboard darkSquares = 0xAA55AA55AA55AA55ULL;
+    return !byType[KNIGHT] && (!(byType[BISHOP] & darkSquares) || !(byType[BISHOP] & ~darkSquares));
+}
+
+void Position::makeMove(PackedMove m)
+{
+    Color us = side, them = ~side;
+    Square from = moveFrom(m), to = moveTo(m);
+    int flags = moveFlags(m);
+    Piece pc = board[from];
+
+    // Copy the fields that carry over, then update them incrementally
+    states.push_back(st());
+    StateInfo& s = st();
+    s.halfmoveClock++;
+    s.pliesFromNull++;
+    s.captured = NO_PIECE;
+    s.dirtyCount = 1;
+    s.dirty[0] = DirtyPiece{pc, from, to};
+    gamePly++;
+
+    if (s.epSquare != NO_SQUARE) {
+        s.key ^= Zobrist::enPassant[fileOf(s.epSquare)];
+        s.epSquare = NO_SQUARE;
+    }
+
+    if (flags == KING_CASTLE || flags == QUEEN_CASTLE) {
+        Square rookFrom = flags == KING_CASTLE ? Square(to + 1) : Square(to - 2);
+        Square rookTo = flags == KING_CASTLE ? Square(to - 1) : Square(to + 1);
+        Piece rook = board[rookFrom];
+        movePiece(rookFrom, rookTo);
+        s.key ^= Zobrist::psq[rook][rookFrom] ^ Zobrist::psq[rook][rookTo];
+        s.dirty[s.dirtyCount++] = DirtyPiece{rook, rookFrom, rookTo};
+    }
+
+    if (flags & CAPTURE) {
+        Square capSq = flags == EP_CAPTURE ? Square(to ^ 8) : to;
+        Piece captured = board[capSq];
+        removePiece(capSq);
+        s.key ^= Zobrist::psq[captured][capSq];
+        if (typeOf(captured) == PAWN)
+            s.pawnKey ^= Zobrist::psq[captured][capSq];
+        s.captured = captured;
+        s.halfmoveClock = 0;
+        s.dirty[s.dirtyCount++] = DirtyPiece{captured, capSq, NO_SQUARE};
+    }
+
+    movePiece(from, to);
+    s.key ^= Zobrist::psq[pc][from] ^ Zobrist::psq[pc][to];
+
+    if (typeOf(pc) == PAWN) {
+        s.halfmoveClock = 0;
+        s.pawnKey ^= Zobrist::psq[pc][from];
+
+        if (flags & PROMOTION) {
+            Piece promoted = makePiece(us, promotionType(m));
+            removePiece(to);
+            putPiece(promoted, to);
+            s.key ^= Zobrist::psq[pc][to] ^ Zobrist::psq[promoted][to];
+            s.dirty[0].to = NO_SQUARE;
+            s.dirty[s.dirtyCount++] = DirtyPiece{promoted, NO_SQUARE, to};
+        } else {
+            s.pawnKey ^= Zobrist::psq[pc][to];
+
+            // Only record the en passant square if a capture is actually possible,
+            // so transpositions and repetitions hash identically
+            if (flags == DOUBLE_PUSH && (PawnAttacks[us][to ^ 8] & pieces(them, PAWN))) {
+                s.epSquare = Square(to ^ 8);
+                s.key ^= Zobrist::enPassant[fileOf(s.epSquare)];
+            }
+        }
+    }
+
+    int newRights = s.castlingRights & castlingRightsMask[from] & castlingRightsMask[to];
+    if (newRights != s.castlingRights) {
+        s.key ^= Zobrist::castling[s.castlingRights] ^ Zobrist::castling[newRights];
+        s.castlingRights = newRights;
+    }
+
+    side = them;
+    s.key ^= Zobrist::side;
+    s.checkers = attackersTo(kingSquare(them), pieces()) & pieces(us);
+}
+
+void Position::unmakeMove(PackedMove m)
+{
+    Square from = moveFrom(m), to = moveTo(m);
+    int flags = moveFlags(m);
+    Piece captured = st().captured;
+
+    side = ~side;
+    gamePly--;
+
+    if (flags & PROMOTION) {
+        removePiece(to);
+        putPiece(makePiece(side, PAWN), to);
+    }
+
+    movePiece(to, from);
+
+    if (flags == KING_CASTLE || flags == QUEEN_CASTLE) {
+        Square rookFrom = flags == KING_CASTLE ? Square(to + 1) : Square(to - 2);
+        Square rookTo = flags == KING_CASTLE ? Square(to - 1) : Square(to + 1);
+        movePiece(rookTo, rookFrom);
+    }
+
+    if (captured != NO_PIECE)
+        putPiece(captured, flags == EP_CAPTURE ? Square(to ^ 8) : to);
+
+    states.pop_back();
+}
+
+std::string squareName(Square s)
+{
+    return std::string{char('a' + fileOf(s)), char('1' + rankOf(s))};
+}
+
+char pieceToChar(Piece p)
+{
+    return p == NO_PIECE ? ' ' : "PNBRQKpnbrqk"[p];
+}
+
+std::string moveToUci(PackedMove m)
+{
+    if (m == NO_MOVE) return "0000";
+    std::string uci = squareName(moveFrom(m)) + squareName(moveTo(m));
+    if (isPromotionMove(m))
+        uci += "nbrq"[promotionType(m) - KNIGHT];
+    return uci;
+}
@@ -0,0 +1,172 @@
+#ifndef POSITION_H
+#define POSITION_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "bitboard.h"
+
+// Compact 16-bit move: bits 0-5 from, 6-11 to, 12-15 flags
+typedef uint16_t PackedMove;
+const PackedMove NO_MOVE = 0;
+
+enum MoveFlag {
+    QUIET = 0,
+    DOUBLE_PUSH = 1,
+    KING_CASTLE = 2,
+    QUEEN_CASTLE = 3,
+    CAPTURE = 4,
+    EP_CAPTURE = 5,
+    PROMOTION = 8,          // + (promoted type - KNIGHT), + CAPTURE for capture-promotions
+    PROMO_KNIGHT = 8,
+    PROMO_BISHOP = 9,
+    PROMO_ROOK = 10,
+    PROMO_QUEEN = 11
+};
+
+inline PackedMove makePackedMove(Square from, Square to, int flags = QUIET)
+{
+    return PackedMove(from | (to << 6) | (flags << 12));
+}
+inline Square moveFrom(PackedMove m) { return Square(m & 63); }
+inline Square moveTo(PackedMove m) { return Square((m >> 6) & 63); }
+inline int moveFlags(PackedMove m) { return m >> 12; }
+inline bool isCaptureMove(PackedMove m) { return moveFlags(m) & CAPTURE; }
+inline bool isPromotionMove(PackedMove m) { return moveFlags(m) & PROMOTION; }
+inline bool isCastlingMove(PackedMove m) { return moveFlags(m) == KING_CASTLE || moveFlags(m) == QUEEN_CASTLE; }
+inline PieceType promotionType(PackedMove m) { return PieceType(KNIGHT + (moveFlags(m) & 3)); }
+
+enum CastlingRight {
+    WHITE_OO = 1,
+    WHITE_OOO = 2,
+    BLACK_OO = 4,
+    BLACK_OOO = 8,
+    ALL_CASTLING = 15
+};
+
+// Zobrist keys, shared by every position
+struct Zobrist {
+    static uint64_t psq[12][64];
+    static uint64_t castling[16];
+    static uint64_t enPassant[8];
+    static uint64_t side;
+};
+
+// A piece that appeared (from == NO_SQUARE), vanished (to == NO_SQUARE) or moved
+struct DirtyPiece {
+    Piece piece;
+    Square from;
+    Square to;
+};
+
+const char* const START_FEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+const int FEN_MAX_LENGTH = 128;
+
+// Everything needed to take a move back, pushed by makeMove()
+struct StateInfo {
+    uint64_t key;
+    uint64_t pawnKey;
+    Bitboard checkers;
+    int castlingRights;
+    Square epSquare;
+    int halfmoveClock;
+    int pliesFromNull;
+    Piece captured;
+
+    // Board changes made by the move that led here, for incremental evaluators
+    int dirtyCount;
+    DirtyPiece dirty[3];
+};
+
+class Position {
+public:
+    Position();
+    Position(const Position& other);
+    Position& operator=(const Position& other);
+
+    // Reset to the standard initial position
+    void setStartPosition();
+
+    // Set up an arbitrary position from a square-indexed board. The caller
+    // makes sure it is legal; an en passant square is kept only if a pawn
+    // can actually capture there.
+    void setPosition(const Piece squares[64], Color sideToMove, int castling = 0,
+                     Square enPassant = NO_SQUARE, int halfmoveClock = 0, int fullmoveNumber = 1);
+
+    // Forsyth-Edwards Notation. setFen() accepts the four- or six-field form
+    // and leaves the position untouched (returning false) if the text is not
+    // a legal position; castling rights without their king and rook are dropped.
+    bool setFen(const char* fen);
+    bool setFen(const std::string& fen) { return setFen(fen.c_str()); }
+    // Writes a terminated FEN into buffer, which needs FEN_MAX_LENGTH bytes;
+    // returns its length
+    int writeFen(char* buffer) const;
+    std::string fen() const;
+
+    // Board access
+    Piece pieceOn(Square s) const { return board[s]; }
+    bool empty(Square s) const { return board[s] == NO_PIECE; }
+    Bitboard pieces() const { return byColor[WHITE] | byColor[BLACK]; }
+    Bitboard pieces(Color c) const { return byColor[c]; }
+    Bitboard pieces(PieceType pt) const { return byType[pt]; }
+    Bitboard pieces(Color c, PieceType pt) const { return byColor[c] & byType[pt]; }
+    Bitboard pieces(Color c, PieceType a, PieceType b) const { return byColor[c] & (byType[a] | byType[b]); }
+    Square kingSquare(Color c) const { return lsb(pieces(c, KING)); }
+
+    // Game state
+    Color sideToMove() const { return side; }
+    int castlingRights() const { return st().castlingRights; }
+    Square epSquare() const { return st().epSquare; }
+    int halfmoveClock() const { return st().halfmoveClock; }
+    int fullmoveNumber() const { return 1 + (gamePly - (side == BLACK)) / 2; }
+    int plyCount() const { return gamePly; }
+    uint64_t key() const { return st().key; }
+    uint64_t pawnKey() const { return st().pawnKey; }
+    Piece capturedPiece() const { return st().captured; }
+
+    // Move history access for incremental evaluators: state 0 is the root of
+    // the stored history, stateCount() - 1 is the current position
+    int stateCount() const { return int(states.size()); }
+    const StateInfo& state(int index) const { return states[index]; }
+
+    // Attack queries
+    Bitboard checkers() const { return st().checkers; }
+    bool inCheck() const { return st().checkers != 0; }
+    Bitboard attackersTo(Square s, Bitboard occupied) const;
+    bool isAttacked(Square s, Color by) const;
+    bool isCapture(PackedMove m) const { return isCaptureMove(m); }
+
+    // Draw rules that don't need move generation
+    bool isRepetition() const;        // Current position occurred before (search draw)
+    int repetitionCount() const;      // Earlier occurrences of the current position
+    bool hasInsufficientMaterial() const;
+
+    // Apply / take back a legal move
+    void makeMove(PackedMove m);
+    void unmakeMove(PackedMove m);
+
+private:
+    Bitboard byType[6];
+    Bitboard byColor[2];
+    Piece board[64];
+    Color side;
+    int gamePly;
+    std::vector<StateInfo> states;
+
+    const StateInfo& st() const { return states.back(); }
+    StateInfo& st() { return states.back(); }
+
+    void clearBoard();
+    void putPiece(Piece p, Square s);
+    void removePiece(Square s);
+    void movePiece(Square from, Square to);
+    void computeKeys();
+};
+
+// Coordinate helpers ("e4", "e2e4", "e7e8q")
+std::string squareName(Square s);
+// FEN-style piece letter ('P', 'n', ...), or ' ' for NO_PIECE
+char pieceToChar(Piece p);
+std::string moveToUci(PackedMove m);
+
+#endif // POSITION_H
@@ -0,0 +1,161 @@
+#include "san.h"
+#include "movegen.h"
+
+static const char PieceLetter[6] = {'P', 'N', 'B', 'R', 'Q', 'K'};
+
+static PieceType pieceFromLetter(char c)
+{
+    switch (c) {
+    case 'N': return KNIGHT;
+    case 'B': return BISHOP;
+    case 'R': return ROOK;
+    case 'Q': return QUEEN;
+    case 'K': return KING;
+    default:  return PAWN;
+    }
+}
+
+int writeSan(Position& pos, PackedMove move, char* buffer)
+{
+    char* out = buffer;
+    Square from = moveFrom(move), to = moveTo(move);
+    PieceType type = typeOf(pos.pieceOn(from));
+    Color us = pos.sideToMove();
+
+    if (isCastlingMove(move)) {
+        const char* text = moveFlags(move) == KING_CASTLE ? "O-O" : "O-O-O";
+        while (*text)
+            *out++ = *text++;
+    } else if (type == PAWN) {
+        if (isCaptureMove(move)) {
+            *out++ = char('a' + fileOf(from));
+            *out++ = 'x';
+        }
+        *out++ = char('a' + fileOf(to));
+        *out++ = char('1' + rankOf(to));
+        if (isPromotionMove(move)) {
+            *out++ = '=';
+            *out++ = PieceLetter[promotionType(move)];
+        }
+    } else {
+        *out++ = PieceLetter[type];
+
+        // Other pieces of the same kind that can legally reach the square;
+        // a pinned one only can if the square is on its pin line
+        Bitboard others = pieceAttacks(type, to, pos.pieces()) & pos.pieces(us, type) & ~squareBB(from);
+        if (type != KING && others) {
+            Square king = pos.kingSquare(us);
+            for (Bitboard pinned = others & pinnedPieces(pos, us); pinned;) {
+                Square s = popLsb(pinned);
+                if (!aligned(king, s, to))
+                    others &= ~squareBB(s);
+            }
+        } else {
+            others = 0;
+        }
+        if (others) {
+            bool fileUnique = !(others & (FILE_A_BB << fileOf(from)));
+            bool rankUnique = !(others & (RANK_1_BB << (8 * rankOf(from))));
+            if (fileUnique || !rankUnique)
+                *out++ = char('a' + fileOf(from));
+            if (!fileUnique)
+                *out++ = char('1' + rankOf(from));
+        }
+
+        if (isCaptureMove(move))
+            *out++ = 'x';
+        *out++ = char('a' + fileOf(to));
+        *out++ = char('1' + rankOf(to));
+    }
+
+    pos.makeMove(move);
+    if (pos.inCheck()) {
+        MoveList replies;
+        generateLegalMoves(pos, replies);
+        *out++ = replies.empty() ? '#' : '+';
+    }
+    pos.unmakeMove(move);
+
+    *out = 0;
+    return int(out - buffer);
+}
+
+std::string moveToSan(const Position& pos, PackedMove move)
+{
+    Position copy = pos;
+    char buffer[SAN_MAX_LENGTH];
+    int length = writeSan(copy, move, buffer);
+    return std::string(buffer, length);
+}
+
+PackedMove parseSan(const Position& pos, std::string_view s)
+{
+    // Drop check marks and annotations
+    while (!s.empty() && (s.back() == '+' || s.back() == '#' || s.back() == '!' || s.back() == '?'))
+        s.remove_suffix(1);
+    if (s.empty())
+        return NO_MOVE;
+
+    MoveList list;
+    generateLegalMoves(pos, list);
+
+    if (s == "O-O" || s == "0-0" || s == "O-O-O" || s == "0-0-0") {
+        int flag = s.size() == 3 ? KING_CASTLE : QUEEN_CASTLE;
+        for (PackedMove m : list)
+            if (moveFlags(m) == flag)
+                return m;
+        return NO_MOVE;
+    }
+
+    PieceType type = PAWN;
+    size_t i = 0;
+    if (s[0] >= 'A' && s[0] <= 'Z') {
+        type = pieceFromLetter(s[0]);
+        if (type == PAWN)
+            return NO_MOVE;
+        i = 1;
+    }
+
+    // Promotion suffix, "=Q" or just "Q"
+    PieceType promotion = PAWN;
+    if (type == PAWN && s.size() > 2 && pieceFromLetter(s.back()) != PAWN) {
+        promotion = pieceFromLetter(s.back());
+        s.remove_suffix(1);
+        if (s.back() == '=')
+            s.remove_suffix(1);
+    }
+
+    // What is left is [from file][from rank][x]<to square>
+    if (s.size() < i + 2)
+        return NO_MOVE;
+    int toFile = s[s.size() - 2] - 'a', toRank = s[s.size() - 1] - '1';
+    if (toFile < 0 || toFile > 7 || toRank < 0 || toRank > 7)
+        return NO_MOVE;
+    Square to = makeSquare(toFile, toRank);
+
+    int fromFile = -1, fromRank = -1;
+    for (size_t j = i; j + 2 < s.size(); ++j) {
+        char c = s[j];
+        if (c >= 'a' && c <= 'h')
+            fromFile = c - 'a';
+        else if (c >= '1' && c <= '8')
+            fromRank = c - '1';
+        else if (c != 'x' && c != ':' && c != '-')
+            return NO_MOVE;
+    }
+
+    PackedMove found = NO_MOVE;
+    for (PackedMove m : list) {
+        Square from = moveFrom(m);
+        if (moveTo(m) != to || isCastlingMove(m) || typeOf(pos.pieceOn(from)) != type)
+            continue;
+        if ((fromFile >= 0 && fileOf(from) != fromFile) || (fromRank >= 0 && rankOf(from) != fromRank))
+            continue;
+        if (isPromotionMove(m) ? promotionType(m) != promotion : promotion != PAWN)
+            continue;
+        if (found != NO_MOVE)
+            return NO_MOVE; // Ambiguous
+        found = m;
+    }
+    return found;
+}
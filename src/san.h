@@ -0,0 +1,24 @@
+#ifndef SAN_H
+#define SAN_H
+
+#include <string>
+#include <string_view>
+#include "position.h"
+
+// Standard algebraic notation ("Nbd7", "exd5", "O-O", "e8=Q+")
+
+// Longest SAN plus the terminating zero ("Qa1xb2=Q+" would be the worst)
+const int SAN_MAX_LENGTH = 12;
+
+// Write the SAN of a legal move into buffer, which needs SAN_MAX_LENGTH
+// bytes; returns its length. The move is made and taken back to find check
+// and mate, so pos is unchanged afterwards.
+int writeSan(Position& pos, PackedMove move, char* buffer);
+std::string moveToSan(const Position& pos, PackedMove move);
+
+// Find the legal move a SAN string describes, or NO_MOVE if it describes
+// none or more than one. Check marks and annotations ("+", "#", "!?") are
+// ignored; "0-0" and promotions without '=' are accepted too.
+PackedMove parseSan(const Position& pos, std::string_view san);
+
+#endif // SAN_H
@@ -0,0 +1,497 @@
+#include "tablebase.h"
+#include "movegen.h"
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+
+static const char TbMagic[8] = {'C', 'B', 'T', 'B', '1', 0, 0, 0};
+static const int TbHeaderSize = 64;
+
+// Pawns never stand on the first or last rank
+static const Bitboard PawnSquares = ~(RANK_1_BB | RANK_8_BB);
+
+// Canonical king placements: kingIndex[white][black], or -1 if not canonical
+struct KingPairs {
+    int16_t index[64][64];
+    std::vector<Square> white, black;
+};
+static KingPairs kingPairs[2]; // [has pawns]
+
+static bool onDiagonal(Square s) { return rankOf(s) == fileOf(s); }
+static bool aboveDiagonal(Square s) { return rankOf(s) > fileOf(s); }
+
+static void initKingPairs()
+{
+    for (int p = 0; p < 2; ++p) {
+        KingPairs& kp = kingPairs[p];
+        for (int w = 0; w < 64; ++w) {
+            for (int b = 0; b < 64; ++b) {
+                Square wk = Square(w), bk = Square(b);
+                kp.index[w][b] = -1;
+
+                // Without pawns the white king lives in the a1-d1-d4 triangle,
+                // with pawns on the a-d files
+                bool canonical = p ? fileOf(wk) <= 3
+                                   : fileOf(wk) <= 3 && rankOf(wk) <= fileOf(wk)
+                                     && !(onDiagonal(wk) && aboveDiagonal(bk));
+                if (!canonical || wk == bk || (KingAttacks[wk] & squareBB(bk)))
+                    continue;
+
+                kp.index[w][b] = int16_t(kp.white.size());
+                kp.white.push_back(wk);
+                kp.black.push_back(bk);
+            }
+        }
+    }
+}
+
+static void ensureInit()
+{
+    static std::once_flag once;
+    initBitboards();
+    std::call_once(once, initKingPairs);
+}
+
+// t: bit 0 mirrors files, bit 1 mirrors ranks, bit 2 flips along a1-h8
+static inline Square transform(Square s, int t)
+{
+    if (t & 1) s = Square(s ^ 7);
+    if (t & 2) s = Square(s ^ 56);
+    if (t & 4) s = Square(((s >> 3) | (s << 3)) & 63);
+    return s;
+}
+
+static inline Square nthSquare(Bitboard b, int n)
+{
+    while (n--) b &= b - 1;
+    return lsb(b);
+}
+
+static PieceType typeOfLetter(char c)
+{
+    const char* letters = "PNBRQK";
+    const char* p = std::strchr(letters, c);
+    return p && c ? PieceType(p - letters) : NO_PIECE_TYPE;
+}
+
+// Piece letters of one side, strongest first ("QRBNP" order)
+static std::string sortedSide(std::string side)
+{
+    std::sort(side.begin(), side.end(), [](char a, char b) {
+        return typeOfLetter(a) > typeOfLetter(b);
+    });
+    return side;
+}
+
+TbLayout::TbLayout()
+    : count(0), pawns(false), positions(0)
+{
+    ensureInit();
+}
+
+bool TbLayout::parse(const std::string& signature)
+{
+    size_t v = signature.find('v');
+    if (v == std::string::npos || v == 0 || signature[0] != 'K' || signature[v + 1] != 'K')
+        return false;
+
+    std::string white = signature.substr(1, v - 1);
+    std::string black = signature.substr(v + 2);
+    if (int(white.size() + black.size()) + 2 > TB_MAX_PIECES)
+        return false;
+    for (char c : white + black) {
+        PieceType pt = typeOfLetter(c);
+        if (pt == NO_PIECE_TYPE || pt == KING) return false;
+    }
+    white = sortedSide(white);
+    black = sortedSide(black);
+
+    name = "K" + white + "vK" + black;
+    count = 0;
+    pieces[count++] = W_KING;
+    pieces[count++] = B_KING;
+    for (char c : white) pieces[count++] = makePiece(WHITE, typeOfLetter(c));
+    for (char c : black) pieces[count++] = makePiece(BLACK, typeOfLetter(c));
+
+    pawns = false;
+    int placed = 2, pawnsPlaced = 0;
+    for (int i = 2; i < count; ++i) {
+        if (typeOf(pieces[i]) == PAWN) {
+            pawns = true;
+            range[i] = 48 - pawnsPlaced++;
+        } else {
+            range[i] = 64 - placed;
+        }
+        ++placed;
+    }
+
+    positions = kingPairs[pawns].white.size();
+    for (int i = 2; i < count; ++i)
+        positions *= range[i];
+    return true;
+}
+
+uint64_t TbLayout::materialKey() const
+{
+    uint64_t key = 0;
+    for (int i = 2; i < count; ++i)
+        key += 1ULL << (4 * (6 * colorOf(pieces[i]) + typeOf(pieces[i])));
+    return key;
+}
+
+uint64_t tbMaterialKey(const Position& pos, bool flip)
+{
+    uint64_t key = 0;
+    for (int c = WHITE; c <= BLACK; ++c) {
+        int slot = flip ? 1 - c : c;
+        for (int pt = PAWN; pt < KING; ++pt)
+            key += uint64_t(popCount(pos.pieces(Color(c), PieceType(pt)))) << (4 * (6 * slot + pt));
+    }
+    return key;
+}
+
+void TbLayout::squaresOf(const Position& pos, bool flip, Square squares[TB_MAX_PIECES]) const
+{
+    Bitboard group = 0;
+    for (int i = 0; i < count; ++i) {
+        if (i == 0 || pieces[i] != pieces[i - 1]) {
+            Color c = colorOf(pieces[i]);
+            group = pos.pieces(flip ? ~c : c, typeOf(pieces[i]));
+        }
+        Square s = popLsb(group);
+        squares[i] = flip ? Square(s ^ 56) : s;
+    }
+}
+
+int64_t TbLayout::encode(Square squares[TB_MAX_PIECES]) const
+{
+    // Bring the white king into its canonical region
+    int t = fileOf(squares[0]) > 3 ? 1 : 0;
+    if (!pawns) {
+        if (rankOf(transform(squares[0], t)) > 3) t |= 2;
+        if (aboveDiagonal(transform(squares[0], t))) t |= 4;
+
+        // On the diagonal the a1-h8 flip is still free: take whichever
+        // orientation gives the smaller index
+        if (onDiagonal(transform(squares[0], t))) {
+            Square flipped[TB_MAX_PIECES];
+            std::copy(squares, squares + count, flipped);
+            int64_t index = encodeAs(squares, t);
+            int64_t other = encodeAs(flipped, t ^ 4);
+            if (other >= 0 && (index < 0 || other < index)) {
+                std::copy(flipped, flipped + count, squares);
+                return other;
+            }
+            return index;
+        }
+    }
+    return encodeAs(squares, t);
+}
+
+int64_t TbLayout::encodeAs(Square squares[TB_MAX_PIECES], int t) const
+{
+    for (int i = 0; i < count; ++i)
+        squares[i] = transform(squares[i], t);
+
+    // Equal pieces in ascending square order
+    for (int i = 3; i < count; ++i) {
+        for (int j = i; j > 2 && pieces[j] == pieces[j - 1] && squares[j] < squares[j - 1]; --j)
+            std::swap(squares[j], squares[j - 1]);
+    }
+
+    int kings = kingPairs[pawns].index[squares[0]][squares[1]];
+    if (kings < 0)
+        return -1;
+
+    uint64_t index = kings;
+    Bitboard occupied = squareBB(squares[0]) | squareBB(squares[1]);
+    Bitboard pawnsSeen = 0;
+    for (int i = 2; i < count; ++i) {
+        Bitboard below = squareBB(squares[i]) - 1;
+        int digit;
+        if (typeOf(pieces[i]) == PAWN) {
+            digit = popCount(PawnSquares & ~pawnsSeen & below);
+            pawnsSeen |= squareBB(squares[i]);
+        } else {
+            digit = popCount(~occupied & below);
+        }
+        occupied |= squareBB(squares[i]);
+        index = index * range[i] + digit;
+    }
+    return int64_t(index);
+}
+
+bool TbLayout::decode(uint64_t index, Square squares[TB_MAX_PIECES]) const
+{
+    int digits[TB_MAX_PIECES];
+    for (int i = count - 1; i >= 2; --i) {
+        digits[i] = int(index % range[i]);
+        index /= range[i];
+    }
+    squares[0] = kingPairs[pawns].white[index];
+    squares[1] = kingPairs[pawns].black[index];
+
+    Bitboard occupied = squareBB(squares[0]) | squareBB(squares[1]);
+    Bitboard pawnsSeen = 0;
+    for (int i = 2; i < count; ++i) {
+        if (typeOf(pieces[i]) == PAWN) {
+            squares[i] = nthSquare(PawnSquares & ~pawnsSeen, digits[i]);
+            pawnsSeen |= squareBB(squares[i]);
+            if (occupied & squareBB(squares[i]))
+                return false;
+        } else {
+            squares[i] = nthSquare(~occupied, digits[i]);
+        }
+        occupied |= squareBB(squares[i]);
+    }
+    return true;
+}
+
+// Value of a side's material for picking the stronger side, then piece by piece
+static std::string strengthKey(const std::string& side)
+{
+    static const int values[5] = {1, 3, 3, 5, 9};
+    int total = 0;
+    std::string key;
+    for (char c : side) {
+        total += values[typeOfLetter(c)];
+        key += char('a' + typeOfLetter(c));
+    }
+    return std::string(1, char('A' + total)) + key;
+}
+
+static void sideCombinations(int length, int minType, std::string& current, std::vector<std::string>& out)
+{
+    if (length == 0) {
+        out.push_back(current);
+        return;
+    }
+    for (int pt = minType; pt >= PAWN; --pt) {
+        current.push_back("PNBRQ"[pt]);
+        sideCombinations(length - 1, pt, current, out);
+        current.pop_back();
+    }
+}
+
+std::vector<std::string> tbSignatures(int maxPieces)
+{
+    std::vector<std::string> sides;
+    for (int n = 0; n <= maxPieces - 2; ++n) {
+        std::string current;
+        sideCombinations(n, QUEEN, current, sides);
+    }
+
+    struct Signature {
+        std::string name;
+        int pieces;
+        int pawns;
+    };
+    std::vector<Signature> list;
+    for (const std::string& white : sides) {
+        for (const std::string& black : sides) {
+            int extra = int(white.size() + black.size());
+            if (extra == 0 || extra + 2 > maxPieces || strengthKey(white) < strengthKey(black))
+                continue;
+            std::string all = white + black;
+            list.push_back({"K" + white + "vK" + black, extra + 2, int(std::count(all.begin(), all.end(), 'P'))});
+        }
+    }
+
+    // Captures lower the piece count, promotions the pawn count
+    std::stable_sort(list.begin(), list.end(), [](const Signature& a, const Signature& b) {
+        return a.pieces != b.pieces ? a.pieces < b.pieces : a.pawns < b.pawns;
+    });
+
+    std::vector<std::string> names;
+    for (const Signature& s : list)
+        names.push_back(s.name);
+    return names;
+}
+
+static size_t alignUp(size_t offset)
+{
+    return (offset + 63) & ~size_t(63);
+}
+
+bool TbTable::open(const std::string& path)
+{
+    if (!file.open(path))
+        return false;
+
+    const unsigned char* data = file.data();
+    if (file.size() < TbHeaderSize || std::memcmp(data, TbMagic, sizeof(TbMagic)) != 0) {
+        file.close();
+        return false;
+    }
+
+    uint32_t pieces, flags;
+    uint64_t positions;
+    char signature[17] = {0};
+    std::memcpy(&pieces, data + 8, 4);
+    std::memcpy(&flags, data + 12, 4);
+    std::memcpy(signature, data + 16, 16);
+    std::memcpy(&positions, data + 32, 8);
+
+    if (!tableLayout.parse(signature) || tableLayout.signature() != signature ||
+        int(pieces) != tableLayout.pieceCount() || positions != tableLayout.size()) {
+        file.close();
+        return false;
+    }
+
+    size_t wdlBytes = alignUp((positions + 3) / 4);
+    size_t dtmBytes = alignUp(positions);
+    size_t expected = TbHeaderSize + 2 * wdlBytes + ((flags & 1) ? 2 * dtmBytes : 0);
+    if (file.size() < expected) {
+        file.close();
+        return false;
+    }
+
+    size_t offset = TbHeaderSize;
+    for (int side = 0; side < 2; ++side, offset += wdlBytes)
+        wdl[side] = data + offset;
+    for (int side = 0; side < 2; ++side, offset += dtmBytes)
+        dtm[side] = (flags & 1) ? reinterpret_cast<const int8_t*>(data + offset) : nullptr;
+    return true;
+}
+
+Tablebases::Tablebases()
+    : largest(0)
+{
+    ensureInit();
+}
+
+int Tablebases::load(const std::string& directory)
+{
+    std::string prefix = directory.empty() ? std::string() : directory + "/";
+    for (const std::string& name : tbSignatures(TB_MAX_PIECES)) {
+        TbLayout layout;
+        layout.parse(name);
+        if (byMaterial.count(layout.materialKey()) == 0)
+            addTable(prefix + name + ".cbtb");
+    }
+    return tableCount();
+}
+
+bool Tablebases::addTable(const std::string& path)
+{
+    std::unique_ptr<TbTable> table(new TbTable());
+    if (!table->open(path))
+        return false;
+
+    // The same table serves the position with colors swapped
+    uint64_t key = table->layout().materialKey();
+    uint64_t swapped = (key >> 24) | ((key & 0xFFFFFF) << 24);
+    byMaterial[key] = Entry{table.get(), false};
+    if (swapped != key)
+        byMaterial[swapped] = Entry{table.get(), true};
+
+    largest = std::max(largest, table->layout().pieceCount());
+    tables.push_back(std::move(table));
+    return true;
+}
+
+bool Tablebases::canProbe(const Position& pos) const
+{
+    int pieces = popCount(pos.pieces());
+    return pos.castlingRights() == 0 && pieces <= largest
+        && (pieces == 2 || byMaterial.count(tbMaterialKey(pos, false)));
+}
+
+bool Tablebases::probeTable(const Position& pos, TbResult& result) const
+{
+    auto it = byMaterial.find(tbMaterialKey(pos, false));
+    if (it == byMaterial.end())
+        return false;
+
+    const TbTable* table = it->second.table;
+    bool flip = it->second.flipped;
+    Square squares[TB_MAX_PIECES];
+    table->layout().squaresOf(pos, flip, squares);
+    int64_t index = table->layout().encode(squares);
+    if (index < 0)
+        return false;
+
+    int side = pos.sideToMove() == (flip ? BLACK : WHITE) ? 0 : 1;
+    switch (table->wdlAt(side, index)) {
+        case 0: result.wdl = TB_DRAW; break;
+        case 1: result.wdl = TB_WIN; break;
+        case 2: result.wdl = TB_LOSS; break;
+        default: return false;
+    }
+
+    if (!table->hasDtm()) {
+        result.dtm = result.wdl == TB_DRAW ? 0 : -1;
+    } else {
+        int n = table->dtmAt(side, index);
+        result.dtm = n > 0 ? 2 * n - 1 : (n < 0 ? -2 * n - 2 : 0);
+    }
+    return true;
+}
+
+// Ordering of results for the side to move: quick wins, draws, slow losses
+static int resultRank(const TbResult& r)
+{
+    int dtm = r.dtm < 0 ? 500 : r.dtm;
+    if (r.wdl == TB_WIN) return 2000 - dtm;
+    if (r.wdl == TB_LOSS) return -2000 + dtm;
+    return 0;
+}
+
+// A child's result seen from the parent
+static TbResult parentResult(const TbResult& child)
+{
+    TbResult r;
+    r.wdl = -child.wdl;
+    r.dtm = child.wdl == TB_DRAW ? 0 : (child.dtm < 0 ? -1 : child.dtm + 1);
+    return r;
+}
+
+bool Tablebases::probe(const Position& pos, TbResult& result) const
+{
+    if (pos.castlingRights())
+        return false;
+    if (popCount(pos.pieces()) == 2) {
+        result.wdl = TB_DRAW;
+        result.dtm = 0;
+        return true;
+    }
+    if (pos.epSquare() == NO_SQUARE)
+        return probeTable(pos, result);
+
+    // The tables don't know about en passant, so look one move ahead
+    PackedMove best;
+    return probeRoot(pos, best, result);
+}
+
+bool Tablebases::probeRoot(const Position& pos, PackedMove& best, TbResult& result) const
+{
+    if (!canProbe(pos))
+        return false;
+
+    Position copy = pos;
+    MoveList moves;
+    generateLegalMoves(copy, moves);
+
+    best = NO_MOVE;
+    if (moves.empty()) {
+        result.wdl = pos.inCheck() ? TB_LOSS : TB_DRAW;
+        result.dtm = 0;
+        return true;
+    }
+
+    for (PackedMove move : moves) {
+        TbResult child;
+        copy.makeMove(move);
+        bool found = probe(copy, child);
+        copy.unmakeMove(move);
+        if (!found)
+            return false;
+
+        TbResult r = parentResult(child);
+        if (best == NO_MOVE || resultRank(r) > resultRank(result)) {
+            best = move;
+            result = r;
+        }
+    }
+    return true;
+}
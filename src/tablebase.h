@@ -0,0 +1,137 @@
+#ifndef TABLEBASE_H
+#define TABLEBASE_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "position.h"
+#include "mappedfile.h"
+
+// Endgame tablebases with win/draw/loss and distance-to-mate for up to five
+// pieces, kings included.
+//
+// There is one file per material signature, named after it ("KRPvKR.cbtb"),
+// with the stronger side stored as white. Tables assume no castling rights
+// and no en passant capture; the fifty-move rule is ignored.
+//
+// File layout (little-endian, each array starts on a 64-byte boundary):
+//   char[8]   magic "CBTB1"
+//   uint32    piece count, flags (bit 0: DTM section present)
+//   char[16]  material signature, zero padded
+//   uint64    positions per side to move
+//   uint8     wdl[2][(positions + 3) / 4]   2 bits each: 0 draw, 1 win, 2 loss, 3 unused index
+//   int8      dtm[2][positions]             n > 0 mates in 2n-1 plies, n < 0 is mated in -2n-2, 0 draw
+// Arrays are indexed by side to move (0 = the stored white side).
+//
+// Position index: the two kings, reduced by board symmetry (eightfold
+// without pawns, left-right with pawns), then every other piece in signature
+// order numbered among the squares still free. Equal pieces are taken in
+// ascending square order, so each position has exactly one index.
+
+const int TB_MAX_PIECES = 5;
+
+enum TbWdl { TB_LOSS = -1, TB_DRAW = 0, TB_WIN = 1 };
+
+struct TbResult {
+    int wdl;    // TbWdl, from the side to move's point of view
+    int dtm;    // Plies to mate (win) or to being mated (loss), -1 if the table has no DTM
+};
+
+// Piece layout of one material signature and the index arithmetic for it
+class TbLayout {
+public:
+    TbLayout();
+
+    // "KRPvKR": white pieces, 'v', black pieces, each starting with the king
+    bool parse(const std::string& signature);
+    const std::string& signature() const { return name; }
+    int pieceCount() const { return count; }
+    Piece piece(int i) const { return pieces[i]; }  // 0 = white king, 1 = black king
+    bool hasPawns() const { return pawns; }
+    uint64_t size() const { return positions; }     // Positions per side to move
+    uint64_t materialKey() const;
+
+    // Squares of pos's pieces in layout order; with flip, colors are swapped
+    // and the board mirrored so the position matches a table stored the other way
+    void squaresOf(const Position& pos, bool flip, Square squares[TB_MAX_PIECES]) const;
+
+    // Index of a placement; squares are rewritten into their canonical form.
+    // Returns -1 if the kings touch.
+    int64_t encode(Square squares[TB_MAX_PIECES]) const;
+    // Placement for an index; false if two pieces share a square
+    bool decode(uint64_t index, Square squares[TB_MAX_PIECES]) const;
+
+private:
+    std::string name;
+    Piece pieces[TB_MAX_PIECES];
+    int count;
+    bool pawns;
+    int range[TB_MAX_PIECES];  // Radix of each non-king piece's index digit
+    uint64_t positions;
+
+    int64_t encodeAs(Square squares[TB_MAX_PIECES], int transform) const;
+};
+
+// Material key of a position as seen by a table: counts of each non-king piece
+uint64_t tbMaterialKey(const Position& pos, bool flip);
+
+// All canonical signatures with at most maxPieces pieces, in an order where
+// every table only converts into tables listed before it
+std::vector<std::string> tbSignatures(int maxPieces);
+
+class TbTable {
+public:
+    bool open(const std::string& path);
+
+    const TbLayout& layout() const { return tableLayout; }
+    bool hasDtm() const { return dtm[0] != nullptr; }
+
+    // Raw lookups by side to move and index
+    int wdlAt(int side, uint64_t index) const { return (wdl[side][index >> 2] >> (2 * (index & 3))) & 3; }
+    int dtmAt(int side, uint64_t index) const { return dtm[side][index]; }
+
+private:
+    MappedFile file;
+    TbLayout tableLayout;
+    const uint8_t* wdl[2];
+    const int8_t* dtm[2];
+};
+
+class Tablebases {
+public:
+    Tablebases();
+
+    // Map every table of the known signatures found in directory;
+    // returns how many tables are available afterwards
+    int load(const std::string& directory);
+    bool addTable(const std::string& path);
+
+    int tableCount() const { return int(tables.size()); }
+    int maxPieces() const { return largest; }
+
+    // Quick filter before probing: few enough pieces, no castling, table present
+    bool canProbe(const Position& pos) const;
+
+    // Exact result for the side to move. Positions with an en passant
+    // capture available are resolved by looking one ply ahead.
+    bool probe(const Position& pos, TbResult& result) const;
+
+    // Best move by distance to mate: fastest win, any draw, slowest loss
+    bool probeRoot(const Position& pos, PackedMove& best, TbResult& result) const;
+
+private:
+    struct Entry {
+        const TbTable* table;
+        bool flipped;
+    };
+
+    std::vector<std::unique_ptr<TbTable>> tables;
+    std::unordered_map<uint64_t, Entry> byMaterial;
+    int largest;
+
+    bool probeTable(const Position& pos, TbResult& result) const;
+};
+
+#endif // TABLEBASE_H
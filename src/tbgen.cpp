@@ -0,0 +1,586 @@
+#include "tbgen.h"
+#include "movegen.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Solver state of one position
+enum : uint8_t {
+    UNKNOWN,      // Not decided yet; a draw if still unknown at the end
+    INVALID,      // Unused index or illegal position
+    DRAW,
+    WIN,
+    LOSS,
+    PENDING_WIN   // A capture or promotion wins in plies[]; a quicker win may still turn up
+};
+
+// Split [0, size) into chunks handed out to threadCount workers
+template <typename Fn>
+void parallelFor(int threadCount, uint64_t size, Fn fn)
+{
+    const uint64_t chunk = 4096;
+    std::atomic<uint64_t> next(0);
+    auto worker = [&]() {
+        uint64_t begin;
+        while ((begin = next.fetch_add(chunk)) < size)
+            fn(begin, std::min(begin + chunk, size));
+    };
+
+    std::vector<std::thread> workers;
+    for (int i = 1; i < threadCount; ++i)
+        workers.emplace_back(worker);
+    worker();
+    for (std::thread& t : workers)
+        t.join();
+}
+
+// Result ordering for the side to move: quick wins, draws, slow losses
+int rank(const TbResult& r)
+{
+    if (r.wdl == TB_WIN) return 2000 - r.dtm;
+    if (r.wdl == TB_LOSS) return -2000 + r.dtm;
+    return 0;
+}
+
+TbResult better(const TbResult& a, const TbResult& b)
+{
+    return rank(b) > rank(a) ? b : a;
+}
+
+// A child's result seen from the parent
+TbResult flipResult(const TbResult& child)
+{
+    TbResult r;
+    r.wdl = -child.wdl;
+    r.dtm = child.wdl == TB_DRAW ? 0 : child.dtm + 1;
+    return r;
+}
+
+void atomicMax(std::atomic<int>& target, int value)
+{
+    int current = target.load();
+    while (value > current && !target.compare_exchange_weak(current, value)) {}
+}
+
+class Solver {
+public:
+    Solver(const TbLayout& layout, const Tablebases& tables, int threads)
+        : layout(layout), tables(tables), threadCount(threads), failed(false), scheduled(0)
+    {
+        for (int side = 0; side < 2; ++side) {
+            state[side].reset(new std::atomic<uint8_t>[layout.size()]);
+            plies[side].reset(new uint16_t[layout.size()]);
+        }
+    }
+
+    bool solve();
+    bool write(const std::string& path, bool withDtm) const;
+    std::string summary() const;
+
+private:
+    const TbLayout& layout;
+    const Tablebases& tables;
+    int threadCount;
+    std::unique_ptr<std::atomic<uint8_t>[]> state[2];
+    std::unique_ptr<uint16_t[]> plies[2];
+    std::atomic<bool> failed;
+    std::atomic<bool> changed;
+    std::atomic<int> scheduled; // Highest distance set ahead of its pass
+
+    void setup(const Square squares[], Color side, Position& pos) const;
+    void classify(uint64_t index, Position& pos, std::vector<std::pair<int, uint64_t>>& enPassant);
+    bool conversionResult(Position& pos, PackedMove move, TbResult& result) const;
+    bool forwardLoss(Color side, uint64_t index, Position& pos, int& distance) const;
+    void retract(Color side, uint64_t index, uint8_t result, int pass, Position& pos);
+    template <typename Fn>
+    void forEachPredecessor(Color side, uint64_t index, Fn fn) const;
+    void evaluate(Color side, uint64_t index, Position& pos, uint8_t& result, int& distance) const;
+    void repair(std::vector<std::pair<int, uint64_t>> dirty);
+    TbResult stored(Color side, uint64_t index) const;
+    bool attacked(const Square squares[], Square target, Color by) const;
+};
+
+void Solver::setup(const Square squares[], Color side, Position& pos) const
+{
+    Piece board[64];
+    std::fill(board, board + 64, NO_PIECE);
+    for (int i = 0; i < layout.pieceCount(); ++i)
+        board[squares[i]] = layout.piece(i);
+    pos.setPosition(board, side);
+}
+
+bool Solver::attacked(const Square squares[], Square target, Color by) const
+{
+    Bitboard occupied = 0;
+    for (int i = 0; i < layout.pieceCount(); ++i)
+        occupied |= squareBB(squares[i]);
+
+    for (int i = 0; i < layout.pieceCount(); ++i) {
+        Piece p = layout.piece(i);
+        if (colorOf(p) != by) continue;
+        Bitboard attacks = typeOf(p) == PAWN ? PawnAttacks[by][squares[i]]
+                                             : pieceAttacks(typeOf(p), squares[i], occupied);
+        if (attacks & squareBB(target))
+            return true;
+    }
+    return false;
+}
+
+// Captures and promotions leave the table; their result comes from a smaller one
+bool Solver::conversionResult(Position& pos, PackedMove move, TbResult& result) const
+{
+    pos.makeMove(move);
+    bool found = tables.probe(pos, result);
+    pos.unmakeMove(move);
+    result.dtm = std::max(result.dtm, 0); // Tables without DTM only give the outcome
+    return found;
+}
+
+void Solver::classify(uint64_t index, Position& pos, std::vector<std::pair<int, uint64_t>>& enPassant)
+{
+    Square squares[TB_MAX_PIECES], check[TB_MAX_PIECES];
+    bool valid = layout.decode(index, squares);
+    if (valid) {
+        std::copy(squares, squares + layout.pieceCount(), check);
+        valid = layout.encode(check) == int64_t(index);
+    }
+
+    for (int side = 0; side < 2; ++side) {
+        Color us = Color(side);
+        uint8_t result = UNKNOWN;
+        int distance = 0;
+
+        if (valid) setup(squares, us, pos);
+
+        // The side that just moved can't be left in check
+        if (!valid || pos.isAttacked(pos.kingSquare(~us), us)) {
+            result = INVALID;
+        } else {
+            MoveList moves;
+            generateLegalMoves(pos, moves);
+
+            int quickestWin = INT_MAX, slowestLoss = 0, stayMoves = 0;
+            bool canDraw = false;
+            for (PackedMove move : moves) {
+                if (!isCaptureMove(move) && !isPromotionMove(move)) {
+                    ++stayMoves;
+                    if (moveFlags(move) == DOUBLE_PUSH) {
+                        pos.makeMove(move);
+                        if (pos.epSquare() != NO_SQUARE)
+                            enPassant.push_back(std::make_pair(side, index));
+                        pos.unmakeMove(move);
+                    }
+                    continue;
+                }
+                TbResult child;
+                if (!conversionResult(pos, move, child)) {
+                    failed = true;
+                    return;
+                }
+                if (child.wdl == TB_LOSS) quickestWin = std::min(quickestWin, child.dtm + 1);
+                else if (child.wdl == TB_DRAW) canDraw = true;
+                else slowestLoss = std::max(slowestLoss, child.dtm + 1);
+            }
+
+            if (moves.empty()) {
+                result = pos.inCheck() ? LOSS : DRAW;
+            } else if (quickestWin != INT_MAX) {
+                result = PENDING_WIN;
+                distance = quickestWin;
+            } else if (stayMoves == 0) {
+                result = canDraw ? DRAW : LOSS;
+                distance = canDraw ? 0 : slowestLoss;
+            }
+            if (result == PENDING_WIN || result == LOSS)
+                atomicMax(scheduled, distance);
+        }
+
+        state[side][index].store(result, std::memory_order_relaxed);
+        plies[side][index] = uint16_t(distance);
+    }
+}
+
+// A position is lost once every move leads to a known win for the opponent;
+// the distance is that of the slowest of them
+bool Solver::forwardLoss(Color side, uint64_t index, Position& pos, int& distance) const
+{
+    Square squares[TB_MAX_PIECES];
+    layout.decode(index, squares);
+    setup(squares, side, pos);
+
+    MoveList moves;
+    generateLegalMoves(pos, moves);
+
+    distance = 0;
+    for (PackedMove move : moves) {
+        if (isCaptureMove(move) || isPromotionMove(move)) {
+            TbResult child;
+            if (!conversionResult(pos, move, child) || child.wdl != TB_WIN)
+                return false;
+            distance = std::max(distance, child.dtm + 1);
+            continue;
+        }
+
+        Square next[TB_MAX_PIECES];
+        pos.makeMove(move);
+        layout.squaresOf(pos, false, next);
+        pos.unmakeMove(move);
+        int64_t child = layout.encode(next);
+        if (child < 0 || state[~side][child].load(std::memory_order_relaxed) != WIN)
+            return false;
+        distance = std::max(distance, plies[~side][child] + 1);
+    }
+    return true;
+}
+
+// Calls fn(parent index) for every position of the other side that reaches
+// this one with a move staying in the table
+template <typename Fn>
+void Solver::forEachPredecessor(Color side, uint64_t index, Fn fn) const
+{
+    Square squares[TB_MAX_PIECES];
+    layout.decode(index, squares);
+    Color mover = ~side;
+    Square ourKing = squares[side == WHITE ? 0 : 1];
+
+    Bitboard occupied = 0;
+    for (int i = 0; i < layout.pieceCount(); ++i)
+        occupied |= squareBB(squares[i]);
+
+    for (int i = 0; i < layout.pieceCount(); ++i) {
+        Piece p = layout.piece(i);
+        if (colorOf(p) != mover) continue;
+
+        Bitboard origins;
+        if (typeOf(p) == PAWN) {
+            // Pawns retreat one square, or two from the fourth rank
+            int back = mover == WHITE ? -8 : 8;
+            Square one = Square(squares[i] + back);
+            origins = 0;
+            if (!(occupied & squareBB(one)) && relativeRank(mover, one) >= 1) {
+                origins |= squareBB(one);
+                Square two = Square(one + back);
+                if (relativeRank(mover, squares[i]) == 3 && !(occupied & squareBB(two)))
+                    origins |= squareBB(two);
+            }
+        } else {
+            origins = pieceAttacks(typeOf(p), squares[i], occupied) & ~occupied;
+        }
+
+        while (origins) {
+            Square previous[TB_MAX_PIECES];
+            std::copy(squares, squares + layout.pieceCount(), previous);
+            previous[i] = popLsb(origins);
+
+            // Before the move it was the mover's turn, so our king was not in check
+            if (attacked(previous, ourKing, mover))
+                continue;
+            int64_t parent = layout.encode(previous);
+            if (parent >= 0)
+                fn(uint64_t(parent));
+        }
+    }
+}
+
+// Walk back from a position decided in the previous pass: side is to move
+// there, so the other side made the move we take back
+void Solver::retract(Color side, uint64_t index, uint8_t result, int pass, Position& pos)
+{
+    Color mover = ~side;
+    forEachPredecessor(side, index, [&](uint64_t parent) {
+        std::atomic<uint8_t>& target = state[mover][parent];
+        if (result == LOSS) {
+            // Moving into a lost position wins
+            uint8_t expected = UNKNOWN;
+            if (target.compare_exchange_strong(expected, WIN) ||
+                (expected == PENDING_WIN && target.compare_exchange_strong(expected, WIN))) {
+                plies[mover][parent] = uint16_t(pass);
+                changed = true;
+            }
+        } else if (target.load(std::memory_order_relaxed) == UNKNOWN) {
+            int distance;
+            if (!forwardLoss(mover, parent, pos, distance))
+                return;
+            uint8_t expected = UNKNOWN;
+            if (target.compare_exchange_strong(expected, LOSS)) {
+                plies[mover][parent] = uint16_t(distance);
+                atomicMax(scheduled, distance);
+                changed = true;
+            }
+        }
+    });
+}
+
+// Result of a position from its children, with en passant replies to
+// double pushes taken into account
+void Solver::evaluate(Color side, uint64_t index, Position& pos, uint8_t& result, int& distance) const
+{
+    Square squares[TB_MAX_PIECES];
+    layout.decode(index, squares);
+    setup(squares, side, pos);
+
+    MoveList moves;
+    generateLegalMoves(pos, moves);
+
+    TbResult best = {TB_LOSS, 0};
+    if (moves.empty() && !pos.inCheck())
+        best.wdl = TB_DRAW;
+
+    for (int i = 0; i < moves.size(); ++i) {
+        PackedMove move = moves[i];
+        TbResult child;
+        if (isCaptureMove(move) || isPromotionMove(move)) {
+            conversionResult(pos, move, child);
+        } else {
+            Square next[TB_MAX_PIECES];
+            pos.makeMove(move);
+            layout.squaresOf(pos, false, next);
+            child = stored(~side, uint64_t(layout.encode(next)));
+
+            // The reply the table doesn't know about
+            if (pos.epSquare() != NO_SQUARE) {
+                MoveList replies;
+                generateLegalCaptures(pos, replies);
+                for (PackedMove reply : replies) {
+                    TbResult grandchild;
+                    if (moveFlags(reply) == EP_CAPTURE && conversionResult(pos, reply, grandchild))
+                        child = better(child, flipResult(grandchild));
+                }
+            }
+            pos.unmakeMove(move);
+        }
+        TbResult r = flipResult(child);
+        if (i == 0 || rank(r) > rank(best))
+            best = r;
+    }
+
+    result = best.wdl == TB_WIN ? WIN : best.wdl == TB_LOSS ? LOSS : DRAW;
+    distance = best.wdl == TB_DRAW ? 0 : best.dtm;
+}
+
+// Double pushes were scored as if no en passant capture could follow. Fix
+// the positions that have such a move, then pass every change on to the
+// predecessors until nothing moves.
+void Solver::repair(std::vector<std::pair<int, uint64_t>> dirty)
+{
+    Position pos;
+    while (!dirty.empty()) {
+        std::sort(dirty.begin(), dirty.end());
+        dirty.erase(std::unique(dirty.begin(), dirty.end()), dirty.end());
+
+        std::vector<std::pair<int, uint64_t>> next;
+        for (const auto& entry : dirty) {
+            Color side = Color(entry.first);
+            uint64_t index = entry.second;
+            uint8_t result;
+            int distance;
+            evaluate(side, index, pos, result, distance);
+            if (result == state[side][index].load() && distance == plies[side][index])
+                continue;
+
+            state[side][index].store(result);
+            plies[side][index] = uint16_t(distance);
+            forEachPredecessor(side, index, [&](uint64_t parent) {
+                next.push_back(std::make_pair(int(~side), parent));
+            });
+        }
+        dirty.swap(next);
+    }
+}
+
+TbResult Solver::stored(Color side, uint64_t index) const
+{
+    uint8_t s = state[side][index].load(std::memory_order_relaxed);
+    TbResult r;
+    r.wdl = s == WIN ? TB_WIN : s == LOSS ? TB_LOSS : TB_DRAW;
+    r.dtm = r.wdl == TB_DRAW ? 0 : plies[side][index];
+    return r;
+}
+
+bool Solver::solve()
+{
+    const uint64_t size = layout.size();
+
+    std::vector<std::pair<int, uint64_t>> enPassant;
+    std::mutex enPassantLock;
+    parallelFor(threadCount, size, [&](uint64_t begin, uint64_t end) {
+        Position pos;
+        std::vector<std::pair<int, uint64_t>> found;
+        for (uint64_t i = begin; i < end && !failed; ++i)
+            classify(i, pos, found);
+        std::lock_guard<std::mutex> lock(enPassantLock);
+        enPassant.insert(enPassant.end(), found.begin(), found.end());
+    });
+    if (failed)
+        return false;
+
+    for (int pass = 1; ; ++pass) {
+        changed = false;
+
+        // Wins through a capture or promotion that nothing beat
+        parallelFor(threadCount, size, [this, pass](uint64_t begin, uint64_t end) {
+            for (uint64_t i = begin; i < end; ++i) {
+                for (int side = 0; side < 2; ++side) {
+                    if (state[side][i].load(std::memory_order_relaxed) == PENDING_WIN && plies[side][i] == pass) {
+                        state[side][i].store(WIN, std::memory_order_relaxed);
+                        changed = true;
+                    }
+                }
+            }
+        });
+
+        // One side at a time, so each sweep only reads the side it walks back
+        // from and only writes the other
+        for (int side = 0; side < 2; ++side) {
+            parallelFor(threadCount, size, [this, side, pass](uint64_t begin, uint64_t end) {
+                Position pos;
+                for (uint64_t i = begin; i < end; ++i) {
+                    uint8_t result = state[side][i].load(std::memory_order_relaxed);
+                    if ((result == WIN || result == LOSS) && plies[side][i] == pass - 1)
+                        retract(Color(side), i, result, pass, pos);
+                }
+            });
+        }
+
+        if (!changed && pass > scheduled + 1)
+            break;
+    }
+
+    // Whatever is still open can't be forced either way
+    for (int side = 0; side < 2; ++side) {
+        for (uint64_t i = 0; i < size; ++i) {
+            if (state[side][i].load(std::memory_order_relaxed) == UNKNOWN)
+                state[side][i].store(DRAW, std::memory_order_relaxed);
+        }
+    }
+
+    repair(enPassant);
+    return !failed;
+}
+
+bool Solver::write(const std::string& path, bool withDtm) const
+{
+    const uint64_t size = layout.size();
+    const size_t wdlBytes = ((size + 3) / 4 + 63) & ~size_t(63);
+    const size_t dtmBytes = (size + 63) & ~size_t(63);
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out)
+        return false;
+
+    char header[64] = {'C', 'B', 'T', 'B', '1'};
+    uint32_t pieces = layout.pieceCount(), flags = withDtm ? 1 : 0;
+    std::memcpy(header + 8, &pieces, 4);
+    std::memcpy(header + 12, &flags, 4);
+    std::strncpy(header + 16, layout.signature().c_str(), 16);
+    std::memcpy(header + 32, &size, 8);
+    out.write(header, sizeof(header));
+
+    for (int side = 0; side < 2; ++side) {
+        std::vector<uint8_t> packed(wdlBytes, 0);
+        for (uint64_t i = 0; i < size; ++i) {
+            uint8_t s = state[side][i].load(std::memory_order_relaxed);
+            int code = s == WIN ? 1 : s == LOSS ? 2 : s == INVALID ? 3 : 0;
+            packed[i >> 2] |= uint8_t(code << (2 * (i & 3)));
+        }
+        out.write(reinterpret_cast<const char*>(packed.data()), packed.size());
+    }
+
+    if (withDtm) {
+        for (int side = 0; side < 2; ++side) {
+            std::vector<int8_t> dtm(dtmBytes, 0);
+            for (uint64_t i = 0; i < size; ++i) {
+                uint8_t s = state[side][i].load(std::memory_order_relaxed);
+                int d = plies[side][i];
+                if (s == WIN) dtm[i] = int8_t(std::min((d + 1) / 2, 127));
+                else if (s == LOSS) dtm[i] = int8_t(-std::min(d / 2 + 1, 127));
+            }
+            out.write(reinterpret_cast<const char*>(dtm.data()), dtm.size());
+        }
+    }
+    return bool(out);
+}
+
+std::string Solver::summary() const
+{
+    uint64_t wins = 0, draws = 0, losses = 0;
+    int longest = 0;
+    for (uint64_t i = 0; i < layout.size(); ++i) {
+        uint8_t s = state[WHITE][i].load(std::memory_order_relaxed);
+        if (s == WIN) {
+            ++wins;
+            longest = std::max(longest, int(plies[WHITE][i]));
+        } else if (s == LOSS) {
+            ++losses;
+        } else if (s != INVALID) {
+            ++draws;
+        }
+    }
+
+    uint64_t legal = wins + draws + losses;
+    char text[200];
+    std::snprintf(text, sizeof(text), "%s: %llu positions, white to move wins %.1f%% draws %.1f%% loses %.1f%%, longest mate %d plies",
+                  layout.signature().c_str(), (unsigned long long)legal,
+                  legal ? 100.0 * wins / legal : 0.0, legal ? 100.0 * draws / legal : 0.0,
+                  legal ? 100.0 * losses / legal : 0.0, longest);
+    return text;
+}
+
+} // namespace
+
+TablebaseGenerator::TablebaseGenerator(int threads)
+    : threadCount(threads > 0 ? threads : std::max(1, int(std::thread::hardware_concurrency()))),
+      writeDtm(true)
+{
+}
+
+bool TablebaseGenerator::generateAll(const std::string& directory, int maxPieces)
+{
+    for (const std::string& signature : tbSignatures(std::min(maxPieces, TB_MAX_PIECES))) {
+        if (tables.addTable(directory + "/" + signature + ".cbtb")) {
+            message(signature + ": already present");
+            continue;
+        }
+        if (!generate(signature, directory))
+            return false;
+    }
+    return true;
+}
+
+bool TablebaseGenerator::generate(const std::string& signature, const std::string& directory)
+{
+    TbLayout layout;
+    if (!layout.parse(signature)) {
+        message(signature + ": not a valid material signature");
+        return false;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    Solver solver(layout, tables, threadCount);
+    if (!solver.solve()) {
+        message(signature + ": a smaller table it converts into is missing");
+        return false;
+    }
+
+    std::string path = directory + "/" + layout.signature() + ".cbtb";
+    if (!solver.write(path, writeDtm) || !tables.addTable(path)) {
+        message(path + ": could not be written");
+        return false;
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    char timing[32];
+    std::snprintf(timing, sizeof(timing), " (%.1fs)", seconds);
+    message(solver.summary() + timing);
+    return true;
+}
@@ -0,0 +1,42 @@
+#ifndef TBGEN_H
+#define TBGEN_H
+
+#include <functional>
+#include <string>
+#include "tablebase.h"
+
+// Offline tablebase generator (see tablebase.h for the file format).
+//
+// Each table is solved by retrograde analysis: checkmates and the results
+// of captures and promotions (looked up in the smaller tables written
+// before) seed the search, then every pass walks the positions decided in
+// the previous pass backwards through un-moves. A predecessor of a loss is a
+// win one ply further away; a predecessor of a win becomes a loss once all
+// its moves are known to lose. Passes are split across threads. Double pawn
+// pushes that allow an en passant reply are corrected in a final sweep.
+class TablebaseGenerator {
+public:
+    explicit TablebaseGenerator(int threads = 0); // 0 = all cores
+
+    // Progress messages (one line each); defaults to none
+    void setLogger(std::function<void(const std::string&)> logger) { log = logger; }
+    // Write the DTM section as well as WDL (on by default)
+    void setWriteDtm(bool enabled) { writeDtm = enabled; }
+
+    // Generate every table with up to maxPieces pieces into directory,
+    // smallest first; tables already present there are reused
+    bool generateAll(const std::string& directory, int maxPieces);
+
+    // Generate one table; the tables it converts into must already be loaded
+    bool generate(const std::string& signature, const std::string& directory);
+
+private:
+    int threadCount;
+    bool writeDtm;
+    std::function<void(const std::string&)> log;
+    Tablebases tables; // Finished tables, probed for captures and promotions
+
+    void message(const std::string& text) const { if (log) log(text); }
+};
+
+#endif // TBGEN_H
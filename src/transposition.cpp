@@ -0,0 +1,29 @@
+#include "transposition.h"
+
+TranspositionTable::TranspositionTable(size_t sizeInKilobytes)
+    : mask(0), probeCount(0), hitCount(0)
+{
+    resize(sizeInKilobytes);
+}
+
+void TranspositionTable::resize(size_t sizeInKilobytes)
+{
+    size_t wanted = sizeInKilobytes * 1024 / sizeof(TtEntry);
+    size_t size = 1;
+    while (size * 2 <= wanted) size *= 2;
+
+    table.assign(size, TtEntry());
+    mask = size - 1;
+    clear();
+}
+
+void TranspositionTable::clear()
+{
+    for (TtEntry& e : table) {
+        e.check = 0;
+        e.score = 0;
+        e.move = NO_MOVE;
+        e.depth = 0;
+        e.bound = TT_NONE;
+    }
+}
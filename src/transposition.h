@@ -0,0 +1,69 @@
+#ifndef TRANSPOSITION_H
+#define TRANSPOSITION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "position.h"
+
+enum TtBound : uint8_t {
+    TT_NONE,
+    TT_EXACT,
+    TT_LOWER,   // Score is a lower bound (the search failed high)
+    TT_UPPER    // Score is an upper bound (the search failed low)
+};
+
+struct TtEntry {
+    uint32_t check;
+    int32_t score;
+    PackedMove move;
+    int8_t depth;
+    uint8_t bound;
+};
+
+// Direct-mapped table of search results keyed by the position's Zobrist key.
+// The low key bits select the slot and the high 32 bits verify it. A slot is
+// overwritten by any other position, and by the same one searched at least
+// as deep. Each search instance owns its own table, so no locking is needed.
+class TranspositionTable {
+public:
+    explicit TranspositionTable(size_t sizeInKilobytes = 16384);
+
+    // Resize (rounded down to a power of two) and clear the table
+    void resize(size_t sizeInKilobytes);
+    void clear();
+
+    bool probe(uint64_t key, TtEntry& entry) {
+        const TtEntry& e = table[key & mask];
+        ++probeCount;
+        if (e.check != uint32_t(key >> 32) || e.bound == TT_NONE) return false;
+        ++hitCount;
+        entry = e;
+        return true;
+    }
+
+    void store(uint64_t key, int score, PackedMove move, int depth, TtBound bound) {
+        TtEntry& e = table[key & mask];
+        uint32_t check = uint32_t(key >> 32);
+        if (e.check == check && e.bound != TT_NONE && depth < e.depth) return;
+        if (move == NO_MOVE && e.check == check) move = e.move; // Keep a known best move
+        e.check = check;
+        e.score = score;
+        e.move = move;
+        e.depth = int8_t(depth);
+        e.bound = bound;
+    }
+
+    size_t sizeInKilobytes() const { return table.size() * sizeof(TtEntry) / 1024; }
+    uint64_t probes() const { return probeCount; }
+    uint64_t hits() const { return hitCount; }
+    void resetStats() { probeCount = hitCount = 0; }
+
+private:
+    std::vector<TtEntry> table;
+    uint64_t mask;
+    uint64_t probeCount;
+    uint64_t hitCount;
+};
+
+#endif // TRANSPOSITION_H
@@ -0,0 +1,343 @@
+#include "tuner.h"
+#include "chessai.h"
+#include "mappedfile.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+// The weights the engine is built with are where tuning starts
+#include "evalparams.inc"
+
+// Terms in the order of the weight vector; every term has a middlegame and
+// an endgame weight
+static const int MaterialTerm = 0;
+static const int PieceSquareTerm = MaterialTerm + 6;
+static const int MobilityTerm = PieceSquareTerm + 6 * 64;
+static const int RookOpenFileTerm = MobilityTerm + 6;
+static const int RookSemiOpenFileTerm = RookOpenFileTerm + 1;
+static const int BishopPairTerm = RookSemiOpenFileTerm + 1;
+static const int TermCount = BishopPairTerm + 1;
+
+static const int MaxPhase = 24;
+// Size of the pieces a position file is cut into for loading
+static const size_t PieceBytes = 4 << 20;
+
+static const char* const PieceNames[6] = {"Pawn", "Knight", "Bishop", "Rook", "Queen", "King"};
+
+EvalTuner::EvalTuner(int threads)
+    : threadCount(threads > 0 ? threads : std::max(1, int(std::thread::hardware_concurrency()))),
+      scale(1.0), positions(0), weights(2 * TermCount)
+{
+    for (int phase = 0; phase < 2; ++phase) {
+        for (int type = 0; type < 6; ++type) {
+            weights[2 * (MaterialTerm + type) + phase] = PieceValue[type][phase];
+            weights[2 * (MobilityTerm + type) + phase] = MobilityWeight[type][phase];
+            for (int square = 0; square < 64; ++square)
+                weights[2 * (PieceSquareTerm + 64 * type + square) + phase] = PieceSquare[type][phase][square];
+        }
+        weights[2 * RookOpenFileTerm + phase] = RookOpenFileBonus[phase];
+        weights[2 * RookSemiOpenFileTerm + phase] = RookSemiOpenFileBonus[phase];
+        weights[2 * BishopPairTerm + phase] = BishopPairBonus[phase];
+    }
+}
+
+// Result for white at the end of a line, -1 if there is none
+static float parseResult(const char* begin, const char* end)
+{
+    std::string rest(begin, end);
+    if (rest.find("1/2-1/2") != std::string::npos) return 0.5f;
+    if (rest.find("1-0") != std::string::npos) return 1.0f;
+    if (rest.find("0-1") != std::string::npos) return 0.0f;
+    size_t bracket = rest.find('[');
+    if (bracket == std::string::npos)
+        return -1;
+    double value = std::strtod(rest.c_str() + bracket + 1, nullptr);
+    return value == 0.0 || value == 0.5 || value == 1.0 ? float(value) : -1;
+}
+
+bool EvalTuner::addPositions(const std::string& path)
+{
+    MappedFile file;
+    if (!file.open(path)) {
+        message(path + ": could not be opened");
+        return false;
+    }
+    auto startTime = std::chrono::steady_clock::now();
+    const char* data = reinterpret_cast<const char*>(file.data());
+    size_t size = file.size();
+
+    // Cut after line ends so every piece holds whole lines
+    std::vector<size_t> cuts = {0};
+    while (cuts.back() < size) {
+        const char* cut = data + std::min(size, cuts.back() + PieceBytes);
+        const char* newline = static_cast<const char*>(std::memchr(cut, '\n', size_t(data + size - cut)));
+        cuts.push_back(newline ? size_t(newline - data) + 1 : size);
+    }
+
+    size_t first = chunks.size();
+    chunks.resize(first + cuts.size() - 1);
+    std::atomic<size_t> nextPiece(0);
+    std::atomic<uint64_t> added(0), skipped(0);
+    auto worker = [&]() {
+        ChessAI engine;
+        engine.setHashSize(0); // Only the evaluation is used
+        EvalTrace trace;
+        Position pos;
+        std::string fen;
+        size_t piece;
+        while ((piece = nextPiece.fetch_add(1)) + 1 < cuts.size()) {
+            Chunk& chunk = chunks[first + piece];
+            const char* line = data + cuts[piece];
+            const char* pieceEnd = data + cuts[piece + 1];
+            while (line < pieceEnd) {
+                const char* lineEnd = static_cast<const char*>(std::memchr(line, '\n', size_t(pieceEnd - line)));
+                if (!lineEnd)
+                    lineEnd = pieceEnd;
+
+                // Four FEN fields, and the move counters if they are there
+                fen.clear();
+                const char* p = line;
+                for (int field = 0; field < 6; ++field) {
+                    while (p < lineEnd && (*p == ' ' || *p == '\t')) ++p;
+                    const char* fieldEnd = p;
+                    while (fieldEnd < lineEnd && *fieldEnd != ' ' && *fieldEnd != '\t' && *fieldEnd != '\r') ++fieldEnd;
+                    if (fieldEnd == p || (field >= 4 && std::find_if(p, fieldEnd, [](char c) { return c < '0' || c > '9'; }) != fieldEnd))
+                        break;
+                    fen.append(field ? " " : "").append(p, fieldEnd);
+                    p = fieldEnd;
+                }
+                float result = parseResult(p, lineEnd);
+                bool blank = fen.empty();
+                line = lineEnd + 1;
+                if (blank)
+                    continue;
+                if (result < 0 || !pos.setFen(fen) || pos.inCheck()) {
+                    skipped++;
+                    continue;
+                }
+
+                // The linear part at the starting weights is taken out of the
+                // evaluation; what is left doesn't depend on the weights
+                int eval = engine.traceEvaluation(pos, trace);
+                double linear = 0;
+                int phase = trace.phase;
+                auto add = [&](int term, int count) {
+                    if (count == 0)
+                        return;
+                    chunk.coefficients.push_back({uint16_t(term), int16_t(count)});
+                    linear += count * (weights[2 * term] * phase + weights[2 * term + 1] * (MaxPhase - phase)) / MaxPhase;
+                };
+                for (int type = 0; type < 6; ++type) {
+                    add(MaterialTerm + type, trace.material[type]);
+                    add(MobilityTerm + type, trace.mobility[type]);
+                    for (int square = 0; square < 64; ++square)
+                        add(PieceSquareTerm + 64 * type + square, trace.pieceSquare[type][square]);
+                }
+                add(RookOpenFileTerm, trace.rookOpenFile);
+                add(RookSemiOpenFileTerm, trace.rookSemiOpenFile);
+                add(BishopPairTerm, trace.bishopPair);
+
+                chunk.ends.push_back(uint32_t(chunk.coefficients.size()));
+                chunk.results.push_back(result);
+                chunk.rests.push_back(float(eval - linear));
+                chunk.phases.push_back(uint8_t(phase));
+                added++;
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (int i = 1; i < threadCount; ++i)
+        workers.emplace_back(worker);
+    worker();
+    for (std::thread& t : workers)
+        t.join();
+    positions += added;
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    char text[160];
+    std::snprintf(text, sizeof(text), ": %llu positions, %llu skipped (%.1fs)",
+                  (unsigned long long)added, (unsigned long long)skipped, seconds);
+    message(path + text);
+    return true;
+}
+
+double EvalTuner::pass(std::vector<double>* gradient)
+{
+    const double k = scale * std::log(10.0) / 400.0;
+    std::atomic<size_t> nextChunk(0);
+    std::mutex lock;
+    double total = 0;
+    if (gradient)
+        gradient->assign(weights.size(), 0.0);
+
+    auto worker = [&]() {
+        std::vector<double> local(gradient ? weights.size() : 0, 0.0);
+        double error = 0;
+        size_t n;
+        while ((n = nextChunk.fetch_add(1)) < chunks.size()) {
+            const Chunk& chunk = chunks[n];
+            uint32_t begin = 0;
+            for (size_t i = 0; i < chunk.results.size(); ++i) {
+                uint32_t end = chunk.ends[i];
+                double mg = chunk.phases[i] / double(MaxPhase), eg = 1 - mg;
+                double eval = chunk.rests[i];
+                for (uint32_t c = begin; c < end; ++c) {
+                    const Coefficient& coefficient = chunk.coefficients[c];
+                    eval += coefficient.count * (weights[2 * coefficient.term] * mg + weights[2 * coefficient.term + 1] * eg);
+                }
+
+                double predicted = 1 / (1 + std::exp(-k * eval));
+                double miss = chunk.results[i] - predicted;
+                error += miss * miss;
+                if (gradient) {
+                    double slope = -2 * miss * k * predicted * (1 - predicted);
+                    for (uint32_t c = begin; c < end; ++c) {
+                        const Coefficient& coefficient = chunk.coefficients[c];
+                        local[2 * coefficient.term] += slope * coefficient.count * mg;
+                        local[2 * coefficient.term + 1] += slope * coefficient.count * eg;
+                    }
+                }
+                begin = end;
+            }
+        }
+
+        std::lock_guard<std::mutex> guard(lock);
+        total += error;
+        for (size_t i = 0; i < local.size(); ++i)
+            (*gradient)[i] += local[i];
+    };
+
+    std::vector<std::thread> workers;
+    for (int i = 1; i < threadCount; ++i)
+        workers.emplace_back(worker);
+    worker();
+    for (std::thread& t : workers)
+        t.join();
+
+    double count = std::max<size_t>(positions, 1);
+    if (gradient) {
+        for (double& g : *gradient)
+            g /= count;
+    }
+    return total / count;
+}
+
+double EvalTuner::error()
+{
+    return pass(nullptr);
+}
+
+double EvalTuner::fitScale()
+{
+    // Golden section search; the error is unimodal in the scale
+    const double ratio = (std::sqrt(5.0) - 1) / 2;
+    double low = 0.05, high = 5.0;
+    auto errorAt = [this](double k) {
+        scale = k;
+        return pass(nullptr);
+    };
+    double a = high - ratio * (high - low), b = low + ratio * (high - low);
+    double errorA = errorAt(a), errorB = errorAt(b);
+    while (high - low > 1e-4) {
+        if (errorA < errorB) {
+            high = b;
+            b = a;
+            errorB = errorA;
+            a = high - ratio * (high - low);
+            errorA = errorAt(a);
+        } else {
+            low = a;
+            a = b;
+            errorA = errorB;
+            b = low + ratio * (high - low);
+            errorB = errorAt(b);
+        }
+    }
+    scale = (low + high) / 2;
+    return scale;
+}
+
+bool EvalTuner::tune(int epochs, double learningRate, const std::string& outPath)
+{
+    const double beta1 = 0.9, beta2 = 0.999, epsilon = 1e-8;
+    std::vector<double> gradient, moment(weights.size(), 0.0), velocity(weights.size(), 0.0);
+    auto startTime = std::chrono::steady_clock::now();
+    int reportEvery = std::max(1, epochs / 20);
+
+    for (int epoch = 1; epoch <= epochs; ++epoch) {
+        double error = pass(&gradient);
+        double correction1 = 1 - std::pow(beta1, epoch), correction2 = 1 - std::pow(beta2, epoch);
+        for (size_t i = 0; i < weights.size(); ++i) {
+            moment[i] = beta1 * moment[i] + (1 - beta1) * gradient[i];
+            velocity[i] = beta2 * velocity[i] + (1 - beta2) * gradient[i] * gradient[i];
+            weights[i] -= learningRate * (moment[i] / correction1) / (std::sqrt(velocity[i] / correction2) + epsilon);
+        }
+        // Both kings are always on, so their value means nothing
+        weights[2 * (MaterialTerm + KING)] = weights[2 * (MaterialTerm + KING) + 1] = 0;
+
+        if (epoch % reportEvery == 0 || epoch == epochs) {
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+            char text[120];
+            std::snprintf(text, sizeof(text), "epoch %d/%d: error %.6f (%.1fs)", epoch, epochs, error, seconds);
+            message(text);
+            if (!writeParams(outPath))
+                return false;
+        }
+    }
+    return epochs > 0 || writeParams(outPath);
+}
+
+bool EvalTuner::writeParams(const std::string& path) const
+{
+    std::FILE* out = std::fopen(path.c_str(), "w");
+    if (!out) {
+        message(path + ": could not be written");
+        return false;
+    }
+    auto weight = [this](int term, int phase) { return int(std::lround(weights[2 * term + phase])); };
+
+    std::fprintf(out, "// Weights of the hand-written evaluation, {middlegame, endgame} (see ChessAI::evaluateBoard).\n"
+                      "// Generated by \"chesstool tune\" - do not edit.\n\n"
+                      "static const int PieceValue[6][2] = {\n    ");
+    for (int type = 0; type < 6; ++type)
+        std::fprintf(out, "{%d, %d}%s", weight(MaterialTerm + type, 0), weight(MaterialTerm + type, 1), type < 5 ? ", " : "\n");
+    std::fprintf(out, "};\n\n"
+                      "// Piece-square tables, middlegame then endgame, drawn with the 8th rank on top as seen by white\n"
+                      "static const int PieceSquare[6][2][64] = {\n");
+    for (int type = 0; type < 6; ++type) {
+        std::fprintf(out, "    { // %s\n", PieceNames[type]);
+        for (int phase = 0; phase < 2; ++phase) {
+            std::fprintf(out, "        {\n");
+            for (int square = 0; square < 64; ++square) {
+                std::fprintf(out, "%s%4d%s", square % 8 == 0 ? "            " : ", ",
+                             weight(PieceSquareTerm + 64 * type + square, phase),
+                             square == 63 ? "\n" : (square % 8 == 7 ? ",\n" : ""));
+            }
+            std::fprintf(out, "        }%s\n", phase == 0 ? "," : "");
+        }
+        std::fprintf(out, "    }%s\n", type < 5 ? "," : "");
+    }
+    std::fprintf(out, "};\n\n"
+                      "// Per reachable square beyond MobilityBase\n"
+                      "static const int MobilityWeight[6][2] = {\n    ");
+    for (int type = 0; type < 6; ++type)
+        std::fprintf(out, "{%d, %d}%s", weight(MobilityTerm + type, 0), weight(MobilityTerm + type, 1), type < 5 ? ", " : "\n");
+    std::fprintf(out, "};\n\n"
+                      "static const int RookOpenFileBonus[2] = {%d, %d};\n"
+                      "static const int RookSemiOpenFileBonus[2] = {%d, %d};\n"
+                      "static const int BishopPairBonus[2] = {%d, %d};\n",
+                 weight(RookOpenFileTerm, 0), weight(RookOpenFileTerm, 1),
+                 weight(RookSemiOpenFileTerm, 0), weight(RookSemiOpenFileTerm, 1),
+                 weight(BishopPairTerm, 0), weight(BishopPairTerm, 1));
+    bool ok = std::fclose(out) == 0;
+    if (!ok)
+        message(path + ": could not be written");
+    return ok;
+}
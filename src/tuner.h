@@ -0,0 +1,71 @@
+#ifndef TUNER_H
+#define TUNER_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Fits the weights of the hand-written evaluation (evalparams.inc) to game
+// results, Texel style: the evaluation of a quiet position, squashed by a
+// logistic curve, should predict the result of the game it came from.
+//
+// Every position is traced once when it is loaded (ChessAI::traceEvaluation),
+// which turns the evaluation into a sparse linear form per phase plus a
+// fixed rest for the terms that aren't tuned. Each training pass then only
+// walks those coefficients. Passes run on all cores, each thread summing
+// the gradient of its own chunks of positions, and Adam updates the
+// weights on the full-batch gradient.
+class EvalTuner {
+public:
+    explicit EvalTuner(int threads = 0); // 0 = all cores
+
+    void setLogger(std::function<void(const std::string&)> logger) { log = logger; }
+
+    // Add the positions of an EPD or FEN file, one per line, each followed
+    // by its game's result for white: "1-0", "0-1", "1/2-1/2" (also in
+    // quotes, as in c9 "1-0";) or [1.0], [0.5], [0.0]. Positions in check
+    // are left out, as they aren't quiet.
+    bool addPositions(const std::string& path);
+    size_t positionCount() const { return positions; }
+
+    // Logistic scale that fits the current weights best
+    double fitScale();
+    void setScale(double k) { scale = k; }
+
+    // Mean squared error of the current weights
+    double error();
+
+    // Adam over the full set for the given number of passes. The rounded
+    // weights are written to outPath at every progress line and at the end.
+    bool tune(int epochs, double learningRate, const std::string& outPath);
+
+    // Write the rounded weights in the layout of evalparams.inc
+    bool writeParams(const std::string& path) const;
+
+private:
+    struct Coefficient {
+        uint16_t term;
+        int16_t count;
+    };
+    struct Chunk {
+        std::vector<Coefficient> coefficients;
+        std::vector<uint32_t> ends;    // Position i's coefficients end at ends[i]
+        std::vector<float> results;    // 0, 0.5 or 1
+        std::vector<float> rests;      // Evaluation left when the tuned terms are taken out
+        std::vector<uint8_t> phases;
+    };
+
+    int threadCount;
+    double scale;
+    size_t positions;
+    std::vector<double> weights; // Middlegame and endgame weight of each term
+    std::vector<Chunk> chunks;
+    std::function<void(const std::string&)> log;
+
+    void message(const std::string& text) const { if (log) log(text); }
+    // Error, and the gradient of it if gradient isn't null
+    double pass(std::vector<double>* gradient);
+};
+
+#endif // TUNER_H
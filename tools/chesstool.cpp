@@ -0,0 +1,900 @@
+// chesstool - command line utilities for the chess engine
+//
+// Usage:
+//   chesstool perft [depth] [fen]   Count move tree leaves (default: the start position)
+//   chesstool perftsuite [depth]    Perft of the standard test positions against known counts
+//   chesstool divide <depth> [fen]  Per-move perft breakdown
+//   chesstool tbgen <dir> [pieces] [threads] [--wdl-only]
+//                                   Generate endgame tablebases (default 5 pieces, all cores)
+//   chesstool kpkgen [file]         Solve KPK and write the embedded bitbase source
+//                                   (without a file, check the compiled-in copy)
+//   chesstool book <out.bin> <games.pgn>... [--plies N] [--min-games N] [--threads N]
+//                                   Build an opening book from PGN files
+//   chesstool book --check          Compare book keys with published Polyglot keys
+//   chesstool dbimport <out.cbdb> <games.pgn>... [--index-plies N] [--threads N]
+//                                   Build a game database from PGN files
+//   chesstool dbexport <db.cbdb> <out.pgn>
+//                                   Write a game database back out as PGN
+//   chesstool dbfind <db.cbdb> [fen] List the games reaching a position
+//   chesstool analyze <games.pgn> <out> [--nodes N | --time ms | --depth N] [--threads N]
+//                     [--hash MB] [--nnue file] [--tb dir] [--json] [--multipv N]
+//                                   Annotate every move with the engine's evaluation
+//   chesstool match --engine <spec> --engine <spec> --openings file.epd [--games N]
+//                   [--sprt elo0 elo1] [--max-plies N] [--threads N] [--pgn out.pgn]
+//                                   Play two engine configurations against each other
+//                                   (spec: name=...,nodes=N,time=ms,depth=N,hash=MB,nnue=file,tb=dir,
+//                                   mcts=threads)
+//   chesstool epd <suite.epd> [--time ms | --nodes N | --depth N] [--threads N] [--hash MB]
+//                                   Run a test suite (bm/am/c0) and report solutions and
+//                                   time to solution
+//   chesstool mate <fen | suite.epd> [--moves N] [--checks] [--nodes N] [--hash MB]
+//                                   Find the shortest forced mate; a suite's "dm N"
+//                                   operations are checked against the mates found
+//   chesstool tune <out.inc> <positions.epd>... [--epochs N] [--rate R] [--scale K] [--threads N]
+//                                   Fit the evaluation weights to game results; copy the
+//                                   output over src/evalparams.inc and rebuild to use them
+//   chesstool bench [depth] [--hash MB] [--expect N]
+//                                   Search fixed positions single-threaded and print the
+//                                   node total, which only changes with the search itself
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include "position.h"
+#include "movegen.h"
+#include "tbgen.h"
+#include "kpk.h"
+#include "bookbuilder.h"
+#include "openingbook.h"
+#include "gamedb.h"
+#include "gamedbbuilder.h"
+#include "pgn.h"
+#include "analysis.h"
+#include "match.h"
+#include "tuner.h"
+#include "epdsuite.h"
+#include "matesearch.h"
+#include "san.h"
+#include <sstream>
+
+static double secondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Standard move generator test positions with their published leaf counts
+struct PerftCase {
+    const char* fen;
+    uint64_t nodes[7]; // By depth, 0 where no count is given
+};
+
+static const PerftCase perftSuite[] = {
+    {START_FEN, {1, 20, 400, 8902, 197281, 4865609, 119060324}},
+    {"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+     {1, 48, 2039, 97862, 4085603, 193690690, 0}},
+    {"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+     {1, 14, 191, 2812, 43238, 674624, 11030083}},
+    {"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+     {1, 6, 264, 9467, 422333, 15833292, 0}},
+    {"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+     {1, 44, 1486, 62379, 2103487, 89941194, 0}},
+    {"r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+     {1, 46, 2079, 89890, 3894594, 164075551, 0}},
+};
+
+// Positions of the bench: openings, middlegames and endgames with
+// tactics, promotions and castling, each searched from an empty table
+static const char* benchPositions[] = {
+    START_FEN,
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    "r1bqkb1r/pppp1ppp/2n2n2/4p3/2B1P3/5N2/PPPP1PPP/RNBQK2R w KQkq - 4 4",
+    "2rq1rk1/pp1bppbp/2np1np1/8/3NP3/1BN1BP2/PPPQ2PP/2KR3R b - - 8 11",
+    "r1b2rk1/2q1bppp/p2p1n2/np2p3/3PP3/2P2N1P/PPBN1PP1/R1BQR1K1 w - - 1 12",
+    "8/5pk1/6p1/1p5p/1P3P1P/6P1/5K2/8 w - - 0 1",
+    "8/8/4k3/8/2R5/8/4K3/8 w - - 0 1",
+    "8/pp3k2/2p1p3/3pPp2/3P1P2/2P3P1/PP4K1/8 w - - 0 1",
+};
+
+// Everything after the fixed arguments, joined, so FENs work without quotes
+static std::string joinArgs(int argc, char** argv, int first)
+{
+    std::string text;
+    for (int i = first; i < argc; ++i) {
+        if (!text.empty()) text += ' ';
+        text += argv[i];
+    }
+    return text;
+}
+
+static bool setUp(Position& pos, const std::string& fen)
+{
+    if (fen.empty() || pos.setFen(fen))
+        return true;
+    std::printf("not a legal FEN: %s\n", fen.c_str());
+    return false;
+}
+
+// Count up to maxDepth; expected may be null or hold 0 for unknown counts
+static bool perftPosition(Position& pos, int maxDepth, const uint64_t* expected)
+{
+    bool ok = true;
+    for (int depth = 1; depth <= maxDepth; ++depth) {
+        auto start = std::chrono::steady_clock::now();
+        uint64_t nodes = perft(pos, depth);
+        double seconds = secondsSince(start);
+
+        uint64_t reference = expected && depth < 7 ? expected[depth] : 0;
+        const char* verdict = reference ? (nodes == reference ? "ok" : "MISMATCH") : "";
+        if (reference && nodes != reference) ok = false;
+        std::printf("depth %2d  nodes %12llu  %8.3fs  %7.2f Mnps  %s\n", depth,
+                    (unsigned long long)nodes, seconds, seconds > 0 ? nodes / seconds / 1e6 : 0.0, verdict);
+    }
+    return ok;
+}
+
+static int runPerft(int argc, char** argv)
+{
+    int maxDepth = argc > 2 ? std::atoi(argv[2]) : 5;
+    std::string fen = joinArgs(argc, argv, 3);
+
+    Position pos;
+    if (!setUp(pos, fen))
+        return 1;
+    // Reference counts are only known for the initial position
+    return perftPosition(pos, maxDepth, fen.empty() ? perftSuite[0].nodes : nullptr) ? 0 : 1;
+}
+
+static int runPerftSuite(int argc, char** argv)
+{
+    int maxDepth = argc > 2 ? std::atoi(argv[2]) : 4;
+    bool ok = true;
+    for (const PerftCase& test : perftSuite) {
+        Position pos;
+        pos.setFen(test.fen);
+        std::printf("%s\n", test.fen);
+        ok = perftPosition(pos, maxDepth, test.nodes) && ok;
+    }
+    std::printf("%s\n", ok ? "all counts match" : "MISMATCH");
+    return ok ? 0 : 1;
+}
+
+static int runDivide(int argc, char** argv)
+{
+    int depth = argc > 2 ? std::atoi(argv[2]) : 1;
+    Position pos;
+    if (!setUp(pos, joinArgs(argc, argv, 3)))
+        return 1;
+    MoveList moves;
+    generateLegalMoves(pos, moves);
+
+    uint64_t total = 0;
+    for (PackedMove m : moves) {
+        pos.makeMove(m);
+        uint64_t nodes = depth > 1 ? perft(pos, depth - 1) : 1;
+        pos.unmakeMove(m);
+        total += nodes;
+        std::printf("%s: %llu\n", moveToUci(m).c_str(), (unsigned long long)nodes);
+    }
+    std::printf("\nmoves %d  nodes %llu\n", moves.size(), (unsigned long long)total);
+    return 0;
+}
+
+static int runTablebaseGenerator(int argc, char** argv)
+{
+    if (argc < 3) {
+        std::printf("tbgen: missing output directory\n");
+        return 1;
+    }
+
+    std::vector<const char*> numbers;
+    bool wdlOnly = false;
+    for (int i = 3; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--wdl-only") == 0) wdlOnly = true;
+        else numbers.push_back(argv[i]);
+    }
+    int maxPieces = numbers.size() > 0 ? std::atoi(numbers[0]) : TB_MAX_PIECES;
+    int threads = numbers.size() > 1 ? std::atoi(numbers[1]) : 0;
+
+    TablebaseGenerator generator(threads);
+    generator.setWriteDtm(!wdlOnly);
+    generator.setLogger([](const std::string& line) {
+        std::printf("%s\n", line.c_str());
+        std::fflush(stdout);
+    });
+
+    auto start = std::chrono::steady_clock::now();
+    bool ok = generator.generateAll(argv[2], maxPieces);
+    std::printf("%s in %.1fs\n", ok ? "done" : "failed", secondsSince(start));
+    return ok ? 0 : 1;
+}
+
+static int runKpkGenerator(int argc, char** argv)
+{
+    auto start = std::chrono::steady_clock::now();
+    std::vector<uint32_t> bits = generateKpkBitbase();
+
+    int wins = 0, mismatches = 0;
+    for (int i = 0; i < KPK_POSITIONS; ++i) {
+        bool win = bits[i >> 5] & (1u << (i & 31));
+        wins += win;
+
+        // Decode the index the same way the probe encodes it
+        Square strongKing = Square(i & 63), weakKing = Square((i >> 6) & 63);
+        Color stm = Color((i >> 12) & 1);
+        Square pawn = makeSquare((i >> 13) & 3, 6 - ((i >> 15) & 7));
+        if (win != kpkProbe(WHITE, strongKing, pawn, weakKing, stm))
+            ++mismatches;
+    }
+    std::printf("KPK solved in %.2fs: %d winning positions\n", secondsSince(start), wins);
+
+    if (argc < 3) {
+        std::printf("embedded bitbase %s\n", mismatches ? "is OUT OF DATE" : "matches");
+        return mismatches ? 1 : 0;
+    }
+
+    std::FILE* out = std::fopen(argv[2], "w");
+    if (!out) {
+        std::printf("kpkgen: cannot write %s\n", argv[2]);
+        return 1;
+    }
+    std::fprintf(out, "// KPK bitbase, one bit per position (see kpk.h).\n"
+                      "// Generated by \"chesstool kpkgen\" - do not edit.\n\n"
+                      "static const uint32_t KpkBitbase[%d] = {\n", KPK_POSITIONS / 32);
+    for (size_t i = 0; i < bits.size(); ++i) {
+        std::fprintf(out, "%s0x%08x%s", i % 8 == 0 ? "    " : "", bits[i],
+                     i + 1 == bits.size() ? "\n" : (i % 8 == 7 ? ",\n" : ", "));
+    }
+    std::fprintf(out, "};\n");
+    std::fclose(out);
+    std::printf("wrote %s\n", argv[2]);
+    return 0;
+}
+
+// Book keys of positions against the values published with the Polyglot format
+static int checkBookKeys()
+{
+    static const struct {
+        const char* fen;
+        uint64_t key;
+    } published[] = {
+        {START_FEN, 0x463B96181691FC9CULL},
+        {"rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1", 0x823C9B50FD114196ULL},
+        {"rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3", 0x22A48B5A8E47FF78ULL},
+        {"rnbq1bnr/ppp1pkpp/8/3pPp2/8/8/PPPPKPPP/RNBQ1BNR w - - 0 4", 0x00FDD303C946BDD9ULL},
+    };
+    bool ok = true;
+    for (const auto& test : published) {
+        Position pos;
+        pos.setFen(test.fen);
+        uint64_t key = OpeningBook::key(pos);
+        std::printf("%016llx  %s  %s\n", (unsigned long long)key, key == test.key ? "ok" : "MISMATCH", test.fen);
+        ok = ok && key == test.key;
+    }
+    std::printf("%s\n", ok ? "keys match Polyglot" : "keys don't match Polyglot");
+    return ok ? 0 : 1;
+}
+
+static int runBookBuilder(int argc, char** argv)
+{
+    if (argc == 3 && std::strcmp(argv[2], "--check") == 0)
+        return checkBookKeys();
+
+    std::vector<const char*> files;
+    int plies = 30, minGames = 2, threads = 0;
+    for (int i = 2; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--plies") == 0 && i + 1 < argc) plies = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--min-games") == 0 && i + 1 < argc) minGames = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) threads = std::atoi(argv[++i]);
+        else files.push_back(argv[i]);
+    }
+    if (files.size() < 2) {
+        std::printf("book: need an output file and at least one PGN file\n");
+        return 1;
+    }
+
+    BookBuilder builder(threads);
+    builder.setMaxPlies(plies);
+    builder.setMinGames(minGames);
+    builder.setLogger([](const std::string& line) {
+        std::printf("%s\n", line.c_str());
+        std::fflush(stdout);
+    });
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 1; i < files.size(); ++i) {
+        if (!builder.addPgn(files[i]))
+            return 1;
+    }
+    bool ok = builder.write(files[0]);
+    std::printf("%s: %llu games in %.1fs\n", ok ? "done" : "failed",
+                (unsigned long long)builder.gameCount(), secondsSince(start));
+    return ok ? 0 : 1;
+}
+
+static int runDbImport(int argc, char** argv)
+{
+    std::vector<const char*> files;
+    int indexPlies = 0, threads = 0;
+    for (int i = 2; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--index-plies") == 0 && i + 1 < argc) indexPlies = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) threads = std::atoi(argv[++i]);
+        else files.push_back(argv[i]);
+    }
+    if (files.size() < 2) {
+        std::printf("dbimport: need an output file and at least one PGN file\n");
+        return 1;
+    }
+
+    GameDatabaseBuilder builder(threads);
+    builder.setIndexPlies(indexPlies);
+    builder.setLogger([](const std::string& line) {
+        std::printf("%s\n", line.c_str());
+        std::fflush(stdout);
+    });
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 1; i < files.size(); ++i) {
+        if (!builder.addPgn(files[i]))
+            return 1;
+    }
+    bool ok = builder.write(files[0]);
+    std::printf("%s: %u games in %.1fs\n", ok ? "done" : "failed", builder.gameCount(), secondsSince(start));
+    return ok ? 0 : 1;
+}
+
+static int runDbExport(int argc, char** argv)
+{
+    if (argc < 4) {
+        std::printf("dbexport: need a database and an output file\n");
+        return 1;
+    }
+    GameDatabase db;
+    if (!db.open(argv[2])) {
+        std::printf("dbexport: %s is not a game database\n", argv[2]);
+        return 1;
+    }
+    std::ofstream out(argv[3]);
+    if (!out) {
+        std::printf("dbexport: cannot write %s\n", argv[3]);
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    DbGame game;
+    uint32_t damaged = 0;
+    for (uint32_t i = 0; i < db.gameCount(); ++i) {
+        if (!db.readGame(i, game)) {
+            damaged++;
+            continue;
+        }
+        writePgnGame(out, game.tags, game.start, game.moves, game.result);
+    }
+    out.close();
+    std::printf("%s: %u games, %u damaged, in %.1fs\n", argv[3], db.gameCount() - damaged, damaged,
+                secondsSince(start));
+    return out ? 0 : 1;
+}
+
+static int runDbFind(int argc, char** argv)
+{
+    if (argc < 3) {
+        std::printf("dbfind: need a database\n");
+        return 1;
+    }
+    GameDatabase db;
+    if (!db.open(argv[2])) {
+        std::printf("dbfind: %s is not a game database\n", argv[2]);
+        return 1;
+    }
+    Position pos;
+    if (!setUp(pos, joinArgs(argc, argv, 3)))
+        return 1;
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<DbHit> hits = db.find(pos);
+    double seconds = secondsSince(start);
+
+    uint64_t score[4] = {};
+    DbGame game;
+    const size_t listed = 20;
+    for (size_t i = 0; i < hits.size(); ++i) {
+        db.readGame(hits[i].game, game, 0);
+        score[GameDatabase::resultCode(game.result)]++;
+        if (i < listed) {
+            std::printf("%8u  ply %3u  %s - %s  %s  %s\n", hits[i].game, hits[i].ply, game.tag("White").c_str(),
+                        game.tag("Black").c_str(), game.tag("Date").c_str(), game.result.c_str());
+        }
+    }
+    if (hits.size() > listed)
+        std::printf("...\n");
+    std::printf("%zu games (+%llu =%llu -%llu for white, %llu unfinished), index search %.3f ms\n", hits.size(),
+                (unsigned long long)score[1], (unsigned long long)score[3], (unsigned long long)score[2],
+                (unsigned long long)score[0], seconds * 1000);
+    return 0;
+}
+
+static int runAnalyze(int argc, char** argv)
+{
+    std::vector<const char*> files;
+    SearchLimits limits;
+    int threads = 0, hashMegabytes = 16;
+    const char* network = nullptr;
+    const char* tablebaseDir = nullptr;
+    bool json = false;
+    int multiPv = 1;
+    for (int i = 2; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--nodes") == 0 && i + 1 < argc) limits.nodes = std::strtoull(argv[++i], nullptr, 10);
+        else if (std::strcmp(argv[i], "--time") == 0 && i + 1 < argc) limits.milliseconds = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--depth") == 0 && i + 1 < argc) limits.depth = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) threads = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--hash") == 0 && i + 1 < argc) hashMegabytes = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--nnue") == 0 && i + 1 < argc) network = argv[++i];
+        else if (std::strcmp(argv[i], "--tb") == 0 && i + 1 < argc) tablebaseDir = argv[++i];
+        else if (std::strcmp(argv[i], "--json") == 0) json = true;
+        else if (std::strcmp(argv[i], "--multipv") == 0 && i + 1 < argc) multiPv = std::atoi(argv[++i]);
+        else files.push_back(argv[i]);
+    }
+    if (files.size() != 2) {
+        std::printf("analyze: need a PGN file and an output file\n");
+        return 1;
+    }
+
+    BatchAnalyzer analyzer(threads);
+    if (limits.nodes || limits.milliseconds || limits.depth)
+        analyzer.setLimits(limits);
+    analyzer.setHashSize(size_t(std::max(1, hashMegabytes)) * 1024);
+    analyzer.setJson(json);
+    analyzer.setMultiPv(multiPv);
+    if (network) {
+        auto loaded = std::make_shared<NnueNetwork>();
+        if (!loaded->load(network)) {
+            std::printf("analyze: %s is not a usable network\n", network);
+            return 1;
+        }
+        analyzer.setNetwork(loaded);
+    }
+    if (tablebaseDir) {
+        auto loaded = std::make_shared<Tablebases>();
+        std::printf("%s: %d tablebases\n", tablebaseDir, loaded->load(tablebaseDir));
+        analyzer.setTablebases(loaded);
+    }
+    analyzer.setLogger([](const std::string& line) {
+        std::printf("%s\n", line.c_str());
+        std::fflush(stdout);
+    });
+
+    auto start = std::chrono::steady_clock::now();
+    bool ok = analyzer.run(files[0], files[1]);
+    std::printf("%s in %.1fs\n", ok ? "done" : "failed", secondsSince(start));
+    return ok ? 0 : 1;
+}
+
+// Engine spec of the match command: comma-separated key=value pairs
+static bool parseEngineConfig(const char* spec, EngineConfig& config)
+{
+    std::string text = spec;
+    size_t from = 0;
+    while (from < text.size()) {
+        size_t to = text.find(',', from);
+        if (to == std::string::npos)
+            to = text.size();
+        std::string item = text.substr(from, to - from);
+        from = to + 1;
+
+        size_t eq = item.find('=');
+        if (eq == std::string::npos) {
+            std::printf("match: '%s' is not key=value\n", item.c_str());
+            return false;
+        }
+        std::string key = item.substr(0, eq), value = item.substr(eq + 1);
+        if (key == "name") {
+            config.name = value;
+        } else if (key == "nodes") {
+            config.limits.nodes = std::strtoull(value.c_str(), nullptr, 10);
+        } else if (key == "time") {
+            config.limits.milliseconds = std::atoi(value.c_str());
+        } else if (key == "depth") {
+            config.limits.depth = std::atoi(value.c_str());
+        } else if (key == "hash") {
+            config.hashKilobytes = size_t(std::max(1, std::atoi(value.c_str()))) * 1024;
+        } else if (key == "nnue") {
+            auto loaded = std::make_shared<NnueNetwork>();
+            if (!loaded->load(value)) {
+                std::printf("match: %s is not a usable network\n", value.c_str());
+                return false;
+            }
+            config.network = loaded;
+        } else if (key == "mcts") {
+            config.mctsThreads = std::max(1, std::atoi(value.c_str()));
+        } else if (key == "tb") {
+            auto loaded = std::make_shared<Tablebases>();
+            std::printf("%s: %d tablebases\n", value.c_str(), loaded->load(value));
+            config.tablebases = loaded;
+        } else {
+            std::printf("match: unknown engine option '%s'\n", key.c_str());
+            return false;
+        }
+    }
+    if (!config.limits.nodes && !config.limits.milliseconds && !config.limits.depth)
+        config.limits.nodes = 20000;
+    return true;
+}
+
+static int runMatch(int argc, char** argv)
+{
+    std::vector<EngineConfig> engines;
+    const char* openings = nullptr;
+    const char* pgn = nullptr;
+    int games = 1000, maxPlies = 400, threads = 0;
+    double elo0 = 0, elo1 = 0;
+    bool sprt = false;
+    for (int i = 2; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--engine") == 0 && i + 1 < argc) {
+            EngineConfig config;
+            config.name = "engine" + std::to_string(engines.size() + 1);
+            if (!parseEngineConfig(argv[++i], config))
+                return 1;
+            engines.push_back(config);
+        } else if (std::strcmp(argv[i], "--openings") == 0 && i + 1 < argc) {
+            openings = argv[++i];
+        } else if (std::strcmp(argv[i], "--games") == 0 && i + 1 < argc) {
+            games = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--sprt") == 0 && i + 2 < argc) {
+            elo0 = std::atof(argv[++i]);
+            elo1 = std::atof(argv[++i]);
+            sprt = true;
+        } else if (std::strcmp(argv[i], "--max-plies") == 0 && i + 1 < argc) {
+            maxPlies = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--pgn") == 0 && i + 1 < argc) {
+            pgn = argv[++i];
+        } else {
+            std::printf("match: unknown argument '%s'\n", argv[i]);
+            return 1;
+        }
+    }
+    if (engines.size() != 2) {
+        std::printf("match: need exactly two --engine specs\n");
+        return 1;
+    }
+    if (sprt && elo1 <= elo0) {
+        std::printf("match: --sprt needs elo0 < elo1\n");
+        return 1;
+    }
+
+    MatchRunner runner(threads);
+    runner.setGames(games);
+    runner.setMaxPlies(maxPlies);
+    if (sprt)
+        runner.setSprt(elo0, elo1);
+    if (pgn)
+        runner.setPgnOutput(pgn);
+    // Searches with a node budget are deterministic, so every pair needs
+    // its own opening or it only replays an earlier one
+    if (!openings) {
+        std::printf("match: need --openings, one start position per game pair\n");
+        return 1;
+    }
+    int count = runner.loadOpenings(openings);
+    std::printf("%s: %d openings\n", openings, count);
+    if (count == 0)
+        return 1;
+    runner.setLogger([](const std::string& line) {
+        std::printf("%s\n", line.c_str());
+        std::fflush(stdout);
+    });
+
+    runner.run(engines[0], engines[1]);
+    return 0;
+}
+
+static int runEpdSuite(int argc, char** argv)
+{
+    const char* path = nullptr;
+    SearchLimits limits;
+    int threads = 0, hashMegabytes = 16;
+    for (int i = 2; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--time") == 0 && i + 1 < argc) limits.milliseconds = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--nodes") == 0 && i + 1 < argc) limits.nodes = std::strtoull(argv[++i], nullptr, 10);
+        else if (std::strcmp(argv[i], "--depth") == 0 && i + 1 < argc) limits.depth = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) threads = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--hash") == 0 && i + 1 < argc) hashMegabytes = std::atoi(argv[++i]);
+        else path = argv[i];
+    }
+    if (!path) {
+        std::printf("epd: need a suite file\n");
+        return 1;
+    }
+
+    EpdSuiteRunner runner(threads);
+    if (limits.milliseconds || limits.nodes || limits.depth)
+        runner.setLimits(limits);
+    runner.setHashSize(size_t(std::max(1, hashMegabytes)) * 1024);
+    runner.setLogger([](const std::string& line) {
+        std::printf("%s\n", line.c_str());
+        std::fflush(stdout);
+    });
+    if (runner.load(path) == 0)
+        return 1;
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<EpdOutcome> outcomes = runner.run();
+    int solved = 0, points = 0, maxPoints = 0;
+    double searchSeconds = 0, solveSeconds = 0;
+    uint64_t solveNodes = 0;
+    for (size_t i = 0; i < outcomes.size(); ++i) {
+        searchSeconds += outcomes[i].seconds;
+        points += outcomes[i].points;
+        maxPoints += runner.entries()[i].maxPoints();
+        if (outcomes[i].solved) {
+            ++solved;
+            solveSeconds += outcomes[i].solveSeconds;
+            solveNodes += outcomes[i].solveNodes;
+        }
+    }
+    std::printf("solved %d/%zu (%.1f%%)", solved, outcomes.size(), 100.0 * solved / outcomes.size());
+    if (maxPoints > 0)
+        std::printf(", %d/%d points", points, maxPoints);
+    std::printf("\ntime to solution %.3fs and %llu nodes on average; %.2f solutions per search second\n",
+                solved ? solveSeconds / solved : 0.0, (unsigned long long)(solved ? solveNodes / solved : 0),
+                searchSeconds > 0 ? solved / searchSeconds : 0.0);
+    std::printf("%.1fs of search in %.1fs\n", searchSeconds, secondsSince(start));
+    return 0;
+}
+
+static int runBench(int argc, char** argv)
+{
+    int depth = 6, hashMegabytes = 16;
+    uint64_t expected = 0;
+    for (int i = 2; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--hash") == 0 && i + 1 < argc) hashMegabytes = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--expect") == 0 && i + 1 < argc) expected = std::strtoull(argv[++i], nullptr, 10);
+        else depth = std::max(1, std::atoi(argv[i]));
+    }
+
+    // One thread, a fixed depth and a fresh engine for every position: the
+    // node total depends on nothing but the search and evaluation code
+    SearchLimits limits;
+    limits.depth = depth;
+    uint64_t total = 0;
+    double seconds = 0;
+    int n = 0;
+    for (const char* fen : benchPositions) {
+        ChessAI engine;
+        engine.setHashSize(size_t(std::max(1, hashMegabytes)) * 1024);
+        engine.setDeterministic(true);
+        Position pos;
+        pos.setFen(fen);
+        SearchResult result = engine.search(pos, limits);
+        const SearchStats& stats = engine.getSearchStats();
+        total += stats.nodes;
+        seconds += stats.seconds;
+
+        char san[SAN_MAX_LENGTH];
+        int length = result.bestMove == NO_MOVE ? 0 : writeSan(pos, result.bestMove, san);
+        std::printf("%3d  %-7.*s %+6d  %10llu nodes  %7.3fs\n", ++n, length, san, result.score,
+                    (unsigned long long)stats.nodes, stats.seconds);
+    }
+    std::printf("bench signature %llu (depth %d), %.3fs, %.0f nodes/s\n", (unsigned long long)total, depth,
+                seconds, seconds > 0 ? total / seconds : 0.0);
+    if (expected && total != expected) {
+        std::printf("MISMATCH: expected %llu\n", (unsigned long long)expected);
+        return 1;
+    }
+    return 0;
+}
+
+// One mate search, printed as a line; returns the mate length found
+static int mateLine(MateSearch& search, const std::string& fen, int maxMoves, const char* label)
+{
+    Position pos;
+    pos.setFen(fen);
+    MateResult result = search.find(pos, maxMoves);
+    std::string line;
+    for (PackedMove move : result.line) {
+        char san[SAN_MAX_LENGTH];
+        line += (line.empty() ? "" : " ") + std::string(san, size_t(writeSan(pos, move, san)));
+        pos.makeMove(move);
+    }
+    if (result.moves)
+        std::printf("%s#%d  %s", label, result.moves, line.c_str());
+    else
+        std::printf("%sno mate in %d", label, result.ruledOut);
+    std::printf("  (%llu nodes, %.3fs)\n", (unsigned long long)result.nodes, result.seconds);
+    return result.moves;
+}
+
+static int runMateSearch(int argc, char** argv)
+{
+    std::vector<const char*> words;
+    int maxMoves = 0, hashMegabytes = 16;
+    uint64_t nodeLimit = 0;
+    bool checksOnly = false;
+    for (int i = 2; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--moves") == 0 && i + 1 < argc) maxMoves = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--checks") == 0) checksOnly = true;
+        else if (std::strcmp(argv[i], "--nodes") == 0 && i + 1 < argc) nodeLimit = std::strtoull(argv[++i], nullptr, 10);
+        else if (std::strcmp(argv[i], "--hash") == 0 && i + 1 < argc) hashMegabytes = std::atoi(argv[++i]);
+        else words.push_back(argv[i]);
+    }
+    if (words.empty()) {
+        std::printf("mate: need a FEN or an EPD file\n");
+        return 1;
+    }
+
+    MateSearch search(size_t(std::max(1, hashMegabytes)) * 1024);
+    search.setChecksOnly(checksOnly);
+    search.setNodeLimit(nodeLimit);
+
+    std::ifstream in(words.size() == 1 ? words[0] : "");
+    if (!in) {
+        std::string fen;
+        for (const char* word : words)
+            fen += (fen.empty() ? "" : " ") + std::string(word);
+        Position pos;
+        if (!setUp(pos, fen))
+            return 1;
+        return mateLine(search, fen, maxMoves > 0 ? maxMoves : 5, "") ? 0 : 1;
+    }
+
+    // Puzzle file: "dm N" is the mate the position should have, and the
+    // search looks that far unless told otherwise
+    auto start = std::chrono::steady_clock::now();
+    int count = 0, confirmed = 0, wrong = 0;
+    std::string text;
+    while (std::getline(in, text)) {
+        std::istringstream fields(text);
+        std::string field, fen;
+        for (int i = 0; i < 4 && fields >> field; ++i)
+            fen += (i ? " " : "") + field;
+        Position pos;
+        if (fen.empty() || !pos.setFen(fen))
+            continue;
+        int expected = 0;
+        while (fields >> field) {
+            if (field == "dm" && fields >> field)
+                expected = std::atoi(field.c_str());
+        }
+
+        char label[32];
+        std::snprintf(label, sizeof(label), "%4d  ", ++count);
+        int found = mateLine(search, fen, maxMoves > 0 ? maxMoves : std::max(expected, 5), label);
+        if (expected) {
+            if (found == expected) {
+                ++confirmed;
+            } else {
+                ++wrong;
+                std::printf("      expected #%d\n", expected);
+            }
+        }
+    }
+    std::printf("%d positions, %d mates confirmed, %d differ, %.1fs\n", count, confirmed, wrong, secondsSince(start));
+    return wrong ? 1 : 0;
+}
+
+static int runTuner(int argc, char** argv)
+{
+    std::vector<const char*> files;
+    int epochs = 1000, threads = 0;
+    double rate = 1.0, scale = 0;
+    for (int i = 2; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--epochs") == 0 && i + 1 < argc) epochs = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--rate") == 0 && i + 1 < argc) rate = std::atof(argv[++i]);
+        else if (std::strcmp(argv[i], "--scale") == 0 && i + 1 < argc) scale = std::atof(argv[++i]);
+        else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) threads = std::atoi(argv[++i]);
+        else files.push_back(argv[i]);
+    }
+    if (files.size() < 2) {
+        std::printf("tune: need an output file and at least one position file\n");
+        return 1;
+    }
+
+    EvalTuner tuner(threads);
+    tuner.setLogger([](const std::string& line) {
+        std::printf("%s\n", line.c_str());
+        std::fflush(stdout);
+    });
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 1; i < files.size(); ++i) {
+        if (!tuner.addPositions(files[i]))
+            return 1;
+    }
+    if (tuner.positionCount() == 0) {
+        std::printf("tune: no labeled positions\n");
+        return 1;
+    }
+    if (scale > 0)
+        tuner.setScale(scale);
+    else
+        scale = tuner.fitScale();
+    std::printf("scale %.4f, error %.6f\n", scale, tuner.error());
+
+    bool ok = tuner.tune(epochs, rate, files[0]);
+    std::printf("%s: %zu positions in %.1fs\n", ok ? "done" : "failed", tuner.positionCount(), secondsSince(start));
+    return ok ? 0 : 1;
+}
+
+static void printUsage()
+{
+    std::printf("Usage: chesstool <command> [args]\n\n"
+                "Commands:\n"
+                "  perft [depth] [fen]   Count legal move tree leaves and check reference counts\n"
+                "  perftsuite [depth]    Perft of the standard test positions\n"
+                "  divide <depth> [fen]  Perft split by root move\n"
+                "  tbgen <dir> [pieces] [threads] [--wdl-only]\n"
+                "                        Generate endgame tablebases up to the given piece count\n"
+                "  kpkgen [file]         Solve KPK; write the bitbase source, or check the built-in one\n"
+                "  book <out.bin> <games.pgn>... [--plies N] [--min-games N] [--threads N]\n"
+                "                        Build an opening book from the first plies of PGN games\n"
+                "  book --check          Check book keys against the published Polyglot keys\n"
+                "  dbimport <out.cbdb> <games.pgn>... [--index-plies N] [--threads N]\n"
+                "                        Build a game database with a position index from PGN files\n"
+                "  dbexport <db.cbdb> <out.pgn>\n"
+                "                        Write the games of a database as PGN\n"
+                "  dbfind <db.cbdb> [fen]\n"
+                "                        List the games that reach a position (default: the start)\n"
+                "  analyze <games.pgn> <out> [--nodes N | --time ms | --depth N] [--threads N]\n"
+                "          [--hash MB] [--nnue file] [--tb dir] [--json] [--multipv N]\n"
+                "                        Evaluate every move of every game (default 100000 nodes a\n"
+                "                        position) and write annotated PGN, or JSON lines; with\n"
+                "                        --multipv the N best moves of each position are listed\n"
+                "  match --engine <spec> --engine <spec> --openings file.epd [--games N]\n"
+                "        [--sprt elo0 elo1] [--max-plies N] [--threads N] [--pgn out.pgn]\n"
+                "                        Play paired games between two engine configurations and\n"
+                "                        report the Elo difference; spec is comma-separated\n"
+                "                        name=, nodes=, time=, depth=, hash=, nnue=, tb= (default\n"
+                "                        20000 nodes a move); mcts=N plays Monte Carlo tree search\n"
+                "                        on N threads, with nodes= counting playouts\n"
+                "  epd <suite.epd> [--time ms | --nodes N | --depth N] [--threads N] [--hash MB]\n"
+                "                        Run a test suite with bm/am (or STS c0 points) operations,\n"
+                "                        one position per core (default one second each)\n"
+                "  mate <fen | suite.epd> [--moves N] [--checks] [--nodes N] [--hash MB]\n"
+                "                        Find the shortest forced mate (default up to 5 moves, or\n"
+                "                        the suite's dm); --checks only tries checking moves\n"
+                "  tune <out.inc> <positions.epd>... [--epochs N] [--rate R] [--scale K] [--threads N]\n"
+                "                        Fit the evaluation weights to the game results of quiet\n"
+                "                        positions; the output replaces src/evalparams.inc\n"
+                "  bench [depth] [--hash MB] [--expect N]\n"
+                "                        Search twelve fixed positions to a depth (default 6) on one\n"
+                "                        thread and print the node total as a signature; with\n"
+                "                        --expect a different total fails, for git bisect run\n");
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        printUsage();
+        return 1;
+    }
+
+    if (std::strcmp(argv[1], "perft") == 0) return runPerft(argc, argv);
+    if (std::strcmp(argv[1], "perftsuite") == 0) return runPerftSuite(argc, argv);
+    if (std::strcmp(argv[1], "divide") == 0) return runDivide(argc, argv);
+    if (std::strcmp(argv[1], "tbgen") == 0) return runTablebaseGenerator(argc, argv);
+    if (std::strcmp(argv[1], "kpkgen") == 0) return runKpkGenerator(argc, argv);
+    if (std::strcmp(argv[1], "book") == 0) return runBookBuilder(argc, argv);
+    if (std::strcmp(argv[1], "dbimport") == 0) return runDbImport(argc, argv);
+    if (std::strcmp(argv[1], "dbexport") == 0) return runDbExport(argc, argv);
+    if (std::strcmp(argv[1], "dbfind") == 0) return runDbFind(argc, argv);
+    if (std::strcmp(argv[1], "analyze") == 0) return runAnalyze(argc, argv);
+    if (std::strcmp(argv[1], "match") == 0) return runMatch(argc, argv);
+    if (std::strcmp(argv[1], "epd") == 0) return runEpdSuite(argc, argv);
+    if (std::strcmp(argv[1], "mate") == 0) return runMateSearch(argc, argv);
+    if (std::strcmp(argv[1], "tune") == 0) return runTuner(argc, argv);
+    if (std::strcmp(argv[1], "bench") == 0) return runBench(argc, argv);
+
+    printUsage();
+    return 1;
+}
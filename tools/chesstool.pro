@@ -0,0 +1,62 @@
+######################################################################
+# chesstool - headless engine utilities (perft, tablebase and book generation, game databases,
+# batch analysis, engine matches, evaluation tuning, test suites, ...)
+# Build: cd tools && qmake && make
+######################################################################
+
+TEMPLATE = app
+TARGET = chesstool
+CONFIG += console c++17 thread
+CONFIG -= app_bundle qt
+INCLUDEPATH += ../src
+
+SOURCES += chesstool.cpp \
+           ../src/bitboard.cpp \
+           ../src/position.cpp \
+           ../src/movegen.cpp \
+           ../src/mappedfile.cpp \
+           ../src/tablebase.cpp \
+           ../src/tbgen.cpp \
+           ../src/kpk.cpp \
+           ../src/openingbook.cpp \
+           ../src/san.cpp \
+           ../src/pgn.cpp \
+           ../src/bookbuilder.cpp \
+           ../src/gamedb.cpp \
+           ../src/gamedbbuilder.cpp \
+           ../src/pawntable.cpp \
+           ../src/evalcache.cpp \
+           ../src/nnue.cpp \
+           ../src/transposition.cpp \
+           ../src/matesearch.cpp \
+           ../src/mcts.cpp \
+           ../src/chessai.cpp \
+           ../src/analysis.cpp \
+           ../src/match.cpp \
+           ../src/tuner.cpp \
+           ../src/epdsuite.cpp
+
+HEADERS += ../src/bitboard.h \
+           ../src/position.h \
+           ../src/movegen.h \
+           ../src/mappedfile.h \
+           ../src/tablebase.h \
+           ../src/tbgen.h \
+           ../src/kpk.h \
+           ../src/openingbook.h \
+           ../src/san.h \
+           ../src/pgn.h \
+           ../src/bookbuilder.h \
+           ../src/gamedb.h \
+           ../src/gamedbbuilder.h \
+           ../src/pawntable.h \
+           ../src/evalcache.h \
+           ../src/nnue.h \
+           ../src/transposition.h \
+           ../src/matesearch.h \
+           ../src/mcts.h \
+           ../src/chessai.h \
+           ../src/analysis.h \
+           ../src/match.h \
+           ../src/tuner.h \
+           ../src/epdsuite.h